@@ -1348,20 +1348,13 @@ netdev_tx_t bond_tlb_xmit(struct sk_buff *skb, struct net_device *bond_dev)
 		case htons(ETH_P_IPX):
 		    /* In case of IPX, it will falback to L2 hash */
 		case htons(ETH_P_IPV6):
-			hash_index = bond_xmit_hash(bond, skb);
 			if (bond->params.tlb_dynamic_lb) {
+				hash_index = bond_xmit_hash(bond, skb);
 				tx_slave = tlb_choose_channel(bond,
 							      hash_index & 0xFF,
 							      skb->len);
 			} else {
-				struct bond_up_slave *slaves;
-				unsigned int count;
-
-				slaves = rcu_dereference(bond->slave_arr);
-				count = slaves ? ACCESS_ONCE(slaves->count) : 0;
-				if (likely(count))
-					tx_slave = slaves->arr[hash_index %
-							       count];
+				tx_slave = bond_xmit_slave_arr_get(bond, skb);
 			}
 			break;
 		}
@@ -1467,15 +1460,7 @@ netdev_tx_t bond_alb_xmit(struct sk_buff *skb, struct net_device *bond_dev)
 			 * do_tx_balance means we are free to select the tx_slave
 			 * So we do exactly what tlb would do for hash selection
 			 */
-
-			struct bond_up_slave *slaves;
-			unsigned int count;
-
-			slaves = rcu_dereference(bond->slave_arr);
-			count = slaves ? READ_ONCE(slaves->count) : 0;
-			if (likely(count))
-				tx_slave = slaves->arr[bond_xmit_hash(bond, skb) %
-						       count];
+			tx_slave = bond_xmit_slave_arr_get(bond, skb);
 		}
 	}
 
@@ -4005,6 +4005,26 @@ out:
 	return ret;
 }
 
+/* Pick the tx slave from the usable slave array built in the control path.
+ * The xmit hash is only computed when there is more than one slave to
+ * choose from.
+ */
+struct slave *bond_xmit_slave_arr_get(struct bonding *bond,
+				      struct sk_buff *skb)
+{
+	struct bond_up_slave *slaves;
+	unsigned int count;
+
+	slaves = rcu_dereference(bond->slave_arr);
+	count = slaves ? READ_ONCE(slaves->count) : 0;
+	if (unlikely(!count))
+		return NULL;
+	if (count == 1)
+		return slaves->arr[0];
+
+	return slaves->arr[bond_xmit_hash(bond, skb) % count];
+}
+
 /* Use this Xmit function for 3AD as well as XOR modes. The current
  * usable slave array is formed in the control path. The xmit function
  * just calculates hash and sends the packet out.
@@ -4014,17 +4034,12 @@ static netdev_tx_t bond_3ad_xor_xmit(struct sk_buff *skb,
 {
 	struct bonding *bond = netdev_priv(dev);
 	struct slave *slave;
-	struct bond_up_slave *slaves;
-	unsigned int count;
 
-	slaves = rcu_dereference(bond->slave_arr);
-	count = slaves ? ACCESS_ONCE(slaves->count) : 0;
-	if (likely(count)) {
-		slave = slaves->arr[bond_xmit_hash(bond, skb) % count];
+	slave = bond_xmit_slave_arr_get(bond, skb);
+	if (likely(slave))
 		bond_dev_queue_xmit(bond, skb, slave->dev);
-	} else {
+	else
 		bond_tx_drop(dev, skb);
-	}
 
 	return NETDEV_TX_OK;
 }
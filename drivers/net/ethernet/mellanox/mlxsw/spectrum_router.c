@@ -4612,6 +4612,11 @@ mlxsw_sp_router_fib4_add(struct mlxsw_sp *mlxsw_sp,
 	if (mlxsw_sp->router->aborted)
 		return 0;
 
+	if (fen_info->fi->nh) {
+		dev_warn(mlxsw_sp->bus_info->dev, "IPv4 route with nexthop objects is not supported\n");
+		return -EINVAL;
+	}
+
 	fib_node = mlxsw_sp_fib_node_get(mlxsw_sp, fen_info->tb_id,
 					 &fen_info->dst, sizeof(fen_info->dst),
 					 fen_info->dst_len,
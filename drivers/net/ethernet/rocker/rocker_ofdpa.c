@@ -2923,6 +2923,9 @@ static int ofdpa_fib4_add(struct rocker *rocker,
 
 	if (ofdpa->fib_aborted)
 		return 0;
+	/* routes using nexthop objects can not be offloaded */
+	if (fen_info->fi->nh)
+		return -EOPNOTSUPP;
 	ofdpa_port = ofdpa_port_dev_lower_find(fen_info->fi->fib_dev, rocker);
 	if (!ofdpa_port)
 		return 0;
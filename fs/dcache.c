@@ -37,6 +37,9 @@
 #include <linux/rculist_bl.h>
 #include <linux/prefetch.h>
 #include <linux/ratelimit.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include "internal.h"
 #include "mount.h"
 
@@ -81,6 +84,14 @@
 int sysctl_vfs_cache_pressure __read_mostly = 100;
 EXPORT_SYMBOL_GPL(sysctl_vfs_cache_pressure);
 
+/*
+ * Maximum number of unused negative dentries each superblock keeps on its
+ * negative LRU, 0 means no limit.  Dentries over the limit are pruned oldest
+ * first from a work item; should that fall behind by another limit's worth,
+ * dput() frees negative dentries right away instead of caching them.
+ */
+int sysctl_negative_dentry_limit __read_mostly;
+
 static __cacheline_aligned_in_smp DEFINE_SPINLOCK(dcache_lru_lock);
 __cacheline_aligned_in_smp DEFINE_SEQLOCK(rename_lock);
 
@@ -349,22 +360,71 @@ static void dentry_unlink_inode(struct dentry * dentry)
 /*
  * dentry_lru_(add|del|prune|move_tail) must be called with d_lock held.
  */
+
+/*
+ * A dentry stays on the LRU while it is in use, so it may have been
+ * instantiated or unlinked since it was put on the list.  Move it to the
+ * list matching its current state, unless it is on a shrink list.
+ */
+static void dentry_lru_refile(struct dentry *dentry)
+{
+	struct super_block *sb = dentry->d_sb;
+
+	spin_lock(&dcache_lru_lock);
+	if ((dentry->d_flags & (DCACHE_LRU_LIST | DCACHE_SHRINK_LIST)) !=
+	    DCACHE_LRU_LIST)
+		goto out;
+
+	if (d_is_negative(dentry) &&
+	    !(dentry->d_flags & DCACHE_NEGATIVE_LRU)) {
+		dentry->d_flags |= DCACHE_NEGATIVE_LRU;
+		list_move(&dentry->d_lru, &sb->s_dentry_neg_lru);
+		sb->s_nr_dentry_negative++;
+		dentry_stat.nr_negative++;
+	} else if (!d_is_negative(dentry) &&
+		   (dentry->d_flags & DCACHE_NEGATIVE_LRU)) {
+		dentry->d_flags &= ~DCACHE_NEGATIVE_LRU;
+		list_move(&dentry->d_lru, &sb->s_dentry_lru);
+		sb->s_nr_dentry_negative--;
+		dentry_stat.nr_negative--;
+	}
+out:
+	spin_unlock(&dcache_lru_lock);
+}
+
 static void dentry_lru_add(struct dentry *dentry)
 {
 	if (unlikely(!(dentry->d_flags & DCACHE_LRU_LIST))) {
+		struct super_block *sb = dentry->d_sb;
+
 		spin_lock(&dcache_lru_lock);
 		dentry->d_flags |= DCACHE_LRU_LIST;
-		list_add(&dentry->d_lru, &dentry->d_sb->s_dentry_lru);
-		dentry->d_sb->s_nr_dentry_unused++;
+		if (d_is_negative(dentry)) {
+			dentry->d_flags |= DCACHE_NEGATIVE_LRU;
+			list_add(&dentry->d_lru, &sb->s_dentry_neg_lru);
+			sb->s_nr_dentry_negative++;
+			dentry_stat.nr_negative++;
+		} else {
+			list_add(&dentry->d_lru, &sb->s_dentry_lru);
+		}
+		sb->s_nr_dentry_unused++;
 		dentry_stat.nr_unused++;
 		spin_unlock(&dcache_lru_lock);
+	} else if (unlikely(!(dentry->d_flags & DCACHE_NEGATIVE_LRU) !=
+			    !d_is_negative(dentry))) {
+		dentry_lru_refile(dentry);
 	}
 }
 
 static void __dentry_lru_del(struct dentry *dentry)
 {
 	list_del_init(&dentry->d_lru);
-	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST);
+	if (dentry->d_flags & DCACHE_NEGATIVE_LRU) {
+		dentry->d_sb->s_nr_dentry_negative--;
+		dentry_stat.nr_negative--;
+	}
+	dentry->d_flags &= ~(DCACHE_SHRINK_LIST | DCACHE_LRU_LIST |
+			     DCACHE_NEGATIVE_LRU);
 	dentry->d_sb->s_nr_dentry_unused--;
 	dentry_stat.nr_unused--;
 }
@@ -556,6 +616,28 @@ again:
 	return parent;
 }
 
+static void prune_negative_dentries(struct work_struct *work);
+static DECLARE_WORK(prune_negative_dentries_work, prune_negative_dentries);
+
+/*
+ * Called by dput() for an unused negative dentry: kick the pruning work if
+ * @sb is over its negative dentry limit, and tell the caller to free the
+ * dentry straight away if it is over the limit twice.
+ */
+static bool d_negative_over_limit(struct super_block *sb)
+{
+	int limit = ACCESS_ONCE(sysctl_negative_dentry_limit);
+	int nr = ACCESS_ONCE(sb->s_nr_dentry_negative);
+
+	if (likely(!limit || nr < limit))
+		return false;
+
+	if (!work_pending(&prune_negative_dentries_work))
+		schedule_work(&prune_negative_dentries_work);
+
+	return nr - limit >= limit;
+}
+
 /* 
  * This is dput
  *
@@ -605,6 +687,10 @@ repeat:
 			goto kill_it;
 	}
 
+	if (unlikely(d_is_negative(dentry)) &&
+	    d_negative_over_limit(dentry->d_sb))
+		goto kill_it;
+
 	dentry->d_flags |= DCACHE_REFERENCED;
 	dentry_lru_add(dentry);
 
@@ -855,29 +941,23 @@ static void shrink_dentry_list(struct list_head *list)
 	}
 }
 
-/**
- * prune_dcache_sb - shrink the dcache
- * @sb: superblock
- * @count: number of entries to try to free
- *
- * Attempt to shrink the superblock dcache LRU by @count entries. This is
- * done when we need more memory an called from the superblock shrinker
- * function.
- *
- * This function may fail to free any resources if all the dentries are in
- * use.
+/*
+ * Move up to @count unreferenced dentries from the tail of @lru, one of the
+ * LRU lists of @sb, to a private list and free them.  Returns the number of
+ * dentries selected for freeing.
  */
-void prune_dcache_sb(struct super_block *sb, int count)
+static int __prune_dcache_lru(struct super_block *sb, struct list_head *lru,
+			      int count)
 {
 	struct dentry *dentry;
 	LIST_HEAD(referenced);
 	LIST_HEAD(tmp);
+	int nr = 0;
 
 relock:
 	spin_lock(&dcache_lru_lock);
-	while (!list_empty(&sb->s_dentry_lru)) {
-		dentry = list_entry(sb->s_dentry_lru.prev,
-				struct dentry, d_lru);
+	while (nr < count && !list_empty(lru)) {
+		dentry = list_entry(lru->prev, struct dentry, d_lru);
 		BUG_ON(dentry->d_sb != sb);
 
 		if (!spin_trylock(&dentry->d_lock)) {
@@ -894,16 +974,73 @@ relock:
 			list_move_tail(&dentry->d_lru, &tmp);
 			dentry->d_flags |= DCACHE_SHRINK_LIST;
 			spin_unlock(&dentry->d_lock);
-			if (!--count)
-				break;
+			nr++;
 		}
 		cond_resched_lock(&dcache_lru_lock);
 	}
 	if (!list_empty(&referenced))
-		list_splice(&referenced, &sb->s_dentry_lru);
+		list_splice(&referenced, lru);
 	spin_unlock(&dcache_lru_lock);
 
 	shrink_dentry_list(&tmp);
+	return nr;
+}
+
+/**
+ * prune_dcache_sb - shrink the dcache
+ * @sb: superblock
+ * @count: number of entries to try to free
+ *
+ * Attempt to shrink the superblock dcache LRU by @count entries. This is
+ * done when we need more memory an called from the superblock shrinker
+ * function.  Negative dentries are the cheapest to recreate, so they are
+ * reclaimed before the positive ones.
+ *
+ * This function may fail to free any resources if all the dentries are in
+ * use.
+ */
+void prune_dcache_sb(struct super_block *sb, int count)
+{
+	count -= __prune_dcache_lru(sb, &sb->s_dentry_neg_lru, count);
+	if (count > 0)
+		__prune_dcache_lru(sb, &sb->s_dentry_lru, count);
+}
+
+static void prune_negative_dentries_sb(struct super_block *sb, void *unused)
+{
+	int limit = ACCESS_ONCE(sysctl_negative_dentry_limit);
+	int excess, nr;
+
+	if (!limit)
+		return;
+
+	/*
+	 * Trim an extra eighth of the limit so that the work does not get
+	 * requeued by every other negative dput() on a busy superblock.
+	 */
+	excess = ACCESS_ONCE(sb->s_nr_dentry_negative) - limit;
+	if (excess <= 0)
+		return;
+	excess += limit >> 3;
+
+	/*
+	 * Every dput() sets DCACHE_REFERENCED, so a first pass mostly just
+	 * clears it.  Go round a second time for the dentries that nobody
+	 * has used since.
+	 */
+	nr = __prune_dcache_lru(sb, &sb->s_dentry_neg_lru, excess);
+	if (nr < excess)
+		nr += __prune_dcache_lru(sb, &sb->s_dentry_neg_lru,
+					 excess - nr);
+
+	spin_lock(&dcache_lru_lock);
+	sb->s_nr_dentry_neg_pruned += nr;
+	spin_unlock(&dcache_lru_lock);
+}
+
+static void prune_negative_dentries(struct work_struct *work)
+{
+	iterate_supers(prune_negative_dentries_sb, NULL);
 }
 
 /**
@@ -918,7 +1055,9 @@ void shrink_dcache_sb(struct super_block *sb)
 	LIST_HEAD(tmp);
 
 	spin_lock(&dcache_lru_lock);
-	while (!list_empty(&sb->s_dentry_lru)) {
+	while (!list_empty(&sb->s_dentry_lru) ||
+	       !list_empty(&sb->s_dentry_neg_lru)) {
+		list_splice_init(&sb->s_dentry_neg_lru, &tmp);
 		list_splice_init(&sb->s_dentry_lru, &tmp);
 		spin_unlock(&dcache_lru_lock);
 		shrink_dentry_list(&tmp);
@@ -928,6 +1067,54 @@ void shrink_dcache_sb(struct super_block *sb)
 }
 EXPORT_SYMBOL(shrink_dcache_sb);
 
+#ifdef CONFIG_PROC_FS
+static void dentry_stats_sb(struct super_block *sb, void *arg)
+{
+	struct seq_file *m = arg;
+	int unused, negative;
+	unsigned long pruned;
+
+	spin_lock(&dcache_lru_lock);
+	unused = sb->s_nr_dentry_unused;
+	negative = sb->s_nr_dentry_negative;
+	pruned = sb->s_nr_dentry_neg_pruned;
+	spin_unlock(&dcache_lru_lock);
+
+	seq_printf(m, "%s\t%s\t%d\t%d\t%lu\n", sb->s_id, sb->s_type->name,
+		   unused, negative, pruned);
+}
+
+/*
+ * /proc/fs/dentry-stats: one line per superblock with the number of unused
+ * dentries, how many of those are negative, and how many negative dentries
+ * were pruned for being over negative-dentry-limit.
+ */
+static int dentry_stats_show(struct seq_file *m, void *v)
+{
+	iterate_supers(dentry_stats_sb, m);
+	return 0;
+}
+
+static int dentry_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dentry_stats_show, NULL);
+}
+
+static const struct file_operations dentry_stats_fops = {
+	.open		= dentry_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init proc_dentry_stats_init(void)
+{
+	proc_create("fs/dentry-stats", 0, NULL, &dentry_stats_fops);
+	return 0;
+}
+fs_initcall(proc_dentry_stats_init);
+#endif
+
 /*
  * destroy a single subtree of dentries for unmount
  * - see the comments on shrink_dcache_for_umount() for a description of the
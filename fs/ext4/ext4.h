@@ -996,6 +996,12 @@ struct ext4_inode_info {
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
 
+	/*
+	 * Transaction in which the inode last took part in a change that a
+	 * fast commit of the inode alone cannot describe.
+	 */
+	tid_t i_fc_ineligible_tid;
+
 	/* Precomputed uuid+inum+igen checksum for seeding inode checksums */
 	__u32 i_csum_seed;
 };
@@ -1046,6 +1052,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_FAST_COMMIT		0x4000000 /* Fast commits on fsync */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1400,6 +1407,9 @@ struct ext4_sb_info {
 	struct ratelimit_state s_warning_ratelimit_state;
 	struct ratelimit_state s_msg_ratelimit_state;
 	struct dax_device *s_daxdev;
+
+	/* Transaction that no inode can be fast committed in */
+	tid_t s_fc_ineligible_tid;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -2080,6 +2090,16 @@ extern int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
 /* fsync.c */
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 
+/* fast_commit.c */
+extern void ext4_fc_mark_ineligible(handle_t *handle, struct inode *inode);
+extern void ext4_fc_mark_sb_ineligible(handle_t *handle,
+				       struct super_block *sb);
+extern int ext4_fc_init(struct super_block *sb);
+extern int ext4_fc_commit(journal_t *journal, struct inode *inode,
+			  tid_t commit_tid);
+extern int ext4_fc_replay(journal_t *journal, struct buffer_head *bh,
+			  int off, tid_t expected_tid);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
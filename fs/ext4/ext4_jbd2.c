@@ -260,6 +260,8 @@ int __ext4_handle_dirty_metadata(const char *where, unsigned int line,
 
 	set_buffer_meta(bh);
 	set_buffer_prio(bh);
+	/* Metadata blocks owned by the inode are not in a fast commit */
+	ext4_fc_mark_ineligible(handle, inode);
 	if (ext4_handle_valid(handle)) {
 		err = jbd2_journal_dirty_metadata(handle, bh);
 		/* Errors can only happen due to aborted journal or a nasty bug */
@@ -316,6 +318,7 @@ int __ext4_handle_dirty_super(const char *where, unsigned int line,
 	int err = 0;
 
 	ext4_superblock_csum_set(sb);
+	ext4_fc_mark_sb_ineligible(handle, sb);
 	if (ext4_handle_valid(handle)) {
 		err = jbd2_journal_dirty_metadata(handle, bh);
 		if (err)
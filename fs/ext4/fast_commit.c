@@ -0,0 +1,306 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits for fsync.
+ *
+ * A full jbd2 commit writes every metadata block touched by the running
+ * transaction, whichever file it belongs to.  When the only thing an fsync
+ * needs from the running transaction is the inode itself - its size,
+ * timestamps, in-inode extent tree or xattrs - we instead write a copy of
+ * the on-disk inode into the jbd2 fast commit area and leave the
+ * transaction running.  If the system crashes before that transaction is
+ * committed, journal recovery copies the logged inode back into the inode
+ * table once the log has been replayed.
+ *
+ * Anything else the inode may depend on - block or inode allocation,
+ * directory entries, link counts, the orphan list, the superblock - marks
+ * the inode (or the whole filesystem) ineligible for the running
+ * transaction, and fsync then falls back to a full commit.  In particular
+ * appending writes allocate blocks and so always take a full commit; only
+ * overwrites of already allocated blocks and metadata-only inode changes
+ * benefit.
+ */
+
+#include <linux/fs.h>
+#include <linux/jbd2.h>
+#include <linux/blkdev.h>
+#include <linux/buffer_head.h>
+#include <linux/crc32.h>
+
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "fast_commit.h"
+
+/*
+ * Note that @inode has been changed in a way that cannot be replayed from
+ * a fast commit of the inode alone in the transaction @handle belongs to.
+ */
+void ext4_fc_mark_ineligible(handle_t *handle, struct inode *inode)
+{
+	if (!ext4_handle_valid(handle) || !inode)
+		return;
+	EXT4_I(inode)->i_fc_ineligible_tid = handle->h_transaction->t_tid;
+}
+
+/* Same, for changes no single inode owns */
+void ext4_fc_mark_sb_ineligible(handle_t *handle, struct super_block *sb)
+{
+	if (!ext4_handle_valid(handle))
+		return;
+	EXT4_SB(sb)->s_fc_ineligible_tid = handle->h_transaction->t_tid;
+}
+
+static u32 ext4_fc_csum(struct super_block *sb, void *buf, int len)
+{
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+	u32 crc;
+
+	crc = crc32_le(~0, es->s_uuid, sizeof(es->s_uuid));
+	return crc32_le(crc, buf, len);
+}
+
+/*
+ * Turn on fast commits for the journal of a filesystem being mounted with
+ * the fast_commit option.  The size of the fast commit area is kept in the
+ * journal superblock; a journal that has none yet gets a default sized
+ * one.  The journal feature itself is only kept set while the filesystem
+ * is mounted.  Returns 0 if fast commits cannot be used.
+ */
+int ext4_fc_init(struct super_block *sb)
+{
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	journal_superblock_t *jsb = journal->j_superblock;
+	bool sized = false;
+
+	if (test_opt(sb, DATA_FLAGS) == EXT4_MOUNT_JOURNAL_DATA) {
+		ext4_msg(sb, KERN_WARNING,
+			 "fast commits are not supported with data=journal");
+		return 0;
+	}
+	if (EXT4_FC_BLOCK_BYTES(EXT4_INODE_SIZE(sb)) > sb->s_blocksize) {
+		ext4_msg(sb, KERN_WARNING,
+			 "fast commits need inodes smaller than the block size");
+		return 0;
+	}
+	if (JBD2_HAS_INCOMPAT_FEATURE(journal,
+				      JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT))
+		return 1;
+	if (sb->s_flags & MS_RDONLY) {
+		ext4_msg(sb, KERN_WARNING,
+			 "cannot enable fast commits on a read-only mount");
+		return 0;
+	}
+	/*
+	 * Enabling the feature writes the size out with the superblock, and
+	 * fails if the log is currently using any of the blocks it takes.
+	 */
+	if (!jsb->s_rh_num_fc_blks) {
+		jsb->s_rh_num_fc_blks = cpu_to_be32(min_t(u32,
+					JBD2_DEFAULT_FAST_COMMIT_BLOCKS,
+					journal->j_maxlen / 16));
+		sized = true;
+	}
+	if (!jbd2_journal_set_features(journal, 0, 0,
+				JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT)) {
+		if (sized)
+			jsb->s_rh_num_fc_blks = 0;
+		ext4_msg(sb, KERN_WARNING,
+			 "failed to set fast commit journal feature");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Copy the on-disk inode of @inode into the next block of the fast commit
+ * area and return that block locked in @bhp.  Called with journal updates
+ * locked, so the inode table buffer cannot change under us.
+ */
+static int ext4_fc_fill_block(journal_t *journal, struct inode *inode,
+			      tid_t tid, struct buffer_head **bhp)
+{
+	struct super_block *sb = inode->i_sb;
+	int inode_len = EXT4_INODE_SIZE(sb);
+	struct ext4_fc_inode *fc_inode;
+	struct ext4_fc_tail *tail;
+	struct ext4_fc_tl *tl;
+	struct buffer_head *bh;
+	struct ext4_iloc iloc;
+	u8 *start;
+	int ret;
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+
+	ret = jbd2_fc_get_buf(journal, &bh);
+	if (ret)
+		goto out;
+
+	lock_buffer(bh);
+	start = bh->b_data;
+	memset(start, 0, bh->b_size);
+
+	tl = (struct ext4_fc_tl *)start;
+	tl->fc_tag = cpu_to_le16(EXT4_FC_TAG_RH_INODE);
+	tl->fc_len = cpu_to_le16(sizeof(*fc_inode) + inode_len);
+	fc_inode = (struct ext4_fc_inode *)(tl + 1);
+	fc_inode->fc_ino = cpu_to_le32(inode->i_ino);
+	memcpy(fc_inode->fc_raw_inode, ext4_raw_inode(&iloc), inode_len);
+
+	tl = (struct ext4_fc_tl *)(fc_inode->fc_raw_inode + inode_len);
+	tl->fc_tag = cpu_to_le16(EXT4_FC_TAG_RH_TAIL);
+	tl->fc_len = cpu_to_le16(sizeof(*tail));
+	tail = (struct ext4_fc_tail *)(tl + 1);
+	tail->fc_tid = cpu_to_le32(tid);
+	tail->fc_crc = cpu_to_le32(ext4_fc_csum(sb, start,
+					(u8 *)&tail->fc_crc - start));
+	*bhp = bh;
+out:
+	brelse(iloc.bh);
+	return ret;
+}
+
+/*
+ * Write a block filled by ext4_fc_fill_block() and wait for it to reach
+ * stable storage.  Runs with updates allowed again.
+ */
+static int ext4_fc_submit_block(journal_t *journal, struct buffer_head *bh)
+{
+	int write_op = WRITE_SYNC;
+	int ret = 0;
+
+	/*
+	 * The file data fsync has just written must be stable before the
+	 * inode that points at it; the flush of the fast commit write takes
+	 * care of that unless the journal lives on another device.
+	 */
+	if (journal->j_flags & JBD2_BARRIER) {
+		if (journal->j_fs_dev != journal->j_dev)
+			blkdev_issue_flush(journal->j_fs_dev, GFP_NOFS, NULL);
+		write_op = WRITE_FLUSH_FUA;
+	}
+
+	set_buffer_uptodate(bh);
+	clear_buffer_dirty(bh);
+	get_bh(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	submit_bh(write_op, bh);
+	wait_on_buffer(bh);
+	if (!buffer_uptodate(bh))
+		ret = -EIO;
+	brelse(bh);
+	return ret;
+}
+
+/*
+ * Try to make the metadata of @inode from transaction @commit_tid stable
+ * with a fast commit.  Returns 0 on success; otherwise the caller has to
+ * fall back to a full commit of the transaction.
+ */
+int ext4_fc_commit(journal_t *journal, struct inode *inode, tid_t commit_tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct buffer_head *bh = NULL;
+	int ret;
+
+	ret = jbd2_fc_begin_commit(journal, commit_tid);
+	if (ret)
+		return ret;
+
+	if (EXT4_I(inode)->i_fc_ineligible_tid == commit_tid ||
+	    EXT4_SB(sb)->s_fc_ineligible_tid == commit_tid)
+		ret = -EINVAL;
+	else
+		ret = ext4_fc_fill_block(journal, inode, commit_tid, &bh);
+
+	/* Only the copy needs updates locked out, not the I/O */
+	jbd2_fc_unlock_updates(journal);
+	if (!ret)
+		ret = ext4_fc_submit_block(journal, bh);
+
+	jbd2_fc_end_commit(journal);
+	return ret;
+}
+
+/*
+ * Copy a logged inode back into its slot in the inode table.  Runs from
+ * journal recovery, after the log has been replayed and before anything
+ * else looks at the filesystem.
+ */
+static int ext4_fc_replay_inode(struct super_block *sb, unsigned long ino,
+				u8 *raw_inode)
+{
+	int inode_len = EXT4_INODE_SIZE(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bh;
+	ext4_fsblk_t block;
+	ext4_group_t group;
+	unsigned long offset;
+
+	if (!ext4_valid_inum(sb, ino))
+		return -EFSCORRUPTED;
+
+	group = (ino - 1) / EXT4_INODES_PER_GROUP(sb);
+	gdp = ext4_get_group_desc(sb, group, NULL);
+	if (!gdp)
+		return -EFSCORRUPTED;
+
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * inode_len;
+	block = ext4_inode_table(sb, gdp) + offset / sb->s_blocksize;
+	bh = sb_bread(sb, block);
+	if (!bh)
+		return -EIO;
+
+	lock_buffer(bh);
+	memcpy(bh->b_data + offset % sb->s_blocksize, raw_inode, inode_len);
+	unlock_buffer(bh);
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+/*
+ * jbd2 recovery callback: replay one block of the fast commit area.  Fast
+ * commits are written one per block and in order, so the first block that
+ * does not hold a valid fast commit of @expected_tid ends the scan.
+ */
+int ext4_fc_replay(journal_t *journal, struct buffer_head *bh, int off,
+		   tid_t expected_tid)
+{
+	struct super_block *sb = journal->j_private;
+	int inode_len = EXT4_INODE_SIZE(sb);
+	struct ext4_fc_inode *fc_inode;
+	struct ext4_fc_tail *tail;
+	struct ext4_fc_tl *tl;
+	u8 *start = bh->b_data;
+	int ret;
+
+	if (EXT4_FC_BLOCK_BYTES(inode_len) > bh->b_size)
+		return 1;
+
+	tl = (struct ext4_fc_tl *)start;
+	if (le16_to_cpu(tl->fc_tag) != EXT4_FC_TAG_RH_INODE ||
+	    le16_to_cpu(tl->fc_len) != sizeof(*fc_inode) + inode_len)
+		return 1;
+	fc_inode = (struct ext4_fc_inode *)(tl + 1);
+
+	tl = (struct ext4_fc_tl *)(fc_inode->fc_raw_inode + inode_len);
+	if (le16_to_cpu(tl->fc_tag) != EXT4_FC_TAG_RH_TAIL ||
+	    le16_to_cpu(tl->fc_len) != sizeof(*tail))
+		return 1;
+	tail = (struct ext4_fc_tail *)(tl + 1);
+
+	if (le32_to_cpu(tail->fc_tid) != expected_tid ||
+	    le32_to_cpu(tail->fc_crc) !=
+	    ext4_fc_csum(sb, start, (u8 *)&tail->fc_crc - start))
+		return 1;
+
+	ret = ext4_fc_replay_inode(sb, le32_to_cpu(fc_inode->fc_ino),
+				   fc_inode->fc_raw_inode);
+	if (ret)
+		ext4_msg(sb, KERN_ERR, "failed to replay fast commit block %d "
+			 "(inode %u): %d", off, le32_to_cpu(fc_inode->fc_ino),
+			 ret);
+	return ret;
+}
@@ -0,0 +1,48 @@
+/*
+ *  fs/ext4/fast_commit.h
+ *
+ * On-disk format of ext4 fast commit blocks.
+ */
+
+#ifndef _EXT4_FAST_COMMIT_H
+#define _EXT4_FAST_COMMIT_H
+
+/*
+ * A fast commit occupies one block of the jbd2 fast commit area and is a
+ * sequence of tag-length-value records:
+ *
+ *	EXT4_FC_TAG_RH_INODE	struct ext4_fc_inode followed by the raw
+ *				on-disk inode (EXT4_INODE_SIZE bytes)
+ *	EXT4_FC_TAG_RH_TAIL	struct ext4_fc_tail
+ *
+ * This is not the upstream fast commit format, which lives behind a
+ * different journal feature bit; the tag numbers are kept out of the
+ * range upstream uses so that neither can mistake the other's blocks.
+ * fc_len is the length of the value following the tag.  The tail carries
+ * the id of the transaction the fast commit belongs to and a crc32 of the
+ * filesystem uuid and of the block up to, but not including, fc_crc.
+ */
+#define EXT4_FC_TAG_RH_INODE	0x8006
+#define EXT4_FC_TAG_RH_TAIL	0x8008
+
+struct ext4_fc_tl {
+	__le16 fc_tag;
+	__le16 fc_len;
+};
+
+struct ext4_fc_inode {
+	__le32 fc_ino;
+	__u8 fc_raw_inode[0];
+};
+
+struct ext4_fc_tail {
+	__le32 fc_tid;
+	__le32 fc_crc;
+};
+
+/* Bytes needed for one fast commit of an inode of @inode_size bytes */
+#define EXT4_FC_BLOCK_BYTES(inode_size)					\
+	(2 * sizeof(struct ext4_fc_tl) + sizeof(struct ext4_fc_inode) +	\
+	 (inode_size) + sizeof(struct ext4_fc_tail))
+
+#endif /* _EXT4_FAST_COMMIT_H */
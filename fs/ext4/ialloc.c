@@ -1038,6 +1038,9 @@ got:
 		ei->i_sync_tid = handle->h_transaction->t_tid;
 		ei->i_datasync_tid = handle->h_transaction->t_tid;
 	}
+	/* The inode bitmap and the new directory entry are not logged */
+	ext4_fc_mark_ineligible(handle, inode);
+	ext4_fc_mark_ineligible(handle, dir);
 
 	err = ext4_mark_inode_dirty(handle, inode);
 	if (err) {
@@ -4497,6 +4497,8 @@ struct inode *ext4_iget(struct super_block *sb, unsigned long ino)
 		read_unlock(&journal->j_state_lock);
 		ei->i_sync_tid = tid;
 		ei->i_datasync_tid = tid;
+		/* Nor do we know what else of it the inode depends on */
+		ei->i_fc_ineligible_tid = tid;
 	}
 
 	if (EXT4_INODE_SIZE(inode->i_sb) > EXT4_GOOD_OLD_INODE_SIZE) {
@@ -4945,6 +4947,8 @@ int ext4_setattr(struct dentry *dentry, struct iattr *attr)
 			error = PTR_ERR(handle);
 			goto err_out;
 		}
+		/* Quota files are not part of a fast commit */
+		ext4_fc_mark_ineligible(handle, inode);
 		error = dquot_transfer(inode, attr);
 		if (error) {
 			ext4_journal_stop(handle);
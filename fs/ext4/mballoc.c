@@ -4412,6 +4412,7 @@ ext4_fsblk_t ext4_mb_new_blocks(handle_t *handle,
 	might_sleep();
 	sb = ar->inode->i_sb;
 	sbi = EXT4_SB(sb);
+	ext4_fc_mark_ineligible(handle, ar->inode);
 
 	trace_ext4_request_blocks(ar);
 
@@ -4648,6 +4649,7 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 	int ret;
 
 	might_sleep();
+	ext4_fc_mark_ineligible(handle, inode);
 	if (bh) {
 		if (block)
 			BUG_ON(block != bh->b_blocknr);
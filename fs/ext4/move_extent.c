@@ -933,6 +933,9 @@ again:
 		*err = PTR_ERR(handle);
 		return 0;
 	}
+	/* Extents move between the two inodes */
+	ext4_fc_mark_ineligible(handle, orig_inode);
+	ext4_fc_mark_ineligible(handle, donor_inode);
 
 	orig_blk_offset = orig_page_offset * blocks_per_page +
 		data_offset_in_page;
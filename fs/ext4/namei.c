@@ -2585,6 +2585,9 @@ int ext4_orphan_add(handle_t *handle, struct inode *inode)
 	J_ASSERT((S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) ||
 		  S_ISLNK(inode->i_mode)) || inode->i_nlink == 0);
 
+	/* The on-disk orphan list links inodes through each other */
+	ext4_fc_mark_sb_ineligible(handle, sb);
+
 	BUFFER_TRACE(sbi->s_sbh, "get_write_access");
 	err = ext4_journal_get_write_access(handle, sbi->s_sbh);
 	if (err)
@@ -2675,6 +2678,7 @@ int ext4_orphan_del(handle_t *handle, struct inode *inode)
 		goto out_err;
 	}
 
+	ext4_fc_mark_sb_ineligible(handle, inode->i_sb);
 	ino_next = NEXT_ORPHAN(inode);
 	if (prev == &sbi->s_orphan) {
 		jbd_debug(4, "superblock will point to %u\n", ino_next);
@@ -2757,6 +2761,8 @@ static int ext4_rmdir(struct inode *dir, struct dentry *dentry)
 	if (IS_DIRSYNC(dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(handle, dir);
+	ext4_fc_mark_ineligible(handle, inode);
 	retval = ext4_delete_entry(handle, dir, de, bh);
 	if (retval)
 		goto end_rmdir;
@@ -2828,6 +2834,8 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 			     inode->i_ino, inode->i_nlink);
 		set_nlink(inode, 1);
 	}
+	ext4_fc_mark_ineligible(handle, dir);
+	ext4_fc_mark_ineligible(handle, inode);
 	retval = ext4_delete_entry(handle, dir, de, bh);
 	if (retval)
 		goto end_unlink;
@@ -2975,6 +2983,8 @@ retry:
 	if (IS_DIRSYNC(dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(handle, dir);
+	ext4_fc_mark_ineligible(handle, inode);
 	inode->i_ctime = ext4_current_time(inode);
 	ext4_inc_count(handle, inode);
 	ihold(inode);
@@ -3300,6 +3310,11 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(handle, old.dir);
+	ext4_fc_mark_ineligible(handle, new.dir);
+	ext4_fc_mark_ineligible(handle, old.inode);
+	ext4_fc_mark_ineligible(handle, new.inode);
+
 	if (S_ISDIR(old.inode->i_mode)) {
 		if (new.inode) {
 			retval = -ENOTEMPTY;
@@ -3460,6 +3475,11 @@ static int ext4_cross_rename(struct inode *old_dir, struct dentry *old_dentry,
 	if (IS_DIRSYNC(old.dir) || IS_DIRSYNC(new.dir))
 		ext4_handle_sync(handle);
 
+	ext4_fc_mark_ineligible(handle, old.dir);
+	ext4_fc_mark_ineligible(handle, new.dir);
+	ext4_fc_mark_ineligible(handle, old.inode);
+	ext4_fc_mark_ineligible(handle, new.inode);
+
 	if (S_ISDIR(old.inode->i_mode)) {
 		old.is_dir = true;
 		retval = ext4_rename_dir_prepare(handle, &old);
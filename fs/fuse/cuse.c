@@ -25,8 +25,8 @@
  * channel determines when the character device dies.  When channel is
  * closed, everything begins to destruct.  The cuse_conn is taken off
  * the lookup table preventing further access from cdev, cdev and
- * generic device are removed and the base reference of cuse_conn is
- * put.
+ * generic device are removed and the channel's fuse_dev, which holds
+ * the reference of cuse_conn that keeps it alive, is freed.
  *
  * On each open, the matching cuse_conn is looked up and if found an
  * additional reference is taken which is released when the file is
@@ -493,6 +493,7 @@ static void cuse_fc_release(struct fuse_conn *fc)
  */
 static int cuse_channel_open(struct inode *inode, struct file *file)
 {
+	struct fuse_dev *fud;
 	struct cuse_conn *cc;
 	int rc;
 
@@ -503,6 +504,12 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
 
 	fuse_conn_init(&cc->fc);
 
+	fud = fuse_dev_alloc(&cc->fc);
+	if (!fud) {
+		kfree(cc);
+		return -ENOMEM;
+	}
+
 	INIT_LIST_HEAD(&cc->list);
 	cc->fc.release = cuse_fc_release;
 
@@ -510,10 +517,12 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
 	cc->fc.initialized = 1;
 	rc = cuse_send_init(cc);
 	if (rc) {
+		fuse_dev_free(fud);
 		fuse_conn_put(&cc->fc);
 		return rc;
 	}
-	file->private_data = &cc->fc;	/* channel owns base reference to cc */
+	file->private_data = fud;	/* channel owns fud, fud owns cc */
+	fuse_conn_put(&cc->fc);
 
 	return 0;
 }
@@ -531,7 +540,8 @@ static int cuse_channel_open(struct inode *inode, struct file *file)
  */
 static int cuse_channel_release(struct inode *inode, struct file *file)
 {
-	struct cuse_conn *cc = fc_to_cc(file->private_data);
+	struct fuse_dev *fud = file->private_data;
+	struct cuse_conn *cc = fc_to_cc(fud->fc);
 	int rc;
 
 	/* remove from the conntbl, no more access from this point on */
@@ -547,7 +557,8 @@ static int cuse_channel_release(struct inode *inode, struct file *file)
 		cdev_del(cc->cdev);
 	}
 
-	rc = fuse_dev_release(inode, file);	/* puts the base reference */
+	/* frees the fuse_dev, which puts its reference of cuse_conn */
+	rc = fuse_dev_release(inode, file);
 
 	return rc;
 }
@@ -24,8 +24,11 @@
 #include <linux/workqueue.h>
 #include <linux/pid_namespace.h>
 
-/** Max number of pages that can be used in a single read request */
-#define FUSE_MAX_PAGES_PER_REQ 32
+/** Default max number of pages that can be used in a single read request */
+#define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
+
+/** Maximum of max_pages received in init_out */
+#define FUSE_MAX_MAX_PAGES 256
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -48,6 +51,16 @@
 /** Number of page pointers embedded in fuse_req */
 #define FUSE_REQ_INLINE_PAGES 1
 
+/** Unique IDs of requests step by this, so that bit 0 is always clear */
+#define FUSE_REQ_ID_STEP (1ULL << 1)
+
+/** The unique ID of the FUSE_INTERRUPT for a request has this bit set */
+#define FUSE_INT_REQ_BIT (1ULL << 0)
+
+/** Number of buckets in the per-device hash of requests being processed */
+#define FUSE_PQ_HASH_BITS 8
+#define FUSE_PQ_HASH_SIZE (1 << FUSE_PQ_HASH_BITS)
+
 /** List of active connections */
 extern struct list_head fuse_conn_list;
 
@@ -252,8 +265,8 @@ struct fuse_io_priv {
  * A request to the client
  */
 struct fuse_req {
-	/** This can be on either pending processing or io lists in
-	    fuse_conn */
+	/** This can be on either the pending list of fuse_conn, or
+	    the processing or io lists of fuse_dev */
 	struct list_head list;
 
 	/** Entry on the interrupts list  */
@@ -262,9 +275,6 @@ struct fuse_req {
 	/** refcount */
 	atomic_t count;
 
-	/** Unique ID for the interrupt request */
-	u64 intr_unique;
-
 	/*
 	 * The following bitfields are either set once before the
 	 * request is queued or setting/clearing them is protected by
@@ -277,21 +287,29 @@ struct fuse_req {
 	/** Force sending of the request even if interrupted */
 	unsigned force:1;
 
-	/** The request was aborted */
-	unsigned aborted:1;
-
 	/** Request is sent in the background */
 	unsigned background:1;
 
 	/** The request has been interrupted */
 	unsigned interrupted:1;
 
-	/** Data is being copied to/from the request */
-	unsigned locked:1;
-
 	/** Request is counted as "waiting" */
 	unsigned waiting:1;
 
+	/*
+	 * Copying to and from the request is bracketed by setting and
+	 * clearing 'locked' under waitq.lock rather than fuse_conn->lock.
+	 * 'aborted' is set with both locks held, so it may be tested
+	 * under either.  Neither may share a word with the bitfields
+	 * above.
+	 */
+
+	/** The request was aborted */
+	bool aborted;
+
+	/** Data is being copied to/from the request */
+	bool locked;
+
 	/** State of the request */
 	enum fuse_req_state state;
 
@@ -402,17 +420,20 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
+	/** Maximum number of pages that can be used in a single request */
+	unsigned max_pages;
+
 	/** Readers of the connection are waiting on this */
 	wait_queue_head_t waitq;
 
 	/** The list of pending requests */
 	struct list_head pending;
 
-	/** The list of requests being processed */
-	struct list_head processing;
+	/** List of fuse_dev instances bound to this connection */
+	struct list_head devices;
 
-	/** The list of requests under I/O */
-	struct list_head io;
+	/** Number of fuse_dev instances, the connection ends with the last */
+	atomic_t dev_count;
 
 	/** The next unique kernel file handle */
 	u64 khctr;
@@ -561,6 +582,9 @@ struct fuse_conn {
 	/** Is lseek not implemented by fs? */
 	unsigned no_lseek:1;
 
+	/** Cache writes in the page cache and write them back later */
+	unsigned writeback_cache:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -604,6 +628,30 @@ struct fuse_conn {
 	struct rw_semaphore killsb;
 };
 
+/**
+ * Fuse device instance
+ *
+ * One per open /dev/fuse file bound to a connection, either by mounting
+ * or by cloning another one with FUSE_DEV_IOC_CLONE.  A request read
+ * from a device stays on its processing list until the reply is
+ * written to the same device, so daemon threads using separate devices
+ * do not look at each other's requests.
+ */
+struct fuse_dev {
+	/** Fuse connection for this device */
+	struct fuse_conn *fc;
+
+	/** The lists of requests being processed, hashed by unique ID.
+	    Protected by fc->lock */
+	struct list_head processing[FUSE_PQ_HASH_SIZE];
+
+	/** The list of requests under I/O.  Protected by fc->lock */
+	struct list_head io;
+
+	/** Entry on fc->devices */
+	struct list_head entry;
+};
+
 static inline struct fuse_conn *get_fuse_conn_super(struct super_block *sb)
 {
 	return sb->s_fs_info;
@@ -820,6 +868,16 @@ void fuse_conn_init(struct fuse_conn *fc);
  */
 void fuse_conn_put(struct fuse_conn *fc);
 
+/**
+ * Allocate a device bound to fuse_conn, taking a reference to it
+ */
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+
+/**
+ * Unbind a device from fuse_conn and free it
+ */
+void fuse_dev_free(struct fuse_dev *fud);
+
 /**
  * Add connection to control filesystem
  */
@@ -888,4 +946,9 @@ void fuse_write_update_size(struct inode *inode, loff_t pos);
 int fuse_do_setattr(struct inode *inode, struct iattr *attr,
 		    struct file *file);
 
+struct fuse_file *fuse_write_file_get(struct fuse_conn *fc,
+				      struct fuse_inode *fi);
+int fuse_write_inode(struct inode *inode, struct writeback_control *wbc);
+int fuse_flush_times(struct inode *inode, struct fuse_file *ff);
+
 #endif /* _FS_FUSE_I_H */
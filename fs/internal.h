@@ -161,6 +161,11 @@ loff_t iomap_apply(struct inode *inode, loff_t pos, loff_t length,
 		unsigned flags, const struct iomap_ops *ops, void *data,
 		iomap_actor_t actor);
 
+/*
+ * direct-io.c
+ */
+extern int sb_init_dio_done_wq(struct super_block *sb);
+
 /*
  * fs_pin.c
  */
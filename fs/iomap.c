@@ -18,6 +18,8 @@
 #include <linux/uaccess.h>
 #include <linux/aio.h>
 #include <linux/gfp.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
 #include <linux/mm.h>
 #include <linux/swap.h>
 #include <linux/pagemap.h>
@@ -25,7 +27,9 @@
 #include <linux/uio.h>
 #include <linux/backing-dev.h>
 #include <linux/buffer_head.h>
+#include <linux/task_io_accounting_ops.h>
 #include <linux/dax.h>
+#include <linux/sched.h>
 #include "internal.h"
 
 /*
@@ -695,3 +699,486 @@ iomap_seek_data(struct inode *inode, loff_t offset, const struct iomap_ops *ops)
 	return offset;
 }
 EXPORT_SYMBOL_GPL(iomap_seek_data);
+
+/*
+ * Private flags for iomap_dio, must not overlap with the public ones in
+ * iomap.h:
+ */
+#define IOMAP_DIO_WRITE		(1 << 30)
+#define IOMAP_DIO_DIRTY		(1 << 31)
+
+/* number of user pages pinned per get_user_pages_fast() call */
+#define IOMAP_DIO_PAGES		16
+
+struct iomap_dio {
+	struct kiocb		*iocb;
+	iomap_dio_end_io_t	*end_io;
+	loff_t			i_size;
+	loff_t			size;
+	atomic_t		ref;
+	unsigned		flags;
+	int			error;
+
+	union {
+		/* used during submission and for synchronous completion: */
+		struct {
+			struct iov_iter		*iter;
+			unsigned long		align;
+			struct task_struct	*waiter;
+		} submit;
+
+		/* used for aio completion: */
+		struct {
+			struct work_struct	work;
+		} aio;
+	};
+};
+
+static ssize_t iomap_dio_complete(struct iomap_dio *dio)
+{
+	struct kiocb *iocb = dio->iocb;
+	struct inode *inode = file_inode(iocb->ki_filp);
+	ssize_t ret;
+
+	if (dio->end_io) {
+		ret = dio->end_io(iocb,
+				dio->error ? dio->error : dio->size,
+				dio->flags);
+	} else {
+		ret = dio->error;
+	}
+
+	if (likely(!ret)) {
+		ret = dio->size;
+		/* check for short read */
+		if (iocb->ki_pos + ret > dio->i_size &&
+		    !(dio->flags & IOMAP_DIO_WRITE))
+			ret = dio->i_size - iocb->ki_pos;
+	}
+
+	/*
+	 * Try again to invalidate clean pages which might have been cached by
+	 * non-direct readahead, or faulted in by get_user_pages() if the source
+	 * of the write was an mmap'ed region of the file we're writing.  Either
+	 * one is a pretty crazy thing to do, so we don't support it 100%.  If
+	 * this invalidation fails, tough, the write still worked...
+	 */
+	if (ret > 0 && (dio->flags & IOMAP_DIO_WRITE) &&
+	    inode->i_mapping->nrpages) {
+		int err;
+
+		err = invalidate_inode_pages2_range(inode->i_mapping,
+				iocb->ki_pos >> PAGE_SHIFT,
+				(iocb->ki_pos + ret - 1) >> PAGE_SHIFT);
+		WARN_ON_ONCE(err);
+	}
+
+	if (ret > 0)
+		iocb->ki_pos += ret;
+
+	inode_dio_end(inode);
+	kfree(dio);
+
+	return ret;
+}
+
+static void iomap_dio_complete_work(struct work_struct *work)
+{
+	struct iomap_dio *dio = container_of(work, struct iomap_dio, aio.work);
+	struct kiocb *iocb = dio->iocb;
+	bool is_write = (dio->flags & IOMAP_DIO_WRITE);
+	ssize_t ret;
+
+	ret = iomap_dio_complete(dio);
+	if (is_write && ret > 0) {
+		int err;
+
+		err = generic_write_sync(iocb->ki_filp, iocb->ki_pos - ret,
+					 ret);
+		if (err < 0)
+			ret = err;
+	}
+
+	aio_complete(iocb, ret, 0);
+}
+
+/*
+ * Set an error in the dio if none is set yet.  We have to use an atomic
+ * cmpxchg here as the error can be set from I/O completion context.
+ */
+static inline void iomap_dio_set_error(struct iomap_dio *dio, int ret)
+{
+	cmpxchg(&dio->error, 0, ret);
+}
+
+static void iomap_dio_bio_end_io(struct bio *bio, int error)
+{
+	struct iomap_dio *dio = bio->bi_private;
+	bool should_dirty = (dio->flags & IOMAP_DIO_DIRTY);
+
+	if (error)
+		iomap_dio_set_error(dio, error);
+
+	if (atomic_dec_and_test(&dio->ref)) {
+		if (is_sync_kiocb(dio->iocb)) {
+			struct task_struct *waiter = dio->submit.waiter;
+
+			WRITE_ONCE(dio->submit.waiter, NULL);
+			wake_up_process(waiter);
+		} else if (dio->flags & IOMAP_DIO_WRITE) {
+			struct inode *inode = file_inode(dio->iocb->ki_filp);
+
+			/*
+			 * Write completions may need to run unwritten extent
+			 * conversion and size updates, so punt them to
+			 * process context.
+			 */
+			INIT_WORK(&dio->aio.work, iomap_dio_complete_work);
+			queue_work(inode->i_sb->s_dio_done_wq, &dio->aio.work);
+		} else {
+			iomap_dio_complete_work(&dio->aio.work);
+		}
+	}
+
+	if (should_dirty) {
+		bio_check_pages_dirty(bio);
+	} else {
+		struct bio_vec *bvec;
+		int i;
+
+		bio_for_each_segment_all(bvec, bio, i)
+			put_page(bvec->bv_page);
+		bio_put(bio);
+	}
+}
+
+static void
+iomap_dio_submit_bio(struct iomap_dio *dio, struct bio *bio)
+{
+	atomic_inc(&dio->ref);
+	submit_bio((dio->flags & IOMAP_DIO_WRITE) ? WRITE_ODIRECT : READ, bio);
+}
+
+static void
+iomap_dio_zero(struct iomap_dio *dio, struct iomap *iomap, loff_t pos,
+		unsigned len)
+{
+	struct page *page = ZERO_PAGE(0);
+	struct bio *bio;
+
+	bio = bio_alloc(GFP_KERNEL, 1);
+	bio->bi_bdev = iomap->bdev;
+	bio->bi_sector = (iomap->addr + pos - iomap->offset) >> 9;
+	bio->bi_private = dio;
+	bio->bi_end_io = iomap_dio_bio_end_io;
+
+	get_page(page);
+	if (bio_add_page(bio, page, len, 0) != len)
+		BUG();
+
+	iomap_dio_submit_bio(dio, bio);
+}
+
+static unsigned long
+iomap_dio_alignment(const struct iovec *iov, unsigned long nr_segs)
+{
+	unsigned long align = 0, seg;
+
+	for (seg = 0; seg < nr_segs; seg++)
+		align |= (unsigned long)iov[seg].iov_base | iov[seg].iov_len;
+	return align;
+}
+
+/*
+ * Pin the user pages backing the next bytes of @iter and add them to @bio
+ * until either the iterator or the bio is exhausted.  Returns the number of
+ * bytes added to the bio, or a negative errno if nothing could be added.
+ */
+static ssize_t
+iomap_dio_bio_add_pages(struct iomap_dio *dio, struct bio *bio,
+		struct iov_iter *iter)
+{
+	bool write = (dio->flags & IOMAP_DIO_WRITE);
+	struct page *pages[IOMAP_DIO_PAGES];
+	ssize_t added = 0;
+
+	while (iov_iter_count(iter) && bio->bi_vcnt < bio->bi_max_vecs) {
+		unsigned long addr = (unsigned long)iter->iov->iov_base +
+					iter->iov_offset;
+		size_t len = iov_iter_single_seg_count(iter);
+		unsigned offset = addr & ~PAGE_MASK;
+		int nr_pages, ret, i;
+
+		if (!len) {
+			/* skip over zero length segments */
+			iov_iter_advance(iter, 0);
+			continue;
+		}
+
+		nr_pages = min_t(size_t, DIV_ROUND_UP(offset + len, PAGE_SIZE),
+				 IOMAP_DIO_PAGES);
+		nr_pages = min_t(int, nr_pages,
+				 bio->bi_max_vecs - bio->bi_vcnt);
+
+		ret = get_user_pages_fast(addr & PAGE_MASK, nr_pages, !write,
+					  pages);
+		if (ret <= 0)
+			return added ? added : (ret ? ret : -EFAULT);
+		nr_pages = ret;
+		len = min_t(size_t, len, nr_pages * PAGE_SIZE - offset);
+
+		for (i = 0; i < nr_pages; i++) {
+			unsigned bytes = min_t(size_t, len, PAGE_SIZE - offset);
+
+			if (bio_add_page(bio, pages[i], bytes, offset) !=
+			    bytes) {
+				while (i < nr_pages)
+					put_page(pages[i++]);
+				return added ? added : -EFAULT;
+			}
+			iov_iter_advance(iter, bytes);
+			added += bytes;
+			len -= bytes;
+			offset = 0;
+		}
+	}
+
+	return added;
+}
+
+static loff_t
+iomap_dio_hole_actor(loff_t length, struct iomap_dio *dio)
+{
+	struct iov_iter *iter = dio->submit.iter;
+	loff_t done = 0;
+
+	while (done < length && iov_iter_count(iter)) {
+		size_t len = min_t(loff_t, iov_iter_single_seg_count(iter),
+				   length - done);
+		void __user *buf = iter->iov->iov_base + iter->iov_offset;
+
+		if (len && clear_user(buf, len))
+			return done ? done : -EFAULT;
+		iov_iter_advance(iter, len);
+		done += len;
+	}
+
+	dio->size += done;
+	return done;
+}
+
+static loff_t
+iomap_dio_actor(struct inode *inode, loff_t pos, loff_t length,
+		void *data, struct iomap *iomap)
+{
+	struct iomap_dio *dio = data;
+	unsigned blkbits = blksize_bits(bdev_logical_block_size(iomap->bdev));
+	unsigned fs_block_size = (1 << inode->i_blkbits), pad;
+	struct iov_iter iter;
+	struct bio *bio;
+	bool need_zeroout = false;
+	loff_t copied = 0;
+	ssize_t ret;
+
+	if ((pos | length | dio->submit.align) & ((1 << blkbits) - 1))
+		return -EINVAL;
+
+	switch (iomap->type) {
+	case IOMAP_HOLE:
+		if (WARN_ON_ONCE(dio->flags & IOMAP_DIO_WRITE))
+			return -EIO;
+		return iomap_dio_hole_actor(length, dio);
+	case IOMAP_UNWRITTEN:
+		if (!(dio->flags & IOMAP_DIO_WRITE))
+			return iomap_dio_hole_actor(length, dio);
+		dio->flags |= IOMAP_DIO_UNWRITTEN;
+		need_zeroout = true;
+		break;
+	case IOMAP_MAPPED:
+		if (iomap->flags & IOMAP_F_NEW)
+			need_zeroout = true;
+		break;
+	default:
+		WARN_ON_ONCE(1);
+		return -EIO;
+	}
+
+	/*
+	 * Operate on a partial iter trimmed to the extent we were called for.
+	 * We'll update the iter in the dio once we're done with this extent.
+	 */
+	iter = *dio->submit.iter;
+	iov_iter_truncate(&iter, length);
+	if (!iov_iter_count(&iter))
+		return 0;
+
+	if (need_zeroout) {
+		/* zero out from the start of the block to the write offset */
+		pad = pos & (fs_block_size - 1);
+		if (pad)
+			iomap_dio_zero(dio, iomap, pos - pad, pad);
+	}
+
+	do {
+		int nr_pages;
+
+		if (dio->error)
+			break;
+
+		nr_pages = min_t(size_t, BIO_MAX_PAGES,
+				 DIV_ROUND_UP(iov_iter_count(&iter), PAGE_SIZE) + 1);
+
+		bio = bio_alloc(GFP_KERNEL, nr_pages);
+		bio->bi_bdev = iomap->bdev;
+		bio->bi_sector = (iomap->addr + pos - iomap->offset) >> 9;
+		bio->bi_private = dio;
+		bio->bi_end_io = iomap_dio_bio_end_io;
+
+		ret = iomap_dio_bio_add_pages(dio, bio, &iter);
+		if (unlikely(ret < 0)) {
+			bio_put(bio);
+			if (!copied)
+				return ret;
+			goto out;
+		}
+
+		if (dio->flags & IOMAP_DIO_WRITE)
+			task_io_account_write(bio->bi_size);
+		else if (dio->flags & IOMAP_DIO_DIRTY)
+			bio_set_pages_dirty(bio);
+
+		dio->size += bio->bi_size;
+		pos += bio->bi_size;
+		copied += bio->bi_size;
+
+		iomap_dio_submit_bio(dio, bio);
+	} while (iov_iter_count(&iter));
+
+	if (need_zeroout && copied == length) {
+		/* zero out from the end of the write to the end of the block */
+		pad = pos & (fs_block_size - 1);
+		if (pad)
+			iomap_dio_zero(dio, iomap, pos, fs_block_size - pad);
+	}
+out:
+	iov_iter_advance(dio->submit.iter, copied);
+	return copied;
+}
+
+/**
+ * iomap_dio_rw - issue direct I/O using iomap mappings
+ * @rw:		READ or WRITE
+ * @iocb:	the control block for this I/O, ki_pos is the file offset
+ * @iov:	the user buffers to do I/O from or to
+ * @nr_segs:	number of segments in @iov
+ * @count:	number of bytes to transfer
+ * @ops:	iomap ops passed from the file system
+ * @end_io:	optional completion callback, run in process context for writes
+ *
+ * Unlike __blockdev_direct_IO(), this asks the file system for a whole extent
+ * at a time and builds the bios straight from the pinned user pages, without
+ * a get_block call per block.  Sub-block zeroing is done for newly allocated
+ * and unwritten extents.
+ *
+ * The caller must hold the locks that serialise against truncate and extent
+ * manipulation, and must have checked the I/O for alignment to the logical
+ * sector size of the device.  Returns -EIOCBQUEUED for queued async I/O.
+ */
+ssize_t
+iomap_dio_rw(int rw, struct kiocb *iocb, const struct iovec *iov,
+		unsigned long nr_segs, size_t count,
+		const struct iomap_ops *ops, iomap_dio_end_io_t end_io)
+{
+	struct address_space *mapping = iocb->ki_filp->f_mapping;
+	struct inode *inode = file_inode(iocb->ki_filp);
+	loff_t pos = iocb->ki_pos, end = iocb->ki_pos + count - 1, ret = 0;
+	unsigned int flags = IOMAP_DIRECT;
+	struct blk_plug plug;
+	struct iomap_dio *dio;
+	struct iov_iter iter;
+
+	if (!count)
+		return 0;
+
+	dio = kmalloc(sizeof(*dio), GFP_KERNEL);
+	if (!dio)
+		return -ENOMEM;
+
+	dio->iocb = iocb;
+	atomic_set(&dio->ref, 1);
+	dio->size = 0;
+	dio->i_size = i_size_read(inode);
+	dio->end_io = end_io;
+	dio->error = 0;
+	dio->flags = 0;
+
+	iov_iter_init(&iter, iov, nr_segs, count, 0);
+	dio->submit.iter = &iter;
+	dio->submit.align = iomap_dio_alignment(iov, nr_segs);
+	dio->submit.waiter = current;
+
+	if (rw & WRITE) {
+		dio->flags |= IOMAP_DIO_WRITE;
+		flags |= IOMAP_WRITE;
+	} else {
+		if (pos >= dio->i_size)
+			goto out_free_dio;
+		dio->flags |= IOMAP_DIO_DIRTY;
+	}
+
+	if (mapping->nrpages) {
+		ret = filemap_write_and_wait_range(mapping, pos, end);
+		if (ret)
+			goto out_free_dio;
+
+		ret = invalidate_inode_pages2_range(mapping,
+				pos >> PAGE_SHIFT, end >> PAGE_SHIFT);
+		WARN_ON_ONCE(ret);
+		ret = 0;
+	}
+
+	if ((rw & WRITE) && !is_sync_kiocb(iocb) &&
+	    !inode->i_sb->s_dio_done_wq) {
+		ret = sb_init_dio_done_wq(inode->i_sb);
+		if (ret < 0)
+			goto out_free_dio;
+	}
+
+	inode_dio_begin(inode);
+
+	blk_start_plug(&plug);
+	do {
+		ret = iomap_apply(inode, pos, count, flags, ops, dio,
+				iomap_dio_actor);
+		if (ret <= 0)
+			break;
+		pos += ret;
+
+		if (!(rw & WRITE) && pos >= dio->i_size)
+			break;
+	} while ((count = iov_iter_count(&iter)) > 0);
+	blk_finish_plug(&plug);
+
+	if (ret < 0)
+		iomap_dio_set_error(dio, ret);
+
+	if (!atomic_dec_and_test(&dio->ref)) {
+		if (!is_sync_kiocb(iocb))
+			return -EIOCBQUEUED;
+
+		for (;;) {
+			set_current_state(TASK_UNINTERRUPTIBLE);
+			if (!READ_ONCE(dio->submit.waiter))
+				break;
+			io_schedule();
+		}
+		__set_current_state(TASK_RUNNING);
+	}
+
+	return iomap_dio_complete(dio);
+
+out_free_dio:
+	kfree(dio);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iomap_dio_rw);
@@ -407,6 +407,21 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	 * all outstanding updates to complete.
 	 */
 
+	/* Let a fast commit of the running transaction finish first */
+	write_lock(&journal->j_state_lock);
+	while (journal->j_flags & JBD2_FAST_COMMIT_ONGOING) {
+		DEFINE_WAIT(wait);
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		finish_wait(&journal->j_fc_wait, &wait);
+		write_lock(&journal->j_state_lock);
+	}
+	journal->j_flags |= JBD2_FULL_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+
 	/* Do we need to erase the effects of a prior jbd2_journal_flush? */
 	if (journal->j_flags & JBD2_FLUSHED) {
 		jbd_debug(3, "super block updated\n");
@@ -1111,6 +1126,9 @@ restart_loop:
 	J_ASSERT(commit_transaction == journal->j_committing_transaction);
 	journal->j_commit_sequence = commit_transaction->t_tid;
 	journal->j_committing_transaction = NULL;
+	/* Fast commits up to this transaction are now redundant */
+	journal->j_fc_off = 0;
+	journal->j_flags &= ~JBD2_FULL_COMMIT_ONGOING;
 	commit_time = ktime_to_ns(ktime_sub(ktime_get(), start_time));
 
 	/*
@@ -771,6 +771,117 @@ wait_commit:
 }
 EXPORT_SYMBOL(jbd2_complete_transaction);
 
+/*
+ * Fast commit support.
+ *
+ * A fast commit writes a filesystem-defined record of the running
+ * transaction into the fast commit area at the end of the journal,
+ * without committing the transaction itself.
+ *
+ * jbd2_fc_begin_commit() claims JBD2_FAST_COMMIT_ONGOING, which keeps other
+ * fast commits out and makes the commit thread wait before it starts a
+ * full commit, and then locks out updates so that the filesystem sees a
+ * stable view of its metadata.  The filesystem copies what it needs and
+ * reserves its fast commit blocks, then calls jbd2_fc_unlock_updates()
+ * before doing any I/O, and jbd2_fc_end_commit() once the blocks are on
+ * disk.  Once the transaction has been fully committed the fast commit
+ * area is recycled.
+ *
+ * jbd2_fc_begin_commit() returns -EALREADY if @tid is no longer the running
+ * transaction or a full commit is already under way; the caller should
+ * then fall back to jbd2_complete_transaction().
+ */
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid)
+{
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT))
+		return -EOPNOTSUPP;
+	if (is_journal_aborted(journal))
+		return -EIO;
+
+	write_lock(&journal->j_state_lock);
+	for (;;) {
+		DEFINE_WAIT(wait);
+
+		/*
+		 * A flushed journal is marked empty on disk and would not be
+		 * recovered at all; let a full commit update the superblock.
+		 */
+		if ((journal->j_flags &
+		     (JBD2_FULL_COMMIT_ONGOING | JBD2_FLUSHED)) ||
+		    !journal->j_running_transaction ||
+		    journal->j_running_transaction->t_tid != tid) {
+			write_unlock(&journal->j_state_lock);
+			return -EALREADY;
+		}
+		if (!(journal->j_flags & JBD2_FAST_COMMIT_ONGOING))
+			break;
+
+		prepare_to_wait(&journal->j_fc_wait, &wait,
+				TASK_UNINTERRUPTIBLE);
+		write_unlock(&journal->j_state_lock);
+		schedule();
+		finish_wait(&journal->j_fc_wait, &wait);
+		write_lock(&journal->j_state_lock);
+	}
+	journal->j_flags |= JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+
+	/*
+	 * No full commit can start while we own the flag, so @tid stays the
+	 * running transaction.
+	 */
+	jbd2_journal_lock_updates(journal);
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_begin_commit);
+
+void jbd2_fc_unlock_updates(journal_t *journal)
+{
+	jbd2_journal_unlock_updates(journal);
+}
+EXPORT_SYMBOL(jbd2_fc_unlock_updates);
+
+void jbd2_fc_end_commit(journal_t *journal)
+{
+	write_lock(&journal->j_state_lock);
+	journal->j_flags &= ~JBD2_FAST_COMMIT_ONGOING;
+	write_unlock(&journal->j_state_lock);
+	wake_up_all(&journal->j_fc_wait);
+}
+EXPORT_SYMBOL(jbd2_fc_end_commit);
+
+/*
+ * Return the next free block of the fast commit area.  Must be called
+ * between jbd2_fc_begin_commit() and jbd2_fc_unlock_updates(), so that
+ * blocks are handed out in the order their contents were taken.  Returns
+ * -ENOSPC once the area is full; the next full commit will empty it.
+ */
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out)
+{
+	unsigned long long pblock;
+	unsigned long blocknr;
+	struct buffer_head *bh;
+	int ret;
+
+	*bh_out = NULL;
+	if (journal->j_fc_first + journal->j_fc_off > journal->j_fc_last)
+		return -ENOSPC;
+
+	blocknr = journal->j_fc_first + journal->j_fc_off++;
+	ret = jbd2_journal_bmap(journal, blocknr, &pblock);
+	if (ret)
+		return ret;
+
+	bh = __getblk(journal->j_dev, pblock, journal->j_blocksize);
+	if (!bh)
+		return -ENOMEM;
+
+	*bh_out = bh;
+	return 0;
+}
+EXPORT_SYMBOL(jbd2_fc_get_buf);
+
 /*
  * Log buffer allocation routines:
  */
@@ -1105,6 +1216,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_done_commit);
 	init_waitqueue_head(&journal->j_wait_commit);
 	init_waitqueue_head(&journal->j_wait_updates);
+	init_waitqueue_head(&journal->j_fc_wait);
 	init_waitqueue_head(&journal->j_wait_reserved);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
@@ -1298,6 +1410,41 @@ static void journal_fail_superblock (journal_t *journal)
  * subsequent use.
  */
 
+/*
+ * With fast commits enabled, the last s_rh_num_fc_blks blocks of the
+ * journal are set aside for fast commit records and the log proper wraps
+ * before them.  Called with j_first and j_last describing the whole
+ * journal.
+ */
+static int jbd2_journal_init_fc_area(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long num_fc_blks;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT))
+		return 0;
+
+	num_fc_blks = be32_to_cpu(sb->s_rh_num_fc_blks);
+	if (!num_fc_blks) {
+		printk(KERN_ERR "JBD2: Fast commit feature set without a "
+		       "fast commit area.\n");
+		return -EINVAL;
+	}
+	if (journal->j_first + JBD2_MIN_JOURNAL_BLOCKS + num_fc_blks >
+	    journal->j_last) {
+		printk(KERN_ERR "JBD2: Journal too short for %lu fast commit "
+		       "blocks.\n", num_fc_blks);
+		return -EINVAL;
+	}
+
+	journal->j_fc_last = journal->j_last - 1;
+	journal->j_last -= num_fc_blks;
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_off = 0;
+	return 0;
+}
+
 static int journal_reset(journal_t *journal)
 {
 	journal_superblock_t *sb = journal->j_superblock;
@@ -1314,10 +1461,14 @@ static int journal_reset(journal_t *journal)
 
 	journal->j_first = first;
 	journal->j_last = last;
+	if (jbd2_journal_init_fc_area(journal)) {
+		journal_fail_superblock(journal);
+		return -EINVAL;
+	}
 
 	journal->j_head = first;
 	journal->j_tail = first;
-	journal->j_free = last - first;
+	journal->j_free = journal->j_last - first;
 
 	journal->j_tail_sequence = journal->j_transaction_sequence;
 	journal->j_commit_sequence = journal->j_transaction_sequence - 1;
@@ -1630,7 +1781,7 @@ static int load_superblock(journal_t *journal)
 	journal->j_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
-	return 0;
+	return jbd2_journal_init_fc_area(journal);
 }
 
 
@@ -1700,6 +1851,24 @@ recovery_error:
 	return -EIO;
 }
 
+/*
+ * Once the log is empty nothing is left to replay from the fast commit
+ * area either, so drop the feature and let kernels and tools that do not
+ * know about it use the journal again.  The next mount turns it back on.
+ */
+static void jbd2_journal_clear_fc(journal_t *journal)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT))
+		return;
+
+	sb->s_feature_incompat &=
+		~cpu_to_be32(JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT);
+	jbd2_write_superblock(journal, WRITE_FUA);
+}
+
 /**
  * void jbd2_journal_destroy() - Release a journal_t structure.
  * @journal: Journal to act on.
@@ -1755,6 +1924,7 @@ int jbd2_journal_destroy(journal_t *journal)
 			write_unlock(&journal->j_state_lock);
 
 			jbd2_mark_journal_empty(journal, WRITE_FLUSH_FUA);
+			jbd2_journal_clear_fc(journal);
 			mutex_unlock(&journal->j_checkpoint_mutex);
 		} else
 			err = -EIO;
@@ -1842,6 +2012,35 @@ int jbd2_journal_check_available_features (journal_t *journal, unsigned long com
 	return 0;
 }
 
+/*
+ * Turn on fast commits for a loaded journal: carve the fast commit area out
+ * of the end of the log and write the superblock, so that recovery knows
+ * about the area before the first fast commit lands in it.  The size of
+ * the area has to have been set in s_rh_num_fc_blks by the caller, and the
+ * log must not currently be using any of those blocks.
+ */
+static int jbd2_journal_enable_fc(journal_t *journal)
+{
+	unsigned long old_last;
+	int err;
+
+	write_lock(&journal->j_state_lock);
+	old_last = journal->j_last;
+	err = jbd2_journal_init_fc_area(journal);
+	if (!err && (journal->j_tail > journal->j_head ||
+		     journal->j_head >= journal->j_last)) {
+		journal->j_last = old_last;
+		err = -EBUSY;
+	}
+	if (!err)
+		journal->j_free -= old_last - journal->j_last;
+	write_unlock(&journal->j_state_lock);
+	if (err)
+		return err;
+
+	return jbd2_write_superblock(journal, WRITE_FUA);
+}
+
 /**
  * int jbd2_journal_set_features () - Mark a given journal feature in the superblock
  * @journal: Journal to act on.
@@ -1862,6 +2061,7 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 #define COMPAT_FEATURE_ON(f) \
 		((compat & (f)) && !(sb->s_feature_compat & cpu_to_be32(f)))
 	journal_superblock_t *sb;
+	bool fc_on;
 
 	if (jbd2_journal_check_used_features(journal, compat, ro, incompat))
 		return 1;
@@ -1884,6 +2084,7 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 		  compat, ro, incompat);
 
 	sb = journal->j_superblock;
+	fc_on = INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT);
 
 	/* If enabling v3 checksums, update superblock */
 	if (INCOMPAT_FEATURE_ON(JBD2_FEATURE_INCOMPAT_CSUM_V3)) {
@@ -1919,6 +2120,12 @@ int jbd2_journal_set_features (journal_t *journal, unsigned long compat,
 	sb->s_feature_ro_compat |= cpu_to_be32(ro);
 	sb->s_feature_incompat  |= cpu_to_be32(incompat);
 
+	if (fc_on && jbd2_journal_enable_fc(journal)) {
+		sb->s_feature_incompat &=
+			~cpu_to_be32(JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT);
+		return 0;
+	}
+
 	return 1;
 #undef COMPAT_FEATURE_ON
 #undef INCOMPAT_FEATURE_ON
@@ -233,6 +233,46 @@ do {									\
 		var -= ((journal)->j_last - (journal)->j_first);	\
 } while (0)
 
+/*
+ * Hand the blocks of the fast commit area to the filesystem, in the order
+ * they were written, once the log itself has been replayed.  Only fast
+ * commits of the transaction that was running at the time of the crash
+ * are of interest; the filesystem checks that against @expected_tid and
+ * stops the scan at the first block that does not belong to it.
+ */
+static int fc_do_one_pass(journal_t *journal, tid_t expected_tid)
+{
+	unsigned long next_fc_block;
+	struct buffer_head *bh;
+	int err = 0;
+
+	if (!journal->j_fc_replay_callback ||
+	    !JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT))
+		return 0;
+
+	for (next_fc_block = journal->j_fc_first;
+	     next_fc_block <= journal->j_fc_last; next_fc_block++) {
+		err = jread(&bh, journal, next_fc_block);
+		if (err)
+			break;
+
+		err = journal->j_fc_replay_callback(journal, bh,
+					next_fc_block - journal->j_fc_first,
+					expected_tid);
+		brelse(bh);
+		if (err)
+			break;
+	}
+
+	if (err > 0)
+		err = 0;
+	if (err)
+		printk(KERN_ERR "JBD2: fast commit replay failed at block "
+		       "%lu, error %d\n", next_fc_block, err);
+	return err;
+}
+
 /**
  * jbd2_journal_recover - recovers a on-disk journal
  * @journal: the journal to recover
@@ -273,6 +313,8 @@ int jbd2_journal_recover(journal_t *journal)
 		err = do_one_pass(journal, &info, PASS_REVOKE);
 	if (!err)
 		err = do_one_pass(journal, &info, PASS_REPLAY);
+	if (!err)
+		err = fc_do_one_pass(journal, info.end_transaction);
 
 	jbd_debug(1, "JBD2: recovery, exit status %d, "
 		  "recovered transactions %u to %u\n",
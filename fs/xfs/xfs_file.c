@@ -249,13 +249,10 @@ xfs_file_dio_aio_read(
 	size_t			size = 0;
 	struct xfs_buftarg	*target;
 	ssize_t			ret = 0;
-	loff_t			end;
-
 
 	ret = generic_segment_checks(iovp, &nr_segs, &size, VERIFY_WRITE);
 	if (ret < 0)
 		return ret;
-	end = iocb->ki_pos + size - 1;
 
 	trace_xfs_file_direct_read(ip, size, iocb->ki_pos);
 
@@ -277,29 +274,10 @@ xfs_file_dio_aio_read(
 	file_accessed(iocb->ki_filp);
 
 	xfs_rw_ilock(ip, XFS_IOLOCK_SHARED);
-	if (mapping->nrpages) {
-		ret = filemap_write_and_wait_range(mapping, iocb->ki_pos, end);
-		if (ret)
-			goto out_unlock;
-
-		/*
-		 * Invalidate whole pages. This can return an error if we fail
-		 * to invalidate a page, but this should never happen on XFS.
-		 * Warn if it does fail.
-		 */
-		ret = invalidate_inode_pages2_range(mapping,
-				iocb->ki_pos >> PAGE_SHIFT, end >> PAGE_SHIFT);
-		WARN_ON_ONCE(ret);
-		ret = 0;
-	}
-	ret = __blockdev_direct_IO(READ, iocb, inode, target->bt_bdev,
-			iovp, pos, nr_segs, xfs_get_blocks_direct, NULL, NULL, 0);
-	if (ret > 0) {
-		iocb->ki_pos = pos + ret;
-	}
-
-out_unlock:
+	ret = iomap_dio_rw(READ, iocb, iovp, nr_segs, size, &xfs_iomap_ops,
+			NULL);
 	xfs_rw_iunlock(ip, XFS_IOLOCK_SHARED);
+
 	return ret;
 }
 
@@ -615,6 +593,64 @@ restart:
 	return 0;
 }
 
+/*
+ * Complete a direct I/O write: update the in-core and on-disk file size if
+ * the write extended it, and convert any unwritten extents we wrote into.
+ * Called from process context, either by the submitter for synchronous I/O
+ * or from the dio completion workqueue for AIO.
+ */
+static int
+xfs_dio_write_end_io(
+	struct kiocb		*iocb,
+	ssize_t			size,
+	unsigned		flags)
+{
+	struct inode		*inode = file_inode(iocb->ki_filp);
+	struct xfs_inode	*ip = XFS_I(inode);
+	loff_t			offset = iocb->ki_pos;
+	bool			update_size = false;
+	unsigned long		irqflags;
+	int			error = 0;
+
+	trace_xfs_end_io_direct_write(ip, offset, size);
+
+	if (XFS_FORCED_SHUTDOWN(ip->i_mount))
+		return -EIO;
+
+	if (size <= 0)
+		return size;
+
+	/*
+	 * We need to update the in-core inode size here so that we don't end up
+	 * with the on-disk inode size being outside the in-core inode size. We
+	 * have no other method of updating EOF for AIO, so always do it here
+	 * if necessary.
+	 *
+	 * We need to lock the test/set EOF update as we can be racing with
+	 * other IO completions here to update the EOF. Failing to serialise
+	 * here can result in EOF moving backwards and Bad Things Happen when
+	 * that occurs.
+	 */
+	spin_lock_irqsave(&ip->i_size_lock, irqflags);
+	if (offset + size > i_size_read(inode)) {
+		i_size_write(inode, offset + size);
+		update_size = true;
+	}
+	spin_unlock_irqrestore(&ip->i_size_lock, irqflags);
+
+	if (flags & IOMAP_DIO_UNWRITTEN) {
+		trace_xfs_end_io_direct_write_unwritten(ip, offset, size);
+
+		error = xfs_iomap_write_unwritten(ip, offset, size);
+	} else if (update_size) {
+		trace_xfs_end_io_direct_write_append(ip, offset, size);
+
+		error = xfs_setfilesize(ip, offset, size);
+	}
+
+	return error;
+}
+
 /*
  * xfs_file_dio_aio_write - handle direct IO writes
  *
@@ -657,7 +693,6 @@ xfs_file_dio_aio_write(
 	size_t			count = ocount;
 	int			unaligned_io = 0;
 	int			iolock;
-	loff_t			end;
 	struct xfs_buftarg	*target = XFS_IS_REALTIME_INODE(ip) ?
 					mp->m_rtdev_targp : mp->m_ddev_targp;
 
@@ -685,23 +720,9 @@ xfs_file_dio_aio_write(
 	ret = xfs_file_aio_write_checks(file, &pos, &count, &iolock);
 	if (ret)
 		goto out;
-	end = pos + count - 1;
 
-	if (mapping->nrpages) {
-		ret = filemap_write_and_wait_range(mapping, pos, end);
-		if (ret)
-			goto out;
-
-		/*
-		 * Invalidate whole pages. This can return an error if we fail
-		 * to invalidate a page, but this should never happen on XFS.
-		 * Warn if it does fail.
-		 */
-		ret = invalidate_inode_pages2_range(mapping,
-				pos >> PAGE_SHIFT, end >> PAGE_SHIFT);
-		WARN_ON_ONCE(ret);
-		ret = 0;
-	}
+	/* checks above may have moved pos for O_APPEND, keep iocb in sync */
+	iocb->ki_pos = pos;
 
 	/*
 	 * If we are doing unaligned IO, wait for all other IO to drain,
@@ -720,22 +741,8 @@ xfs_file_dio_aio_write(
 	if (count != ocount)
 		nr_segs = iov_shorten((struct iovec *)iovp, nr_segs, count);
 
-	ret = __blockdev_direct_IO(WRITE, iocb, inode, target->bt_bdev, iovp,
-			pos, nr_segs, xfs_get_blocks_direct, xfs_end_io_direct_write,
-			NULL, DIO_ASYNC_EXTEND);
-
-	/* see generic_file_direct_write() for why this is necessary */
-	if (mapping->nrpages) {
-		invalidate_inode_pages2_range(mapping,
-					      pos >> PAGE_CACHE_SHIFT,
-					      end >> PAGE_CACHE_SHIFT);
-	}
-
-	if (ret > 0) {
-		pos += ret;
-		iocb->ki_pos = pos;
-	}
-
+	ret = iomap_dio_rw(WRITE, iocb, iovp, nr_segs, count, &xfs_iomap_ops,
+			xfs_dio_write_end_io);
 out:
 	xfs_rw_iunlock(ip, iolock);
 
@@ -59,6 +59,12 @@ struct bpf_reg_state {
 	 * came from, when one is tested for != NULL.
 	 */
 	u32 id;
+	/* For pointers to a reserved ringbuf record, the id of the
+	 * reservation.  Stays with the register and all its copies after the
+	 * NULL check, so that bpf_ringbuf_submit()/bpf_ringbuf_discard() can
+	 * invalidate every pointer into the released record.
+	 */
+	u32 ref_obj_id;
 	/* Ordering of fields matters.  See states_equal() */
 	/* For scalar types (SCALAR_VALUE), this represents our knowledge of
 	 * the actual value.
@@ -126,11 +132,17 @@ struct bpf_func_state {
 };
 
 #define MAX_CALL_FRAMES 8
+#define MAX_ACQUIRED_REFS 8
 struct bpf_verifier_state {
 	/* call stack tracking */
 	struct bpf_func_state *frame[MAX_CALL_FRAMES];
 	struct bpf_verifier_state *parent;
 	u32 curframe;
+	/* ringbuf records reserved but not yet submitted or discarded on
+	 * this path, each of them must be released before BPF_EXIT
+	 */
+	u32 acquired_refs;
+	u32 refs[MAX_ACQUIRED_REFS];
 };
 
 /* linked list of verifier states used to prune search */
@@ -167,6 +179,11 @@ static inline bool bpf_verifier_log_full(const struct bpf_verifier_log *log)
 	return log->len_used >= log->len_total - 1;
 }
 
+static inline bool bpf_verifier_log_needed(const struct bpf_verifier_log *log)
+{
+	return log->level && log->ubuf && !bpf_verifier_log_full(log);
+}
+
 struct bpf_verifier_env;
 struct bpf_ext_analyzer_ops {
 	int (*insn_hook)(struct bpf_verifier_env *env,
@@ -201,6 +218,8 @@ struct bpf_verifier_env {
 	u32 subprog_cnt;
 };
 
+__printf(2, 0) void bpf_verifier_vlog(struct bpf_verifier_log *log,
+				      const char *fmt, va_list args);
 __printf(2, 3) void bpf_verifier_log_write(struct bpf_verifier_env *env,
 					   const char *fmt, ...);
 
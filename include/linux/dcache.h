@@ -59,7 +59,11 @@ struct dentry_stat_t {
 	int nr_unused;
 	int age_limit;          /* age in seconds */
 	int want_pages;         /* pages requested by system */
-	int dummy[2];
+	RH_KABI_REPLACE(int dummy[2],
+			struct {
+				int nr_negative; /* # of unused negative dentries */
+				int dummy;
+			})
 };
 extern struct dentry_stat_t dentry_stat;
 
@@ -220,6 +224,7 @@ struct dentry_operations_wrapper {
 	(DCACHE_MOUNTED|DCACHE_NEED_AUTOMOUNT|DCACHE_MANAGE_TRANSIT)
 
 #define DCACHE_LRU_LIST		0x80000
+#define DCACHE_NEGATIVE_LRU	0x8000	/* On s_dentry_neg_lru */
 #define DCACHE_DENTRY_KILLED	0x100000
 
 #define DCACHE_ENTRY_TYPE		0x07000000
@@ -512,6 +517,7 @@ static inline bool d_really_is_positive(const struct dentry *dentry)
 }
 
 extern int sysctl_vfs_cache_pressure;
+extern int sysctl_negative_dentry_limit;
 
 
 /**
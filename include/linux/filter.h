@@ -12,6 +12,8 @@
 #ifndef __GENKSYMS__
 #include <net/xdp.h>
 #include <net/sch_generic.h>
+#include <linux/bpf.h>
+#include <linux/sched.h>
 #endif
 #include <linux/capability.h>
 #include <linux/cryptohash.h>
@@ -450,12 +452,55 @@ struct sk_filter
 	struct sock_filter     	insns[0];
 };
 
+/* Socket filters are allocated inside this wrapper, so that the program
+ * a filter was migrated to can be kept without changing the layout of
+ * struct sk_filter.  Migrated filters have bpf_func set to
+ * sk_run_filter_prog().
+ */
+struct sk_filter_ext {
+	struct bpf_prog		*prog;
+	struct sk_filter	filter;
+};
+
+static inline struct bpf_prog *sk_filter_prog(const struct sk_filter *fp)
+{
+	return container_of(fp, struct sk_filter_ext, filter)->prog;
+}
+
 struct bpf_skb_data_end {
 	struct qdisc_skb_cb qdisc_cb;
 	void *data_end;
 };
 
-#define BPF_PROG_RUN(filter, ctx)  (*(filter)->bpf_func)(ctx, (filter)->insnsi)
+#define __BPF_PROG_RUN(filter, ctx)  (*(filter)->bpf_func)(ctx, (filter)->insnsi)
+
+/* With kernel.bpf_stats_enabled set, every run is counted and timed in
+ * the program's per-cpu stats.  The static key keeps this free when off.
+ */
+#define BPF_PROG_RUN(filter, ctx)  ({					\
+	u32 __ret;							\
+	if (static_key_false(&bpf_stats_enabled_key)) {			\
+		struct bpf_prog_stats *__stats;				\
+		u64 __start = sched_clock();				\
+		__ret = __BPF_PROG_RUN(filter, ctx);			\
+		__stats = get_cpu_ptr((filter)->aux->stats);		\
+		u64_stats_update_begin(&__stats->syncp);		\
+		__stats->cnt++;						\
+		__stats->nsecs += sched_clock() - __start;		\
+		u64_stats_update_end(&__stats->syncp);			\
+		put_cpu_ptr((filter)->aux->stats);			\
+	} else {							\
+		__ret = __BPF_PROG_RUN(filter, ctx);			\
+	}								\
+	__ret; })
+
+/* Classic filters that were migrated to eBPF run through their eBPF
+ * program, the rest through the classic interpreter or classic JIT.
+ */
+#define SK_RUN_FILTER(FILTER, SKB)					\
+	((FILTER)->bpf_func == sk_run_filter_prog ?			\
+	 BPF_PROG_RUN(sk_filter_prog(FILTER), SKB) :			\
+	 (*(FILTER)->bpf_func)(SKB, (FILTER)->insns))
 
 static inline u32 bpf_prog_insn_size(const struct bpf_prog *prog)
 {
@@ -523,7 +568,8 @@ static inline void bpf_prog_unlock_ro(struct bpf_prog *fp)
  */
 static inline unsigned int sk_filter_len(const struct sk_filter *fp)
 {
-	return fp->len * sizeof(struct sock_filter) + sizeof(*fp);
+	return fp->len * sizeof(struct sock_filter) +
+	       sizeof(struct sk_filter_ext);
 }
 
 static inline void bpf_compute_data_end(struct sk_buff *skb)
@@ -539,6 +585,8 @@ static inline int sk_filter(struct sock *sk, struct sk_buff *skb)
 
 extern unsigned int sk_run_filter(const struct sk_buff *skb,
 				  const struct sock_filter *filter);
+extern unsigned int sk_run_filter_prog(const struct sk_buff *skb,
+				       const struct sock_filter *filter);
 extern int sk_unattached_filter_create(struct sk_filter **pfp,
 				       struct sock_fprog *fprog);
 extern void sk_unattached_filter_destroy(struct sk_filter *fp);
@@ -547,6 +595,8 @@ extern int sk_detach_filter(struct sock *sk);
 extern int sk_chk_filter(struct sock_filter *filter, unsigned int flen);
 extern int sk_get_filter(struct sock *sk, struct sock_filter __user *filter, unsigned len);
 extern void sk_decode_filter(struct sock_filter *filt, struct sock_filter *to);
+struct bpf_prog *bpf_migrate_filter(const struct sock_filter *insns,
+				    unsigned int len);
 
 u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
 #define __bpf_call_base_args \
@@ -631,8 +681,6 @@ static inline void bpf_jit_dump(unsigned int flen, unsigned int proglen,
 		print_hex_dump(KERN_ERR, "JIT code: ", DUMP_PREFIX_ADDRESS,
 			       16, 1, image, proglen, false);
 }
-#define SK_RUN_FILTER(FILTER, SKB) (*FILTER->bpf_func)(SKB, FILTER->insns)
-
 static inline bool bpf_jit_is_ebpf(void)
 {
 # ifdef CONFIG_HAVE_EBPF_JIT
@@ -676,7 +724,6 @@ static inline void bpf_jit_compile(struct sk_filter *fp)
 static inline void bpf_jit_free(struct sk_filter *fp)
 {
 }
-#define SK_RUN_FILTER(FILTER, SKB) sk_run_filter(SKB, FILTER->insns)
 #endif
 
 void *trace_bpf_internal_load_pointer_neg_helper(const struct sk_buff *skb,
@@ -1557,6 +1557,11 @@ struct super_block {
 
 	RH_KABI_EXTEND(unsigned long	s_iflags)
 	RH_KABI_EXTEND(struct user_namespace *s_user_ns)
+
+	/* negative dentry LRU, protected by dcache.c lru locks like s_dentry_lru */
+	RH_KABI_EXTEND(struct list_head s_dentry_neg_lru)
+	RH_KABI_EXTEND(int s_nr_dentry_negative)	/* # of dentry on neg lru */
+	RH_KABI_EXTEND(unsigned long s_nr_dentry_neg_pruned) /* # pruned over limit */
 };
 
 extern const unsigned super_block_wrapper_version;
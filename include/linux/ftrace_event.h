@@ -320,6 +320,7 @@ enum {
 	FTRACE_EVENT_FL_RECORDED_CMD_BIT,
 	FTRACE_EVENT_FL_SOFT_MODE_BIT,
 	FTRACE_EVENT_FL_SOFT_DISABLED_BIT,
+	FTRACE_EVENT_FL_HIST_BIT,
 };
 
 /*
@@ -329,14 +330,18 @@ enum {
  *  SOFT_MODE     - The event is enabled/disabled by SOFT_DISABLED
  *  SOFT_DISABLED - When set, do not trace the event (even though its
  *                   tracepoint may be enabled)
+ *  HIST          - A histogram is attached, feed it every record
  */
 enum {
 	FTRACE_EVENT_FL_ENABLED		= (1 << FTRACE_EVENT_FL_ENABLED_BIT),
 	FTRACE_EVENT_FL_RECORDED_CMD	= (1 << FTRACE_EVENT_FL_RECORDED_CMD_BIT),
 	FTRACE_EVENT_FL_SOFT_MODE	= (1 << FTRACE_EVENT_FL_SOFT_MODE_BIT),
 	FTRACE_EVENT_FL_SOFT_DISABLED	= (1 << FTRACE_EVENT_FL_SOFT_DISABLED_BIT),
+	FTRACE_EVENT_FL_HIST		= (1 << FTRACE_EVENT_FL_HIST_BIT),
 };
 
+struct hist_trigger_data;
+
 struct ftrace_event_file {
 	struct list_head		list;
 	struct ftrace_event_call	*event_call;
@@ -350,6 +355,7 @@ struct ftrace_event_file {
 	 *   bit 1:		enabled cmd record
 	 *   bit 2:		enable/disable with the soft disable bit
 	 *   bit 3:		soft disabled
+	 *   bit 4:		histogram attached
 	 *
 	 * Note: The bits must be set atomically to prevent races
 	 * from other writers. Reads of flags do not need to be in
@@ -361,8 +367,40 @@ struct ftrace_event_file {
 	 */
 	unsigned long		flags;
 	atomic_t		sm_ref;	/* soft-mode reference counter */
+#ifndef __GENKSYMS__
+	struct hist_trigger_data __rcu *hist_data;
+#endif
 };
 
+#ifdef CONFIG_HIST_TRIGGERS
+extern void event_hist_call(struct ftrace_event_file *file, void *rec);
+#else
+static inline void
+event_hist_call(struct ftrace_event_file *file, void *rec) { }
+#endif
+
+/*
+ * Feed an event record to the histogram attached to the event, if any.
+ * Returns true if the record was discarded because the event is only
+ * traced for its histogram, i.e. it is soft disabled.
+ */
+static inline bool
+ftrace_event_hist_discard(struct ftrace_event_file *file,
+			  struct ring_buffer *buffer,
+			  struct ring_buffer_event *event, void *rec)
+{
+	if (likely(!test_bit(FTRACE_EVENT_FL_HIST_BIT, &file->flags)))
+		return false;
+
+	event_hist_call(file, rec);
+
+	if (!test_bit(FTRACE_EVENT_FL_SOFT_DISABLED_BIT, &file->flags))
+		return false;
+
+	ring_buffer_discard_commit(buffer, event);
+	return true;
+}
+
 #define __TRACE_EVENT_FLAGS(name, value)				\
 	static int __init trace_init_flags_##name(void)			\
 	{								\
@@ -387,6 +425,9 @@ unsigned int trace_call_bpf(struct ftrace_event_call *call, void *ctx);
 int perf_event_attach_bpf_prog(struct perf_event *event, struct bpf_prog *prog);
 void perf_event_detach_bpf_prog(struct perf_event *event);
 int perf_event_query_prog_array(struct perf_event *event, void __user *info);
+struct bpf_raw_event_map *bpf_find_raw_tracepoint(const char *name);
+int bpf_probe_register(struct bpf_raw_event_map *btp, struct bpf_prog *prog);
+int bpf_probe_unregister(struct bpf_raw_event_map *btp, struct bpf_prog *prog);
 #else
 static inline unsigned int trace_call_bpf(struct ftrace_event_call *call, void *ctx)
 {
@@ -406,8 +447,51 @@ perf_event_query_prog_array(struct perf_event *event, void __user *info)
 {
 	return -EOPNOTSUPP;
 }
+static inline struct bpf_raw_event_map *
+bpf_find_raw_tracepoint(const char *name)
+{
+	return NULL;
+}
+static inline int
+bpf_probe_register(struct bpf_raw_event_map *btp, struct bpf_prog *prog)
+{
+	return -EOPNOTSUPP;
+}
+static inline int
+bpf_probe_unregister(struct bpf_raw_event_map *btp, struct bpf_prog *prog)
+{
+	return -EOPNOTSUPP;
+}
 #endif
 
+void bpf_trace_run1(struct bpf_prog *prog, u64 arg1);
+void bpf_trace_run2(struct bpf_prog *prog, u64 arg1, u64 arg2);
+void bpf_trace_run3(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3);
+void bpf_trace_run4(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3, u64 arg4);
+void bpf_trace_run5(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3, u64 arg4, u64 arg5);
+void bpf_trace_run6(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3, u64 arg4, u64 arg5, u64 arg6);
+void bpf_trace_run7(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3, u64 arg4, u64 arg5, u64 arg6, u64 arg7);
+void bpf_trace_run8(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3, u64 arg4, u64 arg5, u64 arg6, u64 arg7,
+		    u64 arg8);
+void bpf_trace_run9(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		    u64 arg3, u64 arg4, u64 arg5, u64 arg6, u64 arg7,
+		    u64 arg8, u64 arg9);
+void bpf_trace_run10(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		     u64 arg3, u64 arg4, u64 arg5, u64 arg6, u64 arg7,
+		     u64 arg8, u64 arg9, u64 arg10);
+void bpf_trace_run11(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		     u64 arg3, u64 arg4, u64 arg5, u64 arg6, u64 arg7,
+		     u64 arg8, u64 arg9, u64 arg10, u64 arg11);
+void bpf_trace_run12(struct bpf_prog *prog, u64 arg1, u64 arg2,
+		     u64 arg3, u64 arg4, u64 arg5, u64 arg6, u64 arg7,
+		     u64 arg8, u64 arg9, u64 arg10, u64 arg11, u64 arg12);
+
 enum {
 	FILTER_OTHER = 0,
 	FILTER_STATIC_STRING,
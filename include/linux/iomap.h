@@ -8,6 +8,7 @@
 
 struct fiemap_extent_info;
 struct inode;
+struct iovec;
 struct kiocb;
 struct vm_area_struct;
 struct vm_fault;
@@ -59,6 +60,7 @@ struct iomap {
 #define IOMAP_ZERO		(1 << 1) /* zeroing operation, may skip holes */
 #define IOMAP_REPORT		(1 << 2) /* report extent status, e.g. FIEMAP */
 #define IOMAP_FAULT		(1 << 3) /* mapping for page fault */
+#define IOMAP_DIRECT		(1 << 4) /* direct I/O */
 
 struct iomap_ops {
 	/*
@@ -98,4 +100,14 @@ loff_t iomap_seek_hole(struct inode *inode, loff_t offset,
 loff_t iomap_seek_data(struct inode *inode, loff_t offset,
 		const struct iomap_ops *ops);
 
+/*
+ * Flags for direct I/O ->end_io:
+ */
+#define IOMAP_DIO_UNWRITTEN	(1 << 0)	/* covers unwritten extent(s) */
+typedef int (iomap_dio_end_io_t)(struct kiocb *iocb, ssize_t ret,
+		unsigned flags);
+ssize_t iomap_dio_rw(int rw, struct kiocb *iocb, const struct iovec *iov,
+		unsigned long nr_segs, size_t count,
+		const struct iomap_ops *ops, iomap_dio_end_io_t end_io);
+
 #endif /* LINUX_IOMAP_H */
@@ -70,6 +70,7 @@ extern void *jbd2_alloc(size_t size, gfp_t flags);
 extern void jbd2_free(void *ptr, size_t size);
 
 #define JBD2_MIN_JOURNAL_BLOCKS 1024
+#define JBD2_DEFAULT_FAST_COMMIT_BLOCKS 256
 
 #ifdef __KERNEL__
 
@@ -270,7 +271,10 @@ typedef struct journal_superblock_s
 /* 0x0050 */
 	__u8	s_checksum_type;	/* checksum type */
 	__u8	s_padding2[3];
-	__u32	s_padding[42];
+	__u32	s_padding[41];
+/* 0x00F8 */
+	__be32	s_rh_num_fc_blks;	/* Number of fast commit blocks, 0
+					   until fast commits are enabled */
 	__be32	s_checksum;		/* crc32c(superblock) */
 
 /* 0x0100 */
@@ -295,6 +299,12 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
 #define JBD2_FEATURE_INCOMPAT_CSUM_V2		0x00000008
 #define JBD2_FEATURE_INCOMPAT_CSUM_V3		0x00000010
+/*
+ * Private to this kernel, and not the upstream fast commit format: set
+ * while the fast commit area may hold records that recovery must replay,
+ * and cleared again on a clean unmount.
+ */
+#define JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT	0x80000000
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
@@ -303,7 +313,8 @@ typedef struct journal_superblock_s
 					JBD2_FEATURE_INCOMPAT_64BIT | \
 					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
 					JBD2_FEATURE_INCOMPAT_CSUM_V2 | \
-					JBD2_FEATURE_INCOMPAT_CSUM_V3)
+					JBD2_FEATURE_INCOMPAT_CSUM_V3 | \
+					JBD2_FEATURE_INCOMPAT_RH_FAST_COMMIT)
 
 #ifdef __KERNEL__
 
@@ -994,6 +1005,31 @@ struct journal_s
 
 	/* Precomputed journal UUID checksum for seeding other checksums */
 	__u32 j_csum_seed;
+
+	/*
+	 * Fast commit area: journal blocks j_fc_first to j_fc_last, set
+	 * aside at the end of the log while the fast commit feature is on.
+	 * j_fc_off is the next free block in the area; it is reset once the
+	 * running transaction commits.
+	 * [owner of JBD2_FAST_COMMIT_ONGOING / commit thread]
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+	unsigned long		j_fc_off;
+
+	/* Wait queue for the end of a fast commit */
+	wait_queue_head_t	j_fc_wait;
+
+	/*
+	 * Called during recovery for each block of the fast commit area
+	 * after the log has been replayed.  @expected_tid is the id of the
+	 * transaction that was running at the time of the crash.  Returns
+	 * 0 to continue, > 0 to stop the scan, < 0 on error.
+	 */
+	int			(*j_fc_replay_callback)(journal_t *journal,
+							struct buffer_head *bh,
+							int off,
+							tid_t expected_tid);
 };
 
 /*
@@ -1009,6 +1045,8 @@ struct journal_s
 						 * data write error in ordered
 						 * mode */
 #define JBD2_REC_ERR	0x080	/* The errno in the sb has been recorded */
+#define JBD2_FAST_COMMIT_ONGOING	0x100	/* Fast commit is in progress */
+#define JBD2_FULL_COMMIT_ONGOING	0x200	/* Full commit is in progress */
 
 /*
  * Function declarations for the journaling transaction and buffer
@@ -1248,6 +1286,10 @@ int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_transaction_committed(journal_t *journal, tid_t tid);
 int jbd2_complete_transaction(journal_t *journal, tid_t tid);
+int jbd2_fc_begin_commit(journal_t *journal, tid_t tid);
+void jbd2_fc_unlock_updates(journal_t *journal);
+void jbd2_fc_end_commit(journal_t *journal);
+int jbd2_fc_get_buf(journal_t *journal, struct buffer_head **bh_out);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
@@ -753,7 +753,8 @@ struct xps_map {
     / sizeof(u16))
 
 /*
- * This structure holds all XPS maps for device.  Maps are indexed by CPU.
+ * This structure holds all XPS maps for device.  Maps are indexed by CPU,
+ * or by RX queue for the map selected through xps_rxqs.
  */
 struct xps_dev_maps {
 	struct rcu_head rcu;
@@ -761,6 +762,8 @@ struct xps_dev_maps {
 };
 #define XPS_DEV_MAPS_SIZE (sizeof(struct xps_dev_maps) +		\
     (nr_cpu_ids * sizeof(struct xps_map *)))
+#define XPS_RXQ_DEV_MAPS_SIZE(_rxqs) (sizeof(struct xps_dev_maps) +	\
+    ((_rxqs) * sizeof(struct xps_map *)))
 #endif /* CONFIG_XPS */
 
 #define TC_MAX_QUEUE	16
@@ -2008,6 +2011,7 @@ struct net_device {
  *		See dev_set_mtu() in net/core/dev.c
  *	@needs_free_netdev:	Should unregister perform free_netdev?
  *	@priv_destructor:	Called from unregister
+ *	@xps_rxqs_map:	XPS map indexed by the RX queue a flow was received on
  */
 struct net_device_extended {
 #if IS_ENABLED(CONFIG_IPV6)
@@ -2026,6 +2030,9 @@ struct net_device_extended {
 #ifdef CONFIG_NET_SCHED
 	DECLARE_HASHTABLE	(qdisc_hash, 4);
 #endif
+#ifdef CONFIG_XPS
+	struct xps_dev_maps __rcu *xps_rxqs_map;
+#endif
 };
 
 #define to_net_dev(d) container_of(d, struct net_device, dev)
@@ -3244,6 +3251,8 @@ void netif_wake_subqueue(struct net_device *dev, u16 queue_index);
 int netif_set_xps_queue(struct net_device *dev,
 			const struct cpumask *mask,
 			u16 index);
+int __netif_set_xps_queue(struct net_device *dev, const unsigned long *mask,
+			  u16 index, bool is_rxqs_map);
 #else
 static inline int netif_set_xps_queue(struct net_device *dev,
 				      const struct cpumask *mask,
@@ -609,6 +609,9 @@ struct perf_event {
 	RH_KABI_EXTEND(perf_overflow_handler_t		orig_overflow_handler)
 	RH_KABI_EXTEND(struct bpf_prog			*prog)
 #endif
+	/* coalesced ring buffer wakeups, see perf_event_wakeup_delay_ms */
+	RH_KABI_EXTEND(struct hrtimer			wakeup_timer)
+	RH_KABI_EXTEND(atomic_t				wakeup_pending)
 #endif /* CONFIG_PERF_EVENTS */
 };
 
@@ -1032,6 +1035,7 @@ extern int sysctl_perf_event_paranoid;
 extern int sysctl_perf_event_mlock;
 extern int sysctl_perf_event_sample_rate;
 extern int sysctl_perf_cpu_time_max_percent;
+extern int sysctl_perf_event_wakeup_delay_ms;
 
 extern void perf_sample_event_took(u64 sample_len_ns);
 
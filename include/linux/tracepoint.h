@@ -35,6 +35,16 @@ struct tracepoint {
 	struct tracepoint_func __rcu *funcs;
 };
 
+/*
+ * Probe for BPF_PROG_TYPE_RAW_TRACEPOINT programs, one per tracepoint,
+ * generated by <trace/bpf_probe.h>.  Probes are registered by name.
+ */
+struct bpf_raw_event_map {
+	const char	*tp;
+	void		*bpf_func;
+	u32		num_args;
+} __aligned(32);
+
 struct trace_enum_map {
 	const char		*system;
 	const char		*enum_string;
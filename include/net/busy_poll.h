@@ -89,6 +89,7 @@ static inline void skb_mark_napi_id(struct sk_buff *skb,
 static inline void sk_mark_napi_id(struct sock *sk, struct sk_buff *skb)
 {
 	sk->sk_napi_id = skb->napi_id;
+	sk_rx_queue_set(sk, skb);
 }
 
 #else /* CONFIG_NET_RX_BUSY_POLL */
@@ -119,6 +120,7 @@ static inline void skb_mark_napi_id(struct sk_buff *skb,
 
 static inline void sk_mark_napi_id(struct sock *sk, struct sk_buff *skb)
 {
+	sk_rx_queue_set(sk, skb);
 }
 
 static inline bool busy_loop_timeout(unsigned long end_time)
@@ -48,9 +48,11 @@ struct fib_config {
 	struct nl_info		fc_nlinfo;
 	struct nlattr		*fc_encap;
 	u16			fc_encap_type;
+	u32			fc_nh_id;
 };
 
 struct fib_info;
+struct nexthop;
 struct rtable;
 
 struct fib_nh_exception {
@@ -126,6 +128,8 @@ struct fib_info {
 #endif
 	unsigned int		fib_offload_cnt;
 	struct rcu_head		rcu;
+	struct nexthop		*nh;		/* shared nexthop object */
+	struct list_head	nh_list;	/* entry on nh->fi_list */
 	struct fib_nh		fib_nh[0];
 #define fib_dev		fib_nh[0].nh_dev
 };
@@ -162,10 +166,33 @@ struct fib_result_nl {
 	int             err;      
 };
 
+/* Exported by nexthop.c */
+struct fib_nh *nexthop_fib_nh(struct nexthop *nh, int nhsel);
+int nexthop_num_path(const struct nexthop *nh);
+
+/* Routes either carry their own fib_nh array or point at a shared
+ * nexthop object; use these helpers instead of poking at fi->fib_nh.
+ */
+static inline int fib_info_num_path(const struct fib_info *fi)
+{
+	if (unlikely(fi->nh))
+		return nexthop_num_path(fi->nh);
+
+	return fi->fib_nhs;
+}
+
+static inline struct fib_nh *fib_info_nh(struct fib_info *fi, int nhsel)
+{
+	if (unlikely(fi->nh))
+		return nexthop_fib_nh(fi->nh, nhsel);
+
+	return &fi->fib_nh[nhsel];
+}
+
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
-#define FIB_RES_NH(res)		((res).fi->fib_nh[(res).nh_sel])
+#define FIB_RES_NH(res)		(*fib_info_nh((res).fi, (res).nh_sel))
 #else /* CONFIG_IP_ROUTE_MULTIPATH */
-#define FIB_RES_NH(res)		((res).fi->fib_nh[0])
+#define FIB_RES_NH(res)		(*fib_info_nh((res).fi, 0))
 #endif /* CONFIG_IP_ROUTE_MULTIPATH */
 
 #ifdef CONFIG_IP_MULTIPLE_TABLES
@@ -147,6 +147,9 @@ struct neighbour {
 	const struct neigh_ops	*ops;
 	struct rcu_head		rcu;
 	struct net_device	*dev;
+#ifndef __GENKSYMS__
+	struct list_head	gc_list;
+#endif
 	u8			primary_key[0];
 };
 
@@ -209,6 +212,12 @@ struct neigh_table {
 	struct neigh_statistics	__percpu *stats;
 	struct neigh_hash_table __rcu *nht;
 	struct pneigh_entry	**phash_buckets;
+#ifndef __GENKSYMS__
+	/* entries subject to garbage collection, oldest first */
+	struct list_head	gc_list;
+	atomic_t		gc_entries;
+	struct work_struct	hash_grow_work;
+#endif
 };
 
 enum {
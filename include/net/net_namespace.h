@@ -16,6 +16,7 @@
 #include <net/netns/packet.h>
 #include <net/netns/ipv4.h>
 #include <net/netns/ipv6.h>
+#include <net/netns/nexthop.h>
 #include <net/netns/ieee802154_6lowpan.h>
 #include <net/netns/sctp.h>
 #include <net/netns/dccp.h>
@@ -194,6 +195,7 @@ struct net {
 	RH_KABI_EXTEND(struct fib_notifier_ops	*ipv4_ipmr_notifier_ops)
 	RH_KABI_EXTEND(unsigned int ipv4_ipmr_seq)	/* protected by rtnl_mutex */
 	RH_KABI_EXTEND(int ipv4_sysctl_tcp_min_snd_mss)
+	RH_KABI_EXTEND(struct netns_nexthop nexthop)
 };
 
 /*
@@ -14,6 +14,9 @@ struct nf_queue_entry {
 	struct nf_hook_ops	*elem;
 	struct nf_hook_state	state;
 	u16			size; /* sizeof(entry) + saved route keys */
+#ifndef __GENKSYMS__
+	struct hlist_node	hash_node;	/* queue handler's id lookup */
+#endif
 
 	/* extra space to store route keys */
 };
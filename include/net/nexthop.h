@@ -2,7 +2,10 @@
 #define __NET_NEXTHOP_H
 
 #include <linux/rtnetlink.h>
+#include <linux/rbtree.h>
+#include <linux/list.h>
 #include <net/netlink.h>
+#include <net/ip_fib.h>
 
 static inline int rtnh_ok(const struct rtnexthop *rtnh, int remaining)
 {
@@ -30,4 +33,88 @@ static inline int rtnh_attrlen(const struct rtnexthop *rtnh)
 	return rtnh->rtnh_len - NLA_ALIGN(sizeof(*rtnh));
 }
 
+/*
+ * Nexthop objects are created and deleted on their own through
+ * RTM_{NEW,DEL,GET}NEXTHOP and referenced by routes through RTA_NH_ID.
+ * Replacing a nexthop swaps the nh_info/nh_group pointer under RCU, so
+ * all routes using it are updated at once without walking the FIB.
+ */
+
+struct nh_info {
+	struct hlist_node	dev_hash;	/* entry on netns devhash */
+	struct nexthop		*nh_parent;
+
+	u8			family;
+	bool			reject_nh;
+
+	struct fib_nh		fib_nh;
+	struct rcu_head		rcu;
+};
+
+struct nh_grp_entry {
+	struct nexthop		*nh;
+	u16			weight;
+	atomic_t		upper_bound;
+
+	struct list_head	nh_list;	/* entry on nh->grp_list */
+	struct nexthop		*nh_parent;	/* group this entry belongs to */
+};
+
+struct nh_group {
+	struct nh_group		*spare;		/* used when removing an entry */
+	u16			num_nh;
+	bool			mpath;
+	struct rcu_head		rcu;
+	struct nh_grp_entry	nh_entries[0];
+};
+
+struct nexthop {
+	struct rb_node		rb_node;	/* entry on netns rbtree */
+	struct list_head	fi_list;	/* fib_infos using this nexthop */
+	struct list_head	grp_list;	/* group entries using this nexthop */
+	struct net		*net;
+
+	u32			id;
+
+	u8			protocol;	/* app managing this nexthop */
+	u8			nh_flags;
+	bool			is_group;
+
+	atomic_t		refcnt;
+	struct rcu_head		rcu;
+
+	union {
+		struct nh_info	__rcu *nh_info;
+		struct nh_group __rcu *nh_grp;
+	};
+};
+
+/* Exported by nexthop.c */
+struct nexthop *nexthop_find_by_id(struct net *net, u32 id);
+void nexthop_free_rcu(struct rcu_head *head);
+int nexthop_select_path(struct nexthop *nh, int hash);
+int fib_check_nexthop(struct nexthop *nh, u8 scope);
+
+static inline void nexthop_get(struct nexthop *nh)
+{
+	atomic_inc(&nh->refcnt);
+}
+
+static inline void nexthop_put(struct nexthop *nh)
+{
+	if (atomic_dec_and_test(&nh->refcnt))
+		call_rcu(&nh->rcu, nexthop_free_rcu);
+}
+
+static inline bool nexthop_is_blackhole(const struct nexthop *nh)
+{
+	const struct nh_info *nhi;
+
+	if (nh->is_group)
+		return false;
+
+	nhi = rcu_dereference_rtnl(nh->nh_info);
+	return nhi->reject_nh;
+}
+
 #endif
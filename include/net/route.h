@@ -112,6 +112,7 @@ struct in_device;
 extern int		ip_rt_init(void);
 extern void		rt_cache_flush(struct net *net);
 extern void		rt_flush_dev(struct net_device *dev);
+extern void		ip_fwd_cache_flush(void);
 struct rtable *__ip_route_output_key_hash(struct net *net, struct flowi4 *flp,
 					  const struct sk_buff *skb);
 
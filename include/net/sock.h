@@ -299,6 +299,7 @@ struct cg_proto;
   *	@sk_backlog_rcv: callback to process the backlog
   *	@sk_destruct: called at sock freeing time, i.e. when all refcnt == 0
   *	@sk_reuseport_cb: reuseport group container
+  *	@sk_rx_queue_mapping: rx queue number the connection was last seen on
  */
 struct sock {
 	/*
@@ -454,7 +455,7 @@ struct sock {
 	RH_KABI_USE_P(4, sk_rcu.next)
 	RH_KABI_USE_P(5, sk_rcu.func)
 #endif
-	RH_KABI_RESERVE_P(6)
+	RH_KABI_USE_P(6, int sk_rx_queue_mapping)
 	RH_KABI_RESERVE_P(7)
 	RH_KABI_RESERVE_P(8)
 };
@@ -1095,6 +1096,10 @@ struct proto {
 	void			(*destroy_cgroup)(struct mem_cgroup *memcg);
 	struct cg_proto		*(*proto_cgroup)(struct mem_cgroup *memcg);
 #endif
+#ifndef __GENKSYMS__
+	/* Per cpu share of memory_allocated not yet folded into it */
+	int __percpu		*per_cpu_fw_alloc;
+#endif
 };
 
 /*
@@ -1260,6 +1265,51 @@ static inline void memcg_memory_allocated_sub(struct cg_proto *prot,
 	page_counter_uncharge(prot->memory_allocated, amt);
 }
 
+/* 1 MB per cpu, in page units */
+#define SK_MEMORY_PCPU_RESERVE (1 << (20 - PAGE_SHIFT))
+
+/*
+ * Charges and uncharges are first accumulated in a per cpu reserve and
+ * only folded into the shared memory_allocated counter once the reserve
+ * exceeds SK_MEMORY_PCPU_RESERVE in either direction.  Readers of
+ * memory_allocated may thus be off by that much per cpu.
+ */
+static inline void proto_memory_allocated_add(struct proto *prot, int amt)
+{
+	int local_reserve;
+
+	if (!prot->per_cpu_fw_alloc) {
+		atomic_long_add(amt, prot->memory_allocated);
+		return;
+	}
+
+	preempt_disable();
+	local_reserve = __this_cpu_add_return(*prot->per_cpu_fw_alloc, amt);
+	if (local_reserve >= SK_MEMORY_PCPU_RESERVE) {
+		__this_cpu_sub(*prot->per_cpu_fw_alloc, local_reserve);
+		atomic_long_add(local_reserve, prot->memory_allocated);
+	}
+	preempt_enable();
+}
+
+static inline void proto_memory_allocated_sub(struct proto *prot, int amt)
+{
+	int local_reserve;
+
+	if (!prot->per_cpu_fw_alloc) {
+		atomic_long_sub(amt, prot->memory_allocated);
+		return;
+	}
+
+	preempt_disable();
+	local_reserve = __this_cpu_sub_return(*prot->per_cpu_fw_alloc, amt);
+	if (local_reserve <= -SK_MEMORY_PCPU_RESERVE) {
+		__this_cpu_sub(*prot->per_cpu_fw_alloc, local_reserve);
+		atomic_long_add(local_reserve, prot->memory_allocated);
+	}
+	preempt_enable();
+}
+
 static inline long
 sk_memory_allocated(const struct sock *sk)
 {
@@ -1279,11 +1329,12 @@ sk_memory_allocated_add(struct sock *sk, int amt, int *parent_status)
 	if (mem_cgroup_sockets_enabled && sk->sk_cgrp) {
 		memcg_memory_allocated_add(sk->sk_cgrp, amt, parent_status);
 		/* update the root cgroup regardless */
-		atomic_long_add_return(amt, prot->memory_allocated);
+		proto_memory_allocated_add(prot, amt);
 		return page_counter_read(sk->sk_cgrp->memory_allocated);
 	}
 
-	return atomic_long_add_return(amt, prot->memory_allocated);
+	proto_memory_allocated_add(prot, amt);
+	return atomic_long_read(prot->memory_allocated);
 }
 
 static inline void
@@ -1294,7 +1345,7 @@ sk_memory_allocated_sub(struct sock *sk, int amt)
 	if (mem_cgroup_sockets_enabled && sk->sk_cgrp)
 		memcg_memory_allocated_sub(sk->sk_cgrp, amt);
 
-	atomic_long_sub(amt, prot->memory_allocated);
+	proto_memory_allocated_sub(prot, amt);
 }
 
 static inline void sk_sockets_allocated_dec(struct sock *sk)
@@ -1754,6 +1805,22 @@ static inline int sk_tx_queue_get(const struct sock *sk)
 	return sk ? sk->sk_tx_queue_mapping : -1;
 }
 
+static inline void sk_rx_queue_set(struct sock *sk, const struct sk_buff *skb)
+{
+	if (skb_rx_queue_recorded(skb))
+		sk->sk_rx_queue_mapping = skb_get_rx_queue(skb);
+}
+
+static inline void sk_rx_queue_clear(struct sock *sk)
+{
+	sk->sk_rx_queue_mapping = -1;
+}
+
+static inline int sk_rx_queue_get(const struct sock *sk)
+{
+	return sk ? sk->sk_rx_queue_mapping : -1;
+}
+
 static inline void sk_set_socket(struct sock *sk, struct socket *sock)
 {
 	sk_tx_queue_clear(sk);
@@ -90,6 +90,10 @@
 #include <trace/ftrace.h>
 #endif
 
+#ifdef CONFIG_BPF_EVENTS
+#include <trace/bpf_probe.h>
+#endif
+
 #undef TRACE_EVENT
 #undef TRACE_EVENT_FN
 #undef TRACE_EVENT_CONDITION
@@ -494,7 +494,8 @@ static inline notrace int ftrace_get_offsets_##call(			\
  *	int pc;
  *
  *	if (test_bit(FTRACE_EVENT_FL_SOFT_DISABLED_BIT,
- *		     &ftrace_file->flags))
+ *		     &ftrace_file->flags) &&
+ *	    !test_bit(FTRACE_EVENT_FL_HIST_BIT, &ftrace_file->flags))
  *		return;
  *
  *	local_save_flags(irq_flags);
@@ -513,6 +514,9 @@ static inline notrace int ftrace_get_offsets_##call(			\
  *	{ <assign>; }  <-- Here we assign the entries by the __field and
  *			   __array macros.
  *
+ *	if (ftrace_event_hist_discard(ftrace_file, buffer, event, entry))
+ *		return;
+ *
  *	if (!filter_current_check_discard(buffer, event_call, entry, event))
  *		trace_nowake_buffer_unlock_commit(buffer,
  *						   event, irq_flags, pc);
@@ -607,7 +611,8 @@ ftrace_raw_event_##call(void *__data, proto)				\
 	int pc;								\
 									\
 	if (test_bit(FTRACE_EVENT_FL_SOFT_DISABLED_BIT,			\
-		     &ftrace_file->flags))				\
+		     &ftrace_file->flags) &&				\
+	    !test_bit(FTRACE_EVENT_FL_HIST_BIT, &ftrace_file->flags))	\
 		return;							\
 									\
 	local_save_flags(irq_flags);					\
@@ -627,6 +632,9 @@ ftrace_raw_event_##call(void *__data, proto)				\
 									\
 	{ assign; }							\
 									\
+	if (ftrace_event_hist_discard(ftrace_file, buffer, event, entry)) \
+		return;							\
+									\
 	if (!filter_current_check_discard(buffer, event_call, entry, event)) \
 		trace_buffer_unlock_commit(buffer, event, irq_flags, pc); \
 }
@@ -93,6 +93,17 @@ enum bpf_cmd {
 	BPF_MAP_GET_FD_BY_ID,
 	BPF_OBJ_GET_INFO_BY_FD,
 	BPF_PROG_QUERY,
+	BPF_RAW_TRACEPOINT_OPEN,
+	BPF_BTF_LOAD,
+	BPF_BTF_GET_FD_BY_ID,
+	BPF_TASK_FD_QUERY,
+	BPF_MAP_LOOKUP_AND_DELETE_ELEM,
+	BPF_MAP_FREEZE,
+	BPF_BTF_GET_NEXT_ID,
+	BPF_MAP_LOOKUP_BATCH,
+	BPF_MAP_LOOKUP_AND_DELETE_BATCH,
+	BPF_MAP_UPDATE_BATCH,
+	BPF_MAP_DELETE_BATCH,
 };
 
 enum bpf_map_type {
@@ -111,6 +122,19 @@ enum bpf_map_type {
 	BPF_MAP_TYPE_ARRAY_OF_MAPS,
 	BPF_MAP_TYPE_HASH_OF_MAPS,
 	BPF_MAP_TYPE_DEVMAP,
+	BPF_MAP_TYPE_SOCKMAP,
+	BPF_MAP_TYPE_CPUMAP,
+	BPF_MAP_TYPE_XSKMAP,
+	BPF_MAP_TYPE_SOCKHASH,
+	BPF_MAP_TYPE_CGROUP_STORAGE,
+	BPF_MAP_TYPE_REUSEPORT_SOCKARRAY,
+	BPF_MAP_TYPE_PERCPU_CGROUP_STORAGE,
+	BPF_MAP_TYPE_QUEUE,
+	BPF_MAP_TYPE_STACK,
+	BPF_MAP_TYPE_SK_STORAGE,
+	BPF_MAP_TYPE_DEVMAP_HASH,
+	BPF_MAP_TYPE_STRUCT_OPS,
+	BPF_MAP_TYPE_RINGBUF,
 };
 
 enum bpf_prog_type {
@@ -128,6 +152,10 @@ enum bpf_prog_type {
 	BPF_PROG_TYPE_LWT_OUT,
 	BPF_PROG_TYPE_LWT_XMIT,
 	BPF_PROG_TYPE_SOCK_OPS,
+	BPF_PROG_TYPE_SK_SKB,
+	BPF_PROG_TYPE_CGROUP_DEVICE,
+	BPF_PROG_TYPE_SK_MSG,
+	BPF_PROG_TYPE_RAW_TRACEPOINT,
 };
 
 enum bpf_attach_type {
@@ -225,6 +253,11 @@ enum bpf_attach_type {
 
 /* Flag for stack_map, store build_id+offset instead of pointer */
 #define BPF_F_STACK_BUILD_ID	(1U << 5)
+/* Flag for stack_map, prefix each trace with a __u64 count of the
+ * bpf_get_stackid() calls that returned its id.  RHEL-specific, kept
+ * at the top of map_flags, clear of the bits upstream allocates from 0.
+ */
+#define BPF_F_STACK_HIT_COUNT	(1U << 31)
 
 enum bpf_stack_build_id_status {
 	/* user space need an empty entry to identify end of a trace */
@@ -259,6 +292,10 @@ union bpf_attr {
 					 * BPF_F_NUMA_NODE is set).
 					 */
 		char	map_name[BPF_OBJ_NAME_LEN];
+		__u32	map_ifindex;	/* not supported, must be 0 */
+		__u32	btf_fd;		/* fd pointing to a BTF type data */
+		__u32	btf_key_type_id;	/* BTF type_id of the key */
+		__u32	btf_value_type_id;	/* BTF type_id of the value */
 	};
 
 	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
@@ -318,6 +355,7 @@ union bpf_attr {
 			__u32		start_id;
 			__u32		prog_id;
 			__u32		map_id;
+			__u32		btf_id;
 		};
 		__u32		next_id;
 		__u32		open_flags;
@@ -337,6 +375,36 @@ union bpf_attr {
 		__aligned_u64	prog_ids;
 		__u32		prog_cnt;
 	} query;
+
+	struct {
+		__u64 name;
+		__u32 prog_fd;
+	} raw_tracepoint;
+
+	struct { /* anonymous struct for BPF_BTF_LOAD */
+		__aligned_u64	btf;
+		__aligned_u64	btf_log_buf;
+		__u32		btf_size;
+		__u32		btf_log_size;
+		__u32		btf_log_level;
+	};
+
+	struct { /* anonymous struct used by BPF_MAP_*_BATCH commands */
+		__aligned_u64	in_batch;	/* start batch,
+						 * NULL to start from beginning
+						 */
+		__aligned_u64	out_batch;	/* output: next start batch */
+		__aligned_u64	keys;
+		__aligned_u64	values;
+		__u32		count;		/* input/output:
+						 * input: # of key/value
+						 * elements
+						 * output: # of filled elements
+						 */
+		__u32		map_fd;
+		__u64		elem_flags;
+		__u64		flags;
+	} batch;
 } __attribute__((aligned(8)));
 
 /* User return codes for XDP prog type.
@@ -543,6 +611,62 @@ struct xdp_md {
  *     @buf: buf to fill
  *     @buf_size: size of the buf
  *     Return : 0 on success or negative error code
+ *
+ * int bpf_ringbuf_output(map, data, size, flags)
+ *     copy size bytes from data into a new record of ring buffer map
+ *     @map: pointer to ringbuf map
+ *     @data: data to copy
+ *     @size: size of the record
+ *     @flags: BPF_RB_NO_WAKEUP or BPF_RB_FORCE_WAKEUP, or 0 to wake up
+ *             the consumer only when it has caught up with the producer
+ *     Return: 0 on success or negative error code
+ *
+ * void *bpf_ringbuf_reserve(map, size, flags)
+ *     reserve a record in ring buffer map, to be filled in place and
+ *     passed to bpf_ringbuf_submit() or bpf_ringbuf_discard()
+ *     @map: pointer to ringbuf map
+ *     @size: size of the record, must be the map's value_size
+ *     @flags: must be 0
+ *     Return: pointer to the record or NULL if the ring buffer is full
+ *
+ * void bpf_ringbuf_submit(data, flags)
+ *     hand a reserved record over to the consumer
+ *     @data: record returned by bpf_ringbuf_reserve()
+ *     @flags: same as for bpf_ringbuf_output()
+ *
+ * void bpf_ringbuf_discard(data, flags)
+ *     drop a reserved record, the consumer skips over it
+ *     @data: record returned by bpf_ringbuf_reserve()
+ *     @flags: same as for bpf_ringbuf_output()
+ *
+ * u64 bpf_ringbuf_query(map, flags)
+ *     @map: pointer to ringbuf map
+ *     @flags: BPF_RB_AVAIL_DATA, BPF_RB_RING_SIZE, BPF_RB_CONS_POS or
+ *             BPF_RB_PROD_POS
+ *     Return: requested property of the ring buffer, 0 for unknown flags
+ *
+ * int bpf_map_push_elem(map, value, flags)
+ *     push an element onto a queue or stack map
+ *     @map: pointer to queue or stack map
+ *     @value: value to push
+ *     @flags: BPF_EXIST to drop the oldest element if the map is full,
+ *             or 0 to fail instead
+ *     Return: 0 on success or negative error code, -EBUSY if called
+ *     from NMI while the map is locked
+ *
+ * int bpf_map_pop_elem(map, value)
+ *     remove the head of a queue or the top of a stack and copy it out
+ *     @map: pointer to queue or stack map
+ *     @value: buffer of the map's value_size to copy the element into
+ *     Return: 0 on success, -ENOENT if the map is empty, or -EBUSY if
+ *     called from NMI while the map is locked
+ *
+ * int bpf_map_peek_elem(map, value)
+ *     same as bpf_map_pop_elem() without removing the element
+ *     @map: pointer to queue or stack map
+ *     @value: buffer of the map's value_size to copy the element into
+ *     Return: 0 on success, -ENOENT if the map is empty, or -EBUSY if
+ *     called from NMI while the map is locked
  */
 #define __BPF_FUNC_MAPPER(FN)		\
 	FN(unspec),			\
@@ -604,7 +728,15 @@ struct xdp_md {
 	FN(perf_prog_read_value),	\
 	FN(getsockopt),			\
 	FN(override_return),		\
-	FN(sock_ops_cb_flags_set),
+	FN(sock_ops_cb_flags_set),	\
+	FN(ringbuf_output),		\
+	FN(ringbuf_reserve),		\
+	FN(ringbuf_submit),		\
+	FN(ringbuf_discard),		\
+	FN(ringbuf_query),		\
+	FN(map_push_elem),		\
+	FN(map_pop_elem),		\
+	FN(map_peek_elem),
 
 /* integer value in 'imm' field of BPF_CALL instruction selects which helper
  * function eBPF program intends to call
@@ -630,6 +762,27 @@ enum bpf_func_id {
 /* BPF_FUNC_perf_event_output for sk_buff input context. */
 #define BPF_F_CTXLEN_MASK		(0xfffffULL << 32)
 
+/* BPF_FUNC_ringbuf_output, BPF_FUNC_ringbuf_submit and
+ * BPF_FUNC_ringbuf_discard flags.
+ */
+#define BPF_RB_NO_WAKEUP		(1ULL << 0)
+#define BPF_RB_FORCE_WAKEUP		(1ULL << 1)
+
+/* BPF_FUNC_ringbuf_query flags */
+enum {
+	BPF_RB_AVAIL_DATA = 0,
+	BPF_RB_RING_SIZE = 1,
+	BPF_RB_CONS_POS = 2,
+	BPF_RB_PROD_POS = 3,
+};
+
+/* BPF ring buffer record header, see kernel/bpf/ringbuf.c */
+enum {
+	BPF_RINGBUF_BUSY_BIT		= (1U << 31),
+	BPF_RINGBUF_DISCARD_BIT		= (1U << 30),
+	BPF_RINGBUF_HDR_SZ		= 8,
+};
+
 /* user accessible mirror of in-kernel sk_buff.
  * new fields can only be added to the end of this structure
  */
@@ -670,6 +823,11 @@ struct bpf_prog_info {
 	char name[BPF_OBJ_NAME_LEN];
 	__u32 ifindex;
 	__u32 gpl_compatible:1;
+	__u32 :31; /* alignment pad */
+	__u64 netns_dev;
+	__u64 netns_ino;
+	__u64 run_time_ns;
+	__u64 run_cnt;
 } __attribute__((aligned(8)));
 
 struct bpf_map_info {
@@ -680,8 +838,25 @@ struct bpf_map_info {
 	__u32 max_entries;
 	__u32 map_flags;
 	char  name[BPF_OBJ_NAME_LEN];
+	__u32 ifindex;
+	__u32 :32;
+	__u64 netns_dev;
+	__u64 netns_ino;
+	__u32 btf_id;
+	__u32 btf_key_type_id;
+	__u32 btf_value_type_id;
 } __attribute__((aligned(8)));
 
+struct bpf_btf_info {
+	__aligned_u64 btf;
+	__u32 btf_size;
+	__u32 id;
+} __attribute__((aligned(8)));
+
+struct bpf_raw_tracepoint_args {
+	__u64 args[0];
+};
+
 struct bpf_perf_event_value {
 	__u64 counter;
 	__u64 enabled;
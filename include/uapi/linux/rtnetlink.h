@@ -144,6 +144,13 @@ enum {
 	RTM_GETSTATS = 94,
 #define RTM_GETSTATS RTM_GETSTATS
 
+	RTM_NEWNEXTHOP = 104,
+#define RTM_NEWNEXTHOP	RTM_NEWNEXTHOP
+	RTM_DELNEXTHOP,
+#define RTM_DELNEXTHOP	RTM_DELNEXTHOP
+	RTM_GETNEXTHOP,
+#define RTM_GETNEXTHOP	RTM_GETNEXTHOP
+
 	__RTM_MAX,
 #define RTM_MAX		(((__RTM_MAX + 3) & ~3) - 1)
 };
@@ -316,6 +323,12 @@ enum rtattr_type_t {
 	RTA_ENCAP,
 	RTA_EXPIRES,
 	RTA_PAD,
+	__RH_RESERVED_RTA_UID,
+	__RH_RESERVED_RTA_TTL_PROPAGATE,
+	__RH_RESERVED_RTA_IP_PROTO,
+	__RH_RESERVED_RTA_SPORT,
+	__RH_RESERVED_RTA_DPORT,
+	RTA_NH_ID,
 	__RTA_MAX
 };
 
@@ -666,6 +679,11 @@ enum rtnetlink_groups {
 	__RH_RESERVED_RTNLGRP_MPLS_ROUTE,
 	RTNLGRP_NSID,
 #define RTNLGRP_NSID		RTNLGRP_NSID
+	__RH_RESERVED_RTNLGRP_MPLS_NETCONF,
+	__RH_RESERVED_RTNLGRP_IPV4_MROUTE_R,
+	__RH_RESERVED_RTNLGRP_IPV6_MROUTE_R,
+	RTNLGRP_NEXTHOP,
+#define RTNLGRP_NEXTHOP		RTNLGRP_NEXTHOP
 	__RTNLGRP_MAX
 };
 #define RTNLGRP_MAX	(__RTNLGRP_MAX - 1)
@@ -7,6 +7,7 @@
 #include <linux/cpumask.h>
 #include <linux/spinlock.h>
 #include <linux/percpu.h>
+#include <linux/slab.h>
 
 #include "bpf_lru_list.h"
 
@@ -16,6 +17,10 @@
 #define PERCPU_FREE_TARGET		(4)
 #define PERCPU_NR_SCANS			PERCPU_FREE_TARGET
 
+/* Max number of CPUs sharing one shard of the common LRU list */
+#define SHARD_NR_CPUS			(8)
+#define SHARD_UNSET			((u16)~0U)
+
 /* Helpers to get the local list index */
 #define LOCAL_LIST_IDX(t)	((t) - BPF_LOCAL_LIST_T_OFFSET)
 #define LOCAL_FREE_LIST_IDX	LOCAL_LIST_IDX(BPF_LRU_LOCAL_LIST_T_FREE)
@@ -47,6 +52,26 @@ static bool bpf_lru_node_is_ref(const struct bpf_lru_node *node)
 	return node->ref;
 }
 
+static bool bpf_lru_del_from_htab(struct bpf_lru *lru,
+				  struct bpf_lru_node *node)
+{
+	if (!lru->del_from_htab(lru->del_arg, node))
+		return false;
+
+	this_cpu_inc(lru->stats->evictions);
+	return true;
+}
+
+/* Take l->lock, counting how often somebody else was holding it */
+static void bpf_lru_list_lock(struct bpf_lru *lru, struct bpf_lru_list *l)
+{
+	if (raw_spin_trylock(&l->lock))
+		return;
+
+	this_cpu_inc(lru->stats->contended);
+	raw_spin_lock(&l->lock);
+}
+
 static void bpf_lru_list_count_inc(struct bpf_lru_list *l,
 				   enum bpf_lru_list_type type)
 {
@@ -220,7 +245,7 @@ __bpf_lru_list_shrink_inactive(struct bpf_lru *lru,
 	list_for_each_entry_safe_reverse(node, tmp_node, inactive, list) {
 		if (bpf_lru_node_is_ref(node)) {
 			__bpf_lru_node_move(l, node, BPF_LRU_LIST_T_ACTIVE);
-		} else if (lru->del_from_htab(lru->del_arg, node)) {
+		} else if (bpf_lru_del_from_htab(lru, node)) {
 			__bpf_lru_node_move_to_free(l, node, free_list,
 						    tgt_free_type);
 			if (++nshrinked == tgt_nshrink)
@@ -279,7 +304,7 @@ static unsigned int __bpf_lru_list_shrink(struct bpf_lru *lru,
 
 	list_for_each_entry_safe_reverse(node, tmp_node, force_shrink_list,
 					 list) {
-		if (lru->del_from_htab(lru->del_arg, node)) {
+		if (bpf_lru_del_from_htab(lru, node)) {
 			__bpf_lru_node_move_to_free(l, node, free_list,
 						    tgt_free_type);
 			return 1;
@@ -297,6 +322,7 @@ static void __local_list_flush(struct bpf_lru_list *l,
 
 	list_for_each_entry_safe_reverse(node, tmp_node,
 					 local_pending_list(loc_l), list) {
+		node->shard = loc_l->shard;
 		if (bpf_lru_node_is_ref(node))
 			__bpf_lru_node_move_in(l, node, BPF_LRU_LIST_T_ACTIVE);
 		else
@@ -305,7 +331,8 @@ static void __local_list_flush(struct bpf_lru_list *l,
 	}
 }
 
-static void bpf_lru_list_push_free(struct bpf_lru_list *l,
+static void bpf_lru_list_push_free(struct bpf_lru *lru,
+				   struct bpf_lru_list *l,
 				   struct bpf_lru_node *node)
 {
 	unsigned long flags;
@@ -313,24 +340,23 @@ static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 	if (WARN_ON_ONCE(IS_LOCAL_LIST_TYPE(node->type)))
 		return;
 
-	raw_spin_lock_irqsave(&l->lock, flags);
+	local_irq_save(flags);
+	bpf_lru_list_lock(lru, l);
 	__bpf_lru_node_move(l, node, BPF_LRU_LIST_T_FREE);
 	raw_spin_unlock_irqrestore(&l->lock, flags);
 }
 
-static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
-					   struct bpf_lru_locallist *loc_l)
+/* Move up to LOCAL_FREE_TARGET free nodes from l to the local free list,
+ * shrinking l if it does not have enough of them.  Called with l->lock
+ * held.
+ */
+static unsigned int __bpf_lru_list_refill_local(struct bpf_lru *lru,
+						struct bpf_lru_list *l,
+						struct bpf_lru_locallist *loc_l)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	struct bpf_lru_node *node, *tmp_node;
 	unsigned int nfree = 0;
 
-	raw_spin_lock(&l->lock);
-
-	__local_list_flush(l, loc_l);
-
-	__bpf_lru_list_rotate(lru, l);
-
 	list_for_each_entry_safe(node, tmp_node, &l->lists[BPF_LRU_LIST_T_FREE],
 				 list) {
 		__bpf_lru_node_move_to_free(l, node, local_free_list(loc_l),
@@ -340,11 +366,52 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 	}
 
 	if (nfree < LOCAL_FREE_TARGET)
-		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
-				      local_free_list(loc_l),
-				      BPF_LRU_LOCAL_LIST_T_FREE);
+		nfree += __bpf_lru_list_shrink(lru, l,
+					       LOCAL_FREE_TARGET - nfree,
+					       local_free_list(loc_l),
+					       BPF_LRU_LOCAL_LIST_T_FREE);
+
+	return nfree;
+}
+
+static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
+					   struct bpf_lru_locallist *loc_l)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+	struct bpf_lru_list *l = &clru->lru_lists[loc_l->shard];
+	unsigned int nfree, shard, i;
+
+	bpf_lru_list_lock(lru, l);
+
+	__local_list_flush(l, loc_l);
+
+	__bpf_lru_list_rotate(lru, l);
+
+	nfree = __bpf_lru_list_refill_local(lru, l, loc_l);
 
 	raw_spin_unlock(&l->lock);
+
+	/* Our shard only runs dry once the CPUs of the other shards have
+	 * pulled all of its nodes over.  Take them back from whichever
+	 * shard is not busy, and only wait for a lock if all of them are.
+	 */
+	for (i = 1; !nfree && i < 2 * clru->nr_shards; i++) {
+		shard = (loc_l->shard + i) % clru->nr_shards;
+		if (shard == loc_l->shard)
+			continue;
+
+		l = &clru->lru_lists[shard];
+		if (i < clru->nr_shards) {
+			if (!raw_spin_trylock(&l->lock))
+				continue;
+		} else {
+			bpf_lru_list_lock(lru, l);
+		}
+
+		nfree = __bpf_lru_list_refill_local(lru, l, loc_l);
+
+		raw_spin_unlock(&l->lock);
+	}
 }
 
 static void __local_list_add_pending(struct bpf_lru *lru,
@@ -385,7 +452,7 @@ ignore_ref:
 	list_for_each_entry_reverse(node, local_pending_list(loc_l),
 				    list) {
 		if ((!bpf_lru_node_is_ref(node) || force) &&
-		    lru->del_from_htab(lru->del_arg, node)) {
+		    bpf_lru_del_from_htab(lru, node)) {
 			list_del(&node->list);
 			return node;
 		}
@@ -410,7 +477,8 @@ static struct bpf_lru_node *bpf_percpu_lru_pop_free(struct bpf_lru *lru,
 
 	l = per_cpu_ptr(lru->percpu_lru, cpu);
 
-	raw_spin_lock_irqsave(&l->lock, flags);
+	local_irq_save(flags);
+	bpf_lru_list_lock(lru, l);
 
 	__bpf_lru_list_rotate(lru, l);
 
@@ -496,10 +564,17 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 struct bpf_lru_node *bpf_lru_pop_free(struct bpf_lru *lru, u32 hash)
 {
+	struct bpf_lru_node *node;
+
 	if (lru->percpu)
-		return bpf_percpu_lru_pop_free(lru, hash);
+		node = bpf_percpu_lru_pop_free(lru, hash);
 	else
-		return bpf_common_lru_pop_free(lru, hash);
+		node = bpf_common_lru_pop_free(lru, hash);
+
+	if (node)
+		this_cpu_inc(lru->stats->inserts);
+
+	return node;
 }
 
 static void bpf_common_lru_push_free(struct bpf_lru *lru,
@@ -532,7 +607,8 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
-	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
+	bpf_lru_list_push_free(lru, &lru->common_lru.lru_lists[node->shard],
+			       node);
 }
 
 static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
@@ -543,7 +619,8 @@ static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
 
 	l = per_cpu_ptr(lru->percpu_lru, node->cpu);
 
-	raw_spin_lock_irqsave(&l->lock, flags);
+	local_irq_save(flags);
+	bpf_lru_list_lock(lru, l);
 
 	__bpf_lru_node_move(l, node, BPF_LRU_LIST_T_FREE);
 
@@ -562,13 +639,19 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 				    u32 node_offset, u32 elem_size,
 				    u32 nr_elems)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
-	u32 i;
+	struct bpf_common_lru *clru = &lru->common_lru;
+	u32 i, shard_entries;
+
+	/* spread the elements evenly over the shards */
+	shard_entries = DIV_ROUND_UP(nr_elems, clru->nr_shards);
 
 	for (i = 0; i < nr_elems; i++) {
+		struct bpf_lru_list *l;
 		struct bpf_lru_node *node;
 
 		node = (struct bpf_lru_node *)(buf + node_offset);
+		node->shard = i / shard_entries;
+		l = &clru->lru_lists[node->shard];
 		node->type = BPF_LRU_LIST_T_FREE;
 		node->ref = 0;
 		list_add(&node->list, &l->lists[BPF_LRU_LIST_T_FREE]);
@@ -626,6 +709,7 @@ static void bpf_lru_locallist_init(struct bpf_lru_locallist *loc_l, int cpu)
 		INIT_LIST_HEAD(&loc_l->lists[i]);
 
 	loc_l->next_steal = cpu;
+	loc_l->shard = SHARD_UNSET;
 
 	raw_spin_lock_init(&loc_l->lock);
 }
@@ -645,15 +729,56 @@ static void bpf_lru_list_init(struct bpf_lru_list *l)
 	raw_spin_lock_init(&l->lock);
 }
 
+/* Group the CPUs of each NUMA node into shards of at most SHARD_NR_CPUS
+ * CPUs and return the number of shards.
+ */
+static unsigned int bpf_common_lru_assign_shards(struct bpf_common_lru *clru)
+{
+	struct bpf_lru_locallist *loc_l;
+	unsigned int nr_shards = 0, n;
+	int cpu, nid;
+
+	for_each_node(nid) {
+		n = 0;
+		for_each_possible_cpu(cpu) {
+			if (cpu_to_node(cpu) != nid)
+				continue;
+
+			if (n++ % SHARD_NR_CPUS == 0)
+				nr_shards++;
+
+			loc_l = per_cpu_ptr(clru->local_list, cpu);
+			loc_l->shard = nr_shards - 1;
+		}
+	}
+
+	/* CPUs without a known node go to the first shard */
+	for_each_possible_cpu(cpu) {
+		loc_l = per_cpu_ptr(clru->local_list, cpu);
+		if (loc_l->shard != SHARD_UNSET)
+			continue;
+
+		if (!nr_shards)
+			nr_shards = 1;
+		loc_l->shard = 0;
+	}
+
+	return nr_shards;
+}
+
 int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		 del_from_htab_func del_from_htab, void *del_arg)
 {
 	int cpu;
 
+	lru->stats = alloc_percpu(struct bpf_lru_stats);
+	if (!lru->stats)
+		return -ENOMEM;
+
 	if (percpu) {
 		lru->percpu_lru = alloc_percpu(struct bpf_lru_list);
 		if (!lru->percpu_lru)
-			return -ENOMEM;
+			goto free_stats;
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_list *l;
@@ -664,10 +789,11 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		lru->nr_scans = PERCPU_NR_SCANS;
 	} else {
 		struct bpf_common_lru *clru = &lru->common_lru;
+		unsigned int i;
 
 		clru->local_list = alloc_percpu(struct bpf_lru_locallist);
 		if (!clru->local_list)
-			return -ENOMEM;
+			goto free_stats;
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_locallist *loc_l;
@@ -676,7 +802,17 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 			bpf_lru_locallist_init(loc_l, cpu);
 		}
 
-		bpf_lru_list_init(&clru->lru_list);
+		clru->nr_shards = bpf_common_lru_assign_shards(clru);
+		clru->lru_lists = kcalloc(clru->nr_shards,
+					  sizeof(struct bpf_lru_list),
+					  GFP_USER | __GFP_NOWARN);
+		if (!clru->lru_lists) {
+			free_percpu(clru->local_list);
+			goto free_stats;
+		}
+
+		for (i = 0; i < clru->nr_shards; i++)
+			bpf_lru_list_init(&clru->lru_lists[i]);
 		lru->nr_scans = LOCAL_NR_SCANS;
 	}
 
@@ -686,12 +822,34 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 	lru->hash_offset = hash_offset;
 
 	return 0;
+
+free_stats:
+	free_percpu(lru->stats);
+	return -ENOMEM;
 }
 
 void bpf_lru_destroy(struct bpf_lru *lru)
 {
-	if (lru->percpu)
+	if (lru->percpu) {
 		free_percpu(lru->percpu_lru);
-	else
+	} else {
+		kfree(lru->common_lru.lru_lists);
 		free_percpu(lru->common_lru.local_list);
+	}
+	free_percpu(lru->stats);
+}
+
+void bpf_lru_get_stats(struct bpf_lru *lru, struct bpf_lru_stats *stats)
+{
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for_each_possible_cpu(cpu) {
+		struct bpf_lru_stats *s = per_cpu_ptr(lru->stats, cpu);
+
+		stats->inserts += s->inserts;
+		stats->evictions += s->evictions;
+		stats->contended += s->contended;
+	}
 }
@@ -28,6 +28,7 @@ struct bpf_lru_node {
 	u16 cpu;
 	u8 type;
 	u8 ref;
+	u16 shard;
 };
 
 struct bpf_lru_list {
@@ -42,14 +43,27 @@ struct bpf_lru_list {
 struct bpf_lru_locallist {
 	struct list_head lists[NR_BPF_LRU_LOCAL_LIST_T];
 	u16 next_steal;
+	u16 shard;
 	raw_spinlock_t lock;
 };
 
+/* The common LRU list is split into shards, each one serving the local
+ * lists of a small group of CPUs of the same NUMA node.  Refilling a
+ * local free list only takes the lock of the CPU's own shard, other
+ * shards are only visited once it has run dry.
+ */
 struct bpf_common_lru {
-	struct bpf_lru_list lru_list;
+	struct bpf_lru_list *lru_lists;
+	unsigned int nr_shards;
 	struct bpf_lru_locallist __percpu *local_list;
 };
 
+struct bpf_lru_stats {
+	u64 inserts;
+	u64 evictions;
+	u64 contended;
+};
+
 typedef bool (*del_from_htab_func)(void *arg, struct bpf_lru_node *node);
 
 struct bpf_lru {
@@ -57,6 +71,7 @@ struct bpf_lru {
 		struct bpf_common_lru common_lru;
 		struct bpf_lru_list __percpu *percpu_lru;
 	};
+	struct bpf_lru_stats __percpu *stats;
 	del_from_htab_func del_from_htab;
 	void *del_arg;
 	unsigned int hash_offset;
@@ -81,5 +96,6 @@ void bpf_lru_destroy(struct bpf_lru *lru);
 struct bpf_lru_node *bpf_lru_pop_free(struct bpf_lru *lru, u32 hash);
 void bpf_lru_push_free(struct bpf_lru *lru, struct bpf_lru_node *node);
 void bpf_lru_promote(struct bpf_lru *lru, struct bpf_lru_node *node);
+void bpf_lru_get_stats(struct bpf_lru *lru, struct bpf_lru_stats *stats);
 
 #endif
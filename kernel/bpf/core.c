@@ -28,6 +28,7 @@
 #include <linux/moduleloader.h>
 #include <linux/bpf.h>
 #include <linux/frame.h>
+#include <linux/sysctl.h>
 
 #include <asm/unaligned.h>
 
@@ -91,6 +92,13 @@ struct bpf_prog *bpf_prog_alloc(unsigned int size, gfp_t gfp_extra_flags)
 		return NULL;
 	}
 
+	aux->stats = alloc_percpu(struct bpf_prog_stats);
+	if (!aux->stats) {
+		kfree(aux);
+		vfree(fp);
+		return NULL;
+	}
+
 	fp->pages = size / PAGE_SIZE;
 	fp->aux = aux;
 	fp->aux->prog = fp;
@@ -143,10 +151,38 @@ struct bpf_prog *bpf_prog_realloc(struct bpf_prog *fp_old, unsigned int size,
 
 void __bpf_prog_free(struct bpf_prog *fp)
 {
+	if (fp->aux)
+		free_percpu(fp->aux->stats);
 	kfree(fp->aux);
 	vfree(fp);
 }
 
+struct static_key bpf_stats_enabled_key = STATIC_KEY_INIT_FALSE;
+int sysctl_bpf_stats_enabled __read_mostly;
+
+int bpf_stats_handler(struct ctl_table *table, int write,
+		      void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	static DEFINE_MUTEX(bpf_stats_mutex);
+	int ret, old;
+
+	if (write && !capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	mutex_lock(&bpf_stats_mutex);
+	old = sysctl_bpf_stats_enabled;
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (write && !ret && old != sysctl_bpf_stats_enabled) {
+		if (sysctl_bpf_stats_enabled)
+			static_key_slow_inc(&bpf_stats_enabled_key);
+		else
+			static_key_slow_dec(&bpf_stats_enabled_key);
+	}
+	mutex_unlock(&bpf_stats_mutex);
+
+	return ret;
+}
+
 int bpf_prog_calc_tag(struct bpf_prog *fp)
 {
 	const u32 bits_offset = SHA_MESSAGE_BYTES - sizeof(__be64);
@@ -1621,6 +1657,9 @@ BPF_CALL_0(bpf_user_rnd_u32)
 const struct bpf_func_proto bpf_map_lookup_elem_proto __weak;
 const struct bpf_func_proto bpf_map_update_elem_proto __weak;
 const struct bpf_func_proto bpf_map_delete_elem_proto __weak;
+const struct bpf_func_proto bpf_map_push_elem_proto __weak;
+const struct bpf_func_proto bpf_map_pop_elem_proto __weak;
+const struct bpf_func_proto bpf_map_peek_elem_proto __weak;
 
 const struct bpf_func_proto bpf_get_prandom_u32_proto __weak;
 const struct bpf_func_proto bpf_get_smp_processor_id_proto __weak;
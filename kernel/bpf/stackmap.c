@@ -15,12 +15,13 @@
 
 #define STACK_CREATE_FLAG_MASK					\
 	(BPF_F_NUMA_NODE | BPF_F_RDONLY | BPF_F_WRONLY |	\
-	 BPF_F_STACK_BUILD_ID)
+	 BPF_F_STACK_BUILD_ID | BPF_F_STACK_HIT_COUNT)
 
 struct stack_map_bucket {
 	struct pcpu_freelist_node fnode;
 	u32 hash;
 	u32 nr;
+	atomic64_t hits;
 	u64 data[];
 };
 
@@ -43,6 +44,23 @@ static inline int stack_map_data_size(struct bpf_map *map)
 		sizeof(struct bpf_stack_build_id) : sizeof(u64);
 }
 
+static inline bool stack_map_use_hit_count(struct bpf_map *map)
+{
+	return (map->map_flags & BPF_F_STACK_HIT_COUNT);
+}
+
+/* with BPF_F_STACK_HIT_COUNT the value starts with a u64 hit count */
+static inline u32 stack_map_hdr_size(struct bpf_map *map)
+{
+	return stack_map_use_hit_count(map) ? sizeof(u64) : 0;
+}
+
+static inline u32 stack_map_max_depth(struct bpf_map *map)
+{
+	return (map->value_size - stack_map_hdr_size(map)) /
+		stack_map_data_size(map);
+}
+
 static int prealloc_elems_and_freelist(struct bpf_stack_map *smap)
 {
 	u32 elem_size = sizeof(struct stack_map_bucket) + smap->map.value_size;
@@ -70,6 +88,7 @@ free_elems:
 static struct bpf_map *stack_map_alloc(union bpf_attr *attr)
 {
 	u32 value_size = attr->value_size;
+	u32 trace_size = value_size;
 	struct bpf_stack_map *smap;
 	u64 cost, n_buckets;
 	int err;
@@ -85,13 +104,19 @@ static struct bpf_map *stack_map_alloc(union bpf_attr *attr)
 	    value_size < 8 || value_size % 8)
 		return ERR_PTR(-EINVAL);
 
+	if (attr->map_flags & BPF_F_STACK_HIT_COUNT) {
+		trace_size -= sizeof(u64);
+		if (!trace_size)
+			return ERR_PTR(-EINVAL);
+	}
+
 	BUILD_BUG_ON(sizeof(struct bpf_stack_build_id) % sizeof(u64));
 	if (attr->map_flags & BPF_F_STACK_BUILD_ID) {
-		if (value_size % sizeof(struct bpf_stack_build_id) ||
-		    value_size / sizeof(struct bpf_stack_build_id)
+		if (trace_size % sizeof(struct bpf_stack_build_id) ||
+		    trace_size / sizeof(struct bpf_stack_build_id)
 		    > PERF_MAX_STACK_DEPTH)
 			return ERR_PTR(-EINVAL);
-	} else if (value_size / 8 > PERF_MAX_STACK_DEPTH)
+	} else if (trace_size / 8 > PERF_MAX_STACK_DEPTH)
 		return ERR_PTR(-EINVAL);
 
 	/* hash table size must be power of 2 */
@@ -313,7 +338,7 @@ BPF_CALL_3(bpf_get_stackid, struct pt_regs *, regs, struct bpf_map *, map,
 	struct bpf_stack_map *smap = container_of(map, struct bpf_stack_map, map);
 	struct perf_callchain_entry *trace;
 	struct stack_map_bucket *bucket, *new_bucket, *old_bucket;
-	u32 max_depth = map->value_size / stack_map_data_size(map);
+	u32 max_depth = stack_map_max_depth(map);
 	/* stack_map_alloc() checks that max_depth <= PERF_MAX_STACK_DEPTH */
 	u32 init_nr = PERF_MAX_STACK_DEPTH - max_depth;
 	u32 skip = flags & BPF_F_SKIP_FIELD_MASK;
@@ -352,7 +377,7 @@ BPF_CALL_3(bpf_get_stackid, struct pt_regs *, regs, struct bpf_map *, map,
 	hash_matches = bucket && bucket->hash == hash;
 	/* fast cmp */
 	if (hash_matches && flags & BPF_F_FAST_STACK_CMP)
-		return id;
+		goto hit;
 
 	if (stack_map_use_build_id(map)) {
 		/* for build_id+offset, pop a bucket before slow cmp */
@@ -366,7 +391,7 @@ BPF_CALL_3(bpf_get_stackid, struct pt_regs *, regs, struct bpf_map *, map,
 		if (hash_matches && bucket->nr == trace_nr &&
 		    memcmp(bucket->data, new_bucket->data, trace_len) == 0) {
 			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
-			return id;
+			goto hit;
 		}
 		if (bucket && !(flags & BPF_F_REUSE_STACKID)) {
 			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
@@ -375,7 +400,7 @@ BPF_CALL_3(bpf_get_stackid, struct pt_regs *, regs, struct bpf_map *, map,
 	} else {
 		if (hash_matches && bucket->nr == trace_nr &&
 		    memcmp(bucket->data, ips, trace_len) == 0)
-			return id;
+			goto hit;
 		if (bucket && !(flags & BPF_F_REUSE_STACKID))
 			return -EEXIST;
 
@@ -388,11 +413,21 @@ BPF_CALL_3(bpf_get_stackid, struct pt_regs *, regs, struct bpf_map *, map,
 
 	new_bucket->hash = hash;
 	new_bucket->nr = trace_nr;
+	atomic64_set(&new_bucket->hits, 1);
 
 	old_bucket = xchg(&smap->buckets[id], new_bucket);
 	if (old_bucket)
 		pcpu_freelist_push(&smap->freelist, &old_bucket->fnode);
 	return id;
+
+hit:
+	/* Like the compare above, this can race with the bucket being
+	 * replaced under BPF_F_REUSE_STACKID, so counts are best-effort
+	 * in that mode.
+	 */
+	if (stack_map_use_hit_count(map))
+		atomic64_inc(&bucket->hits);
+	return id;
 }
 
 const struct bpf_func_proto bpf_get_stackid_proto = {
@@ -424,9 +459,15 @@ int bpf_stackmap_copy(struct bpf_map *map, void *key, void *value)
 	if (!bucket)
 		return -ENOENT;
 
+	if (stack_map_use_hit_count(map)) {
+		*(u64 *)value = atomic64_read(&bucket->hits);
+		value += sizeof(u64);
+	}
+
 	trace_len = bucket->nr * stack_map_data_size(map);
 	memcpy(value, bucket->data, trace_len);
-	memset(value + trace_len, 0, map->value_size - trace_len);
+	memset(value + trace_len, 0,
+	       map->value_size - stack_map_hdr_size(map) - trace_len);
 
 	old_bucket = xchg(&smap->buckets[id], bucket);
 	if (old_bucket)
@@ -502,7 +543,7 @@ static void stack_map_free(struct bpf_map *map)
 	put_callchain_buffers();
 }
 
-const struct bpf_map_ops stack_map_ops = {
+const struct bpf_map_ops stack_trace_map_ops = {
 	.map_alloc = stack_map_alloc,
 	.map_free = stack_map_free,
 	.map_get_next_key = stack_map_get_next_key,
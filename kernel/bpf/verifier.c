@@ -186,27 +186,17 @@ struct bpf_call_arg_meta {
 	bool pkt_access;
 	int regno;
 	int access_size;
+	u32 ref_obj_id;
 };
 
 static DEFINE_MUTEX(bpf_verifier_lock);
 
-/* log_level controls verbosity level of eBPF verifier.
- * bpf_verifier_log_write() is used to dump the verification trace to the log,
- * so the user can figure out what's wrong with the program
- */
-__printf(2, 3) void bpf_verifier_log_write(struct bpf_verifier_env *env,
-					   const char *fmt, ...)
+__printf(2, 0) void bpf_verifier_vlog(struct bpf_verifier_log *log,
+				      const char *fmt, va_list args)
 {
-	struct bpf_verifier_log *log = &env->log;
 	unsigned int n;
-	va_list args;
-
-	if (!log->level || !log->ubuf || bpf_verifier_log_full(log))
-		return;
 
-	va_start(args, fmt);
 	n = vscnprintf(log->kbuf, BPF_VERIFIER_TMP_LOG_SIZE, fmt, args);
-	va_end(args);
 
 	WARN_ONCE(n >= BPF_VERIFIER_TMP_LOG_SIZE - 1,
 		  "verifier log line truncated - local buffer too short\n");
@@ -219,6 +209,23 @@ __printf(2, 3) void bpf_verifier_log_write(struct bpf_verifier_env *env,
 	else
 		log->ubuf = NULL;
 }
+
+/* log_level controls verbosity level of eBPF verifier.
+ * bpf_verifier_log_write() is used to dump the verification trace to the log,
+ * so the user can figure out what's wrong with the program
+ */
+__printf(2, 3) void bpf_verifier_log_write(struct bpf_verifier_env *env,
+					   const char *fmt, ...)
+{
+	va_list args;
+
+	if (!bpf_verifier_log_needed(&env->log))
+		return;
+
+	va_start(args, fmt);
+	bpf_verifier_vlog(&env->log, fmt, args);
+	va_end(args);
+}
 EXPORT_SYMBOL_GPL(bpf_verifier_log_write);
 /* Historically bpf_verifier_log_write was called verbose, but the name was too
  * generic for symbol export. The function was renamed, but not the calls in
@@ -452,6 +459,8 @@ static int copy_verifier_state(struct bpf_verifier_state *dst_state,
 	}
 	dst_state->curframe = src->curframe;
 	dst_state->parent = src->parent;
+	dst_state->acquired_refs = src->acquired_refs;
+	memcpy(dst_state->refs, src->refs, sizeof(src->refs));
 	for (i = 0; i <= src->curframe; i++) {
 		dst = dst_state->frame[i];
 		if (!dst) {
@@ -539,6 +548,7 @@ static void __mark_reg_not_init(struct bpf_reg_state *reg);
 static void __mark_reg_known(struct bpf_reg_state *reg, u64 imm)
 {
 	reg->id = 0;
+	reg->ref_obj_id = 0;
 	reg->var_off = tnum_const(imm);
 	reg->smin_value = (s64)imm;
 	reg->smax_value = (s64)imm;
@@ -670,6 +680,7 @@ static void __mark_reg_unknown(struct bpf_reg_state *reg)
 {
 	reg->type = SCALAR_VALUE;
 	reg->id = 0;
+	reg->ref_obj_id = 0;
 	reg->off = 0;
 	reg->var_off = tnum_unknown;
 	reg->frameno = 0;
@@ -1948,7 +1959,8 @@ static int check_func_arg(struct bpf_verifier_env *env, u32 regno,
 	}
 
 	if (arg_type == ARG_PTR_TO_MAP_KEY ||
-	    arg_type == ARG_PTR_TO_MAP_VALUE) {
+	    arg_type == ARG_PTR_TO_MAP_VALUE ||
+	    arg_type == ARG_PTR_TO_UNINIT_MAP_VALUE) {
 		expected_type = PTR_TO_STACK;
 		if (!type_is_pkt_pointer(type) && type != PTR_TO_MAP_VALUE &&
 		    type != expected_type)
@@ -1966,6 +1978,21 @@ static int check_func_arg(struct bpf_verifier_env *env, u32 regno,
 		expected_type = PTR_TO_CTX;
 		if (type != expected_type)
 			goto err_type;
+	} else if (arg_type == ARG_PTR_TO_RINGBUF_REC) {
+		expected_type = PTR_TO_MAP_VALUE;
+		if (type != expected_type)
+			goto err_type;
+		if (!reg->ref_obj_id) {
+			verbose(env, "R%d is not a reserved ringbuf record\n",
+				regno);
+			return -EACCES;
+		}
+		if (reg->off || !tnum_equals_const(reg->var_off, 0)) {
+			verbose(env, "R%d must point to the start of the ringbuf record\n",
+				regno);
+			return -EACCES;
+		}
+		meta->ref_obj_id = reg->ref_obj_id;
 	} else if (arg_type_is_mem_ptr(arg_type)) {
 		expected_type = PTR_TO_STACK;
 		/* One exception here. In case function allows for NULL to be
@@ -2005,7 +2032,8 @@ static int check_func_arg(struct bpf_verifier_env *env, u32 regno,
 		err = check_helper_mem_access(env, regno,
 					      meta->map_ptr->key_size, false,
 					      NULL);
-	} else if (arg_type == ARG_PTR_TO_MAP_VALUE) {
+	} else if (arg_type == ARG_PTR_TO_MAP_VALUE ||
+		   arg_type == ARG_PTR_TO_UNINIT_MAP_VALUE) {
 		/* bpf_map_xxx(..., map_ptr, ..., value) call:
 		 * check [value, value + map->value_size) validity
 		 */
@@ -2014,9 +2042,10 @@ static int check_func_arg(struct bpf_verifier_env *env, u32 regno,
 			verbose(env, "invalid map_ptr to access map->value\n");
 			return -EACCES;
 		}
+		meta->raw_mode = (arg_type == ARG_PTR_TO_UNINIT_MAP_VALUE);
 		err = check_helper_mem_access(env, regno,
 					      meta->map_ptr->value_size, false,
-					      NULL);
+					      meta);
 	} else if (arg_type_is_mem_size(arg_type)) {
 		bool zero_size_allowed = (arg_type == ARG_CONST_SIZE_OR_ZERO);
 
@@ -2098,6 +2127,20 @@ static int check_map_func_compatibility(struct bpf_verifier_env *env,
 	case BPF_MAP_TYPE_HASH_OF_MAPS:
 		if (func_id != BPF_FUNC_map_lookup_elem)
 			goto error;
+		break;
+	case BPF_MAP_TYPE_QUEUE:
+	case BPF_MAP_TYPE_STACK:
+		if (func_id != BPF_FUNC_map_push_elem &&
+		    func_id != BPF_FUNC_map_pop_elem &&
+		    func_id != BPF_FUNC_map_peek_elem)
+			goto error;
+		break;
+	case BPF_MAP_TYPE_RINGBUF:
+		if (func_id != BPF_FUNC_ringbuf_output &&
+		    func_id != BPF_FUNC_ringbuf_reserve &&
+		    func_id != BPF_FUNC_ringbuf_query)
+			goto error;
+		break;
 	default:
 		break;
 	}
@@ -2122,6 +2165,19 @@ static int check_map_func_compatibility(struct bpf_verifier_env *env,
 		if (map->map_type != BPF_MAP_TYPE_STACK_TRACE)
 			goto error;
 		break;
+	case BPF_FUNC_ringbuf_output:
+	case BPF_FUNC_ringbuf_reserve:
+	case BPF_FUNC_ringbuf_query:
+		if (map->map_type != BPF_MAP_TYPE_RINGBUF)
+			goto error;
+		break;
+	case BPF_FUNC_map_push_elem:
+	case BPF_FUNC_map_pop_elem:
+	case BPF_FUNC_map_peek_elem:
+		if (map->map_type != BPF_MAP_TYPE_QUEUE &&
+		    map->map_type != BPF_MAP_TYPE_STACK)
+			goto error;
+		break;
 	default:
 		break;
 	}
@@ -2219,6 +2275,83 @@ static void clear_all_pkt_pointers(struct bpf_verifier_env *env)
 		__clear_all_pkt_pointers(env, vstate->frame[i]);
 }
 
+/* Remember a ringbuf record reserved on the current path, it has to be
+ * submitted or discarded before the program exits.
+ */
+static int acquire_reference(struct bpf_verifier_env *env, u32 id)
+{
+	struct bpf_verifier_state *vstate = env->cur_state;
+
+	if (vstate->acquired_refs >= MAX_ACQUIRED_REFS) {
+		verbose(env, "too many ringbuf records reserved at once\n");
+		return -EINVAL;
+	}
+	vstate->refs[vstate->acquired_refs++] = id;
+	return 0;
+}
+
+static int release_reference_state(struct bpf_verifier_state *vstate, u32 id)
+{
+	int i;
+
+	for (i = 0; i < vstate->acquired_refs; i++) {
+		if (vstate->refs[i] != id)
+			continue;
+		vstate->refs[i] = vstate->refs[--vstate->acquired_refs];
+		return 0;
+	}
+	return -EINVAL;
+}
+
+static void __release_reference(struct bpf_func_state *state, u32 id)
+{
+	struct bpf_reg_state *reg;
+	int i;
+
+	for (i = 0; i < MAX_BPF_REG; i++)
+		if (state->regs[i].ref_obj_id == id)
+			__mark_reg_unknown(&state->regs[i]);
+
+	for (i = 0; i < state->allocated_stack / BPF_REG_SIZE; i++) {
+		if (state->stack[i].slot_type[0] != STACK_SPILL)
+			continue;
+		reg = &state->stack[i].spilled_ptr;
+		if (reg->ref_obj_id == id)
+			__mark_reg_unknown(reg);
+	}
+}
+
+/* The record is gone once submitted or discarded, so every pointer into it
+ * becomes an unknown scalar.
+ */
+static int release_reference(struct bpf_verifier_env *env, u32 id)
+{
+	struct bpf_verifier_state *vstate = env->cur_state;
+	int i, err;
+
+	err = release_reference_state(vstate, id);
+	if (err) {
+		verbose(env, "ringbuf record id=%u was already released\n", id);
+		return err;
+	}
+
+	for (i = 0; i <= vstate->curframe; i++)
+		__release_reference(vstate->frame[i], id);
+	return 0;
+}
+
+static int check_unreleased_references(struct bpf_verifier_env *env)
+{
+	struct bpf_verifier_state *vstate = env->cur_state;
+
+	if (vstate->acquired_refs) {
+		verbose(env, "ringbuf record id=%u is neither submitted nor discarded\n",
+			vstate->refs[0]);
+		return -EINVAL;
+	}
+	return 0;
+}
+
 static int check_func_call(struct bpf_verifier_env *env, struct bpf_insn *insn,
 			   int *insn_idx)
 {
@@ -2347,6 +2480,31 @@ record_func_map(struct bpf_verifier_env *env, struct bpf_call_arg_meta *meta,
 	return 0;
 }
 
+/* bpf_ringbuf_reserve() hands out records of the map's value_size, which
+ * is what the verifier bounds accesses to the returned pointer with.
+ */
+static int check_ringbuf_reserve_size(struct bpf_verifier_env *env,
+				      struct bpf_map *map)
+{
+	struct bpf_reg_state *reg = &cur_regs(env)[BPF_REG_2];
+
+	if (!map) {
+		verbose(env, "kernel subsystem misconfigured verifier\n");
+		return -EINVAL;
+	}
+	if (!map->value_size) {
+		verbose(env, "ringbuf map has no value_size, use bpf_ringbuf_output()\n");
+		return -EINVAL;
+	}
+	if (reg->type != SCALAR_VALUE || !tnum_is_const(reg->var_off) ||
+	    reg->var_off.value != map->value_size) {
+		verbose(env, "R2 must be the ringbuf value_size %u\n",
+			map->value_size);
+		return -EINVAL;
+	}
+	return 0;
+}
+
 static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn_idx)
 {
 	const struct bpf_func_proto *fn = NULL;
@@ -2409,6 +2567,23 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 	if (err)
 		return err;
 
+	if (func_id == BPF_FUNC_tail_call && env->cur_state->acquired_refs) {
+		verbose(env, "tail_call would leak reserved ringbuf records\n");
+		return -EINVAL;
+	}
+
+	if (fn->ret_type == RET_PTR_TO_RINGBUF_REC_OR_NULL) {
+		err = check_ringbuf_reserve_size(env, meta.map_ptr);
+		if (err)
+			return err;
+	}
+
+	if (meta.ref_obj_id) {
+		err = release_reference(env, meta.ref_obj_id);
+		if (err)
+			return err;
+	}
+
 	/* Mark slots with STACK_MISC in case of raw mode, stack offset
 	 * is inferred from register state.
 	 */
@@ -2432,7 +2607,8 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 		mark_reg_unknown(env, regs, BPF_REG_0);
 	} else if (fn->ret_type == RET_VOID) {
 		regs[BPF_REG_0].type = NOT_INIT;
-	} else if (fn->ret_type == RET_PTR_TO_MAP_VALUE_OR_NULL) {
+	} else if (fn->ret_type == RET_PTR_TO_MAP_VALUE_OR_NULL ||
+		   fn->ret_type == RET_PTR_TO_RINGBUF_REC_OR_NULL) {
 		regs[BPF_REG_0].type = PTR_TO_MAP_VALUE_OR_NULL;
 		/* There is no offset yet applied, variable or fixed */
 		mark_reg_known_zero(env, regs, BPF_REG_0);
@@ -2448,6 +2624,15 @@ static int check_helper_call(struct bpf_verifier_env *env, int func_id, int insn
 		}
 		regs[BPF_REG_0].map_ptr = meta.map_ptr;
 		regs[BPF_REG_0].id = ++env->id_gen;
+		if (fn->ret_type == RET_PTR_TO_RINGBUF_REC_OR_NULL) {
+			/* the record is sized by the map's value_size, so
+			 * it is accessed like a map value until released
+			 */
+			regs[BPF_REG_0].ref_obj_id = regs[BPF_REG_0].id;
+			err = acquire_reference(env, regs[BPF_REG_0].id);
+			if (err)
+				return err;
+		}
 	} else {
 		verbose(env, "unknown return type %d of func %s#%d\n",
 			fn->ret_type, func_id_name(func_id), func_id);
@@ -2574,11 +2759,13 @@ static int adjust_ptr_min_max_vals(struct bpf_verifier_env *env,
 		return -EACCES;
 	}
 
-	/* In case of 'scalar += pointer', dst_reg inherits pointer type and id.
-	 * The id may be overwritten later if we create a new variable offset.
+	/* In case of 'scalar += pointer', dst_reg inherits pointer type, id
+	 * and the reference it was derived from.  The id may be overwritten
+	 * later if we create a new variable offset.
 	 */
 	dst_reg->type = ptr_reg->type;
 	dst_reg->id = ptr_reg->id;
+	dst_reg->ref_obj_id = ptr_reg->ref_obj_id;
 
 	if (!check_reg_sane_offset(env, off_reg, ptr_reg->type) ||
 	    !check_reg_sane_offset(env, ptr_reg, ptr_reg->type))
@@ -2659,6 +2846,7 @@ static int adjust_ptr_min_max_vals(struct bpf_verifier_env *env,
 			dst_reg->umax_value = umax_ptr;
 			dst_reg->var_off = ptr_reg->var_off;
 			dst_reg->id = ptr_reg->id;
+			dst_reg->ref_obj_id = ptr_reg->ref_obj_id;
 			dst_reg->off = ptr_reg->off - smin_val;
 			dst_reg->range = ptr_reg->range;
 			break;
@@ -3500,6 +3688,7 @@ static void mark_map_reg(struct bpf_reg_state *regs, u32 regno, u32 id,
 		}
 		if (is_null) {
 			reg->type = SCALAR_VALUE;
+			reg->ref_obj_id = 0;
 		} else if (reg->map_ptr->inner_map_meta) {
 			reg->type = CONST_PTR_TO_MAP;
 			reg->map_ptr = reg->map_ptr->inner_map_meta;
@@ -3517,14 +3706,24 @@ static void mark_map_reg(struct bpf_reg_state *regs, u32 regno, u32 id,
 /* The logic is similar to find_good_pkt_pointers(), both could eventually
  * be folded together at some point.
  */
-static void mark_map_regs(struct bpf_verifier_state *vstate, u32 regno,
-			  bool is_null)
+static int mark_map_regs(struct bpf_verifier_env *env,
+			 struct bpf_verifier_state *vstate, u32 regno,
+			 bool is_null)
 {
 	struct bpf_func_state *state = vstate->frame[vstate->curframe];
 	struct bpf_reg_state *regs = state->regs;
+	u32 ref_obj_id = regs[regno].ref_obj_id;
 	u32 id = regs[regno].id;
 	int i, j;
 
+	/* a failed bpf_ringbuf_reserve() has nothing to release */
+	if (is_null && ref_obj_id &&
+	    release_reference_state(vstate, ref_obj_id)) {
+		verbose(env, "R%d ringbuf record id=%u was already released\n",
+			regno, ref_obj_id);
+		return -EINVAL;
+	}
+
 	for (i = 0; i < MAX_BPF_REG; i++)
 		mark_map_reg(regs, i, id, is_null);
 
@@ -3536,6 +3735,7 @@ static void mark_map_regs(struct bpf_verifier_state *vstate, u32 regno,
 			mark_map_reg(&state->stack[i].spilled_ptr, 0, id, is_null);
 		}
 	}
+	return 0;
 }
 
 static bool try_match_pkt_pointers(const struct bpf_insn *insn,
@@ -3739,8 +3939,13 @@ static int check_cond_jmp_op(struct bpf_verifier_env *env,
 		/* Mark all identical map registers in each branch as either
 		 * safe or unknown depending R == 0 or R != 0 conditional.
 		 */
-		mark_map_regs(this_branch, insn->dst_reg, opcode == BPF_JNE);
-		mark_map_regs(other_branch, insn->dst_reg, opcode == BPF_JEQ);
+		err = mark_map_regs(env, this_branch, insn->dst_reg,
+				    opcode == BPF_JNE);
+		if (!err)
+			err = mark_map_regs(env, other_branch, insn->dst_reg,
+					    opcode == BPF_JEQ);
+		if (err)
+			return err;
 	} else if (!try_match_pkt_pointers(insn, dst_reg, &regs[insn->src_reg],
 					   this_branch, other_branch) &&
 		   is_pointer_value(env, insn->dst_reg)) {
@@ -4405,6 +4610,12 @@ static bool states_equal(struct bpf_verifier_env *env,
 	if (old->curframe != cur->curframe)
 		return false;
 
+	/* ringbuf reservations are not matched up between states, so never
+	 * prune while one is outstanding
+	 */
+	if (old->acquired_refs || cur->acquired_refs)
+		return false;
+
 	/* for states to be equal callsites have to be the same
 	 * and all frame states need to be equivalent
 	 */
@@ -4816,6 +5027,10 @@ static int do_check(struct bpf_verifier_env *env)
 				if (err)
 					return err;
 
+				err = check_unreleased_references(env);
+				if (err)
+					return err;
+
 				if (is_pointer_value(env, BPF_REG_0)) {
 					verbose(env, "R0 leaks addr as return value\n");
 					return -EACCES;
@@ -400,6 +400,12 @@ int sysctl_perf_event_mlock __read_mostly = 512 + (PAGE_SIZE / 1024); /* 'free'
 
 int sysctl_perf_event_sample_rate __read_mostly	= DEFAULT_MAX_SAMPLE_RATE;
 
+/*
+ * Ring buffer wakeups are batched for up to this many ms, 0 wakes up
+ * readers as soon as a wakeup is due.
+ */
+int sysctl_perf_event_wakeup_delay_ms __read_mostly;
+
 static int max_samples_per_tick __read_mostly	= DIV_ROUND_UP(DEFAULT_MAX_SAMPLE_RATE, HZ);
 static int perf_sample_period_ns __read_mostly	= DEFAULT_SAMPLE_PERIOD_NS;
 
@@ -4281,6 +4287,7 @@ static void perf_addr_filters_splice(struct perf_event *event,
 static void _free_event(struct perf_event *event)
 {
 	irq_work_sync(&event->pending);
+	hrtimer_cancel(&event->wakeup_timer);
 
 	unaccount_event(event);
 
@@ -5618,6 +5625,43 @@ void perf_event_wakeup(struct perf_event *event)
 	}
 }
 
+static enum hrtimer_restart perf_wakeup_timer_fn(struct hrtimer *hrtimer)
+{
+	struct perf_event *event = container_of(hrtimer,
+			struct perf_event, wakeup_timer);
+
+	/*
+	 * Clear the flag before waking, so that a wakeup due from here on
+	 * arms the timer again rather than being folded into this one.
+	 */
+	atomic_xchg(&event->wakeup_pending, 0);
+	perf_event_wakeup(event);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * With perf_event_wakeup_delay_ms set, the first wakeup arms a timer and
+ * all wakeups due before it fires are folded into one, so a reader of a
+ * busy buffer is woken at most once per delay instead of once per
+ * watermark crossing.  wakeup_pending, rather than hrtimer_active(), says
+ * whether a wakeup is still to come: the timer is also active while its
+ * callback runs, after the wakeup has been done.
+ */
+static void perf_event_wakeup_coalesced(struct perf_event *event)
+{
+	int delay = READ_ONCE(sysctl_perf_event_wakeup_delay_ms);
+
+	if (!delay) {
+		perf_event_wakeup(event);
+		return;
+	}
+
+	if (!atomic_xchg(&event->wakeup_pending, 1))
+		hrtimer_start(&event->wakeup_timer, ms_to_ktime(delay),
+			      HRTIMER_MODE_REL);
+}
+
 static void perf_pending_event(struct irq_work *entry)
 {
 	struct perf_event *event = container_of(entry,
@@ -5637,7 +5681,7 @@ static void perf_pending_event(struct irq_work *entry)
 
 	if (event->pending_wakeup) {
 		event->pending_wakeup = 0;
-		perf_event_wakeup(event);
+		perf_event_wakeup_coalesced(event);
 	}
 
 	if (rctx >= 0)
@@ -9553,6 +9597,8 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 
 	init_waitqueue_head(&event->waitq);
 	init_irq_work(&event->pending, perf_pending_event);
+	hrtimer_init(&event->wakeup_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	event->wakeup_timer.function = perf_wakeup_timer_fn;
 
 	mutex_init(&event->mmap_mutex);
 	raw_spin_lock_init(&event->addr_filters.lock);
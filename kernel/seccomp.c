@@ -47,6 +47,7 @@
  *         is only needed for handling filters shared across tasks.
  * @prev: points to a previously installed, or inherited, filter
  * @len: the number of instructions in the program
+ * @prog: the program migrated to eBPF, or NULL to run @insns directly
  * @insns: the BPF program instructions to evaluate
  *
  * seccomp_filter objects are organized in a tree linked via the @prev
@@ -63,6 +64,7 @@ struct seccomp_filter {
 	refcount_t usage;
 	struct seccomp_filter *prev;
 	unsigned short len;  /* Instruction count */
+	struct bpf_prog *prog;
 	struct sock_filter insns[];
 };
 
@@ -119,6 +121,28 @@ u32 seccomp_bpf_load(int off)
 	BUG();
 }
 
+/**
+ * populate_seccomp_data - fill in struct seccomp_data for the current syscall
+ * @sd: seccomp_data to fill in
+ *
+ * Migrated filters read struct seccomp_data directly as their context
+ * instead of calling seccomp_bpf_load() for every load.
+ */
+static void populate_seccomp_data(struct seccomp_data *sd)
+{
+	struct task_struct *task = current;
+	struct pt_regs *regs = task_pt_regs(task);
+	unsigned long args[6];
+	int i;
+
+	sd->nr = syscall_get_nr(task, regs);
+	sd->arch = syscall_get_arch();
+	syscall_get_arguments(task, regs, 0, 6, args);
+	for (i = 0; i < 6; i++)
+		sd->args[i] = args[i];
+	sd->instruction_pointer = KSTK_EIP(task);
+}
+
 /**
  *	seccomp_check_filter - verify seccomp filter code
  *	@filter: filter to verify
@@ -211,6 +235,7 @@ static u32 seccomp_run_filters(void)
 {
 	struct seccomp_filter *f = ACCESS_ONCE(current->seccomp.filter);
 	u32 ret = SECCOMP_RET_ALLOW;
+	struct seccomp_data sd;
 
 	/* Ensure unexpected behavior doesn't result in failing open. */
 	if (unlikely(WARN_ON(f == NULL)))
@@ -218,12 +243,19 @@ static u32 seccomp_run_filters(void)
 
 	smp_read_barrier_depends();
 
+	populate_seccomp_data(&sd);
+
 	/*
 	 * All filters in the list are evaluated and the lowest BPF return
 	 * value always takes priority (ignoring the DATA).
 	 */
 	for (; f; f = f->prev) {
-		u32 cur_ret = sk_run_filter(NULL, f->insns);
+		u32 cur_ret;
+
+		if (f->prog)
+			cur_ret = BPF_PROG_RUN(f->prog, (void *)&sd);
+		else
+			cur_ret = sk_run_filter(NULL, f->insns);
 
 		if ((cur_ret & SECCOMP_RET_ACTION) < (ret & SECCOMP_RET_ACTION))
 			ret = cur_ret;
@@ -423,6 +455,11 @@ static struct seccomp_filter *seccomp_prepare_filter(struct sock_fprog *fprog)
 	if (ret)
 		goto fail;
 
+	/* Run it on eBPF if possible, else keep the classic interpreter. */
+	filter->prog = bpf_migrate_filter(filter->insns, filter->len);
+	if (IS_ERR(filter->prog))
+		filter->prog = NULL;
+
 	return filter;
 fail:
 	kfree(filter);
@@ -517,6 +554,8 @@ void get_seccomp_filter(struct task_struct *tsk)
 static inline void seccomp_filter_free(struct seccomp_filter *filter)
 {
 	if (filter) {
+		if (filter->prog)
+			bpf_prog_free(filter->prog);
 		kfree(filter);
 	}
 }
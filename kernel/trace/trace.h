@@ -1034,10 +1034,24 @@ filter_check_discard(struct ftrace_event_call *call, void *rec,
 }
 
 extern void trace_event_enable_cmd_record(bool enable);
+extern int trace_event_enable_disable(struct ftrace_event_file *file,
+				      int enable, int soft_disable);
 extern int event_trace_add_tracer(struct dentry *parent, struct trace_array *tr);
 extern int event_trace_del_tracer(struct trace_array *tr);
 
 extern struct mutex event_mutex;
+
+static inline void *event_file_data(struct file *filp)
+{
+	return ACCESS_ONCE(file_inode(filp)->i_private);
+}
+
+#ifdef CONFIG_HIST_TRIGGERS
+extern const struct file_operations event_hist_fops;
+extern void event_hist_remove(struct ftrace_event_file *file);
+#else
+static inline void event_hist_remove(struct ftrace_event_file *file) { }
+#endif
 extern struct list_head ftrace_events;
 
 extern const char *__start___trace_bprintk_fmt[];
@@ -376,6 +376,12 @@ static int __ftrace_event_enable_disable(struct ftrace_event_file *file,
 	return ret;
 }
 
+int trace_event_enable_disable(struct ftrace_event_file *file,
+			       int enable, int soft_disable)
+{
+	return __ftrace_event_enable_disable(file, enable, soft_disable);
+}
+
 static int ftrace_event_enable_disable(struct ftrace_event_file *file,
 				       int enable)
 {
@@ -455,11 +461,6 @@ static void remove_subsystem(struct ftrace_subsystem_dir *dir)
 	}
 }
 
-static void *event_file_data(struct file *filp)
-{
-	return ACCESS_ONCE(file_inode(filp)->i_private);
-}
-
 static void remove_event_file_dir(struct ftrace_event_file *file)
 {
 	struct dentry *dir = file->dir;
@@ -476,6 +477,7 @@ static void remove_event_file_dir(struct ftrace_event_file *file)
 		debugfs_remove_recursive(dir);
 	}
 
+	event_hist_remove(file);
 	list_del(&file->list);
 	remove_subsystem(file->system);
 	kmem_cache_free(file_cachep, file);
@@ -1608,6 +1610,14 @@ event_create_dir(struct dentry *parent,
 	trace_create_file("format", 0444, file->dir, call,
 			  format);
 
+#ifdef CONFIG_HIST_TRIGGERS
+	/* only TRACE_EVENT() probes feed the histogram */
+	if ((call->flags & TRACE_EVENT_FL_TRACEPOINT) && call->class->reg &&
+	    !(call->flags & TRACE_EVENT_FL_IGNORE_ENABLE))
+		trace_create_file("hist", 0644, file->dir, file,
+				  &event_hist_fops);
+#endif
+
 	return 0;
 }
 
@@ -1852,6 +1862,7 @@ trace_create_new_event(struct ftrace_event_call *call,
 	file->event_call = call;
 	file->tr = tr;
 	atomic_set(&file->sm_ref, 0);
+	RCU_INIT_POINTER(file->hist_data, NULL);
 	list_add(&file->list, &tr->events);
 
 	return file;
@@ -0,0 +1,835 @@
+/*
+ * trace_events_hist - in-kernel histograms of trace event fields
+ *
+ * Every event directory gets a "hist" file.  Writing a specification to
+ * it attaches a histogram to the event: each time the event fires, the
+ * key fields of the record are looked up in a lock-free tracing_map and
+ * the value fields are added to the sums of that key.  Nothing is
+ * written to the ring buffer unless the event is enabled as well.
+ *
+ *   keys=<field>[.mod][,<field>[.mod]...][:vals=<field>[,<field>...]]
+ *	[:sort=<field>[.ascending|.descending][,<field>...]][:size=<n>]
+ *	[:pause]
+ *
+ * Key modifiers are .hex, .sym and .log2.  A hitcount is always kept
+ * and is the default sort key.  The event filter, if any, applies to
+ * the histogram too.  On an attached histogram, "pause", "cont" and
+ * "clear" stop, resume and reset the aggregation, and "!" removes it.
+ * Reading the file prints the aggregated entries, sorted.
+ */
+
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
+
+#include "tracing_map.h"
+#include "trace.h"
+
+#define HIST_KEY_STR_MAX	64
+#define HIST_KEY_SIZE_MAX	(TRACING_MAP_KEYS_MAX * HIST_KEY_STR_MAX)
+
+struct hist_field;
+
+typedef u64 (*hist_field_fn_t) (struct hist_field *field, void *event);
+
+enum hist_field_flags {
+	HIST_FIELD_FL_HITCOUNT		= 1,
+	HIST_FIELD_FL_KEY		= 2,
+	HIST_FIELD_FL_STRING		= 4,
+	HIST_FIELD_FL_HEX		= 8,
+	HIST_FIELD_FL_SYM		= 16,
+	HIST_FIELD_FL_LOG2		= 32,
+};
+
+struct hist_field {
+	struct ftrace_event_field	*field;
+	unsigned long			flags;
+	hist_field_fn_t			fn;
+	unsigned int			size;
+	unsigned int			offset;
+	const char			*name;
+};
+
+struct hist_trigger_data {
+	struct hist_field		*fields[TRACING_MAP_FIELDS_MAX];
+	unsigned int			n_vals;
+	unsigned int			n_keys;
+	unsigned int			n_fields;
+	unsigned int			key_size;
+	struct tracing_map_sort_key	sort_keys[TRACING_MAP_SORT_KEYS_MAX];
+	unsigned int			n_sort_keys;
+	unsigned int			map_bits;
+	bool				paused;
+	struct tracing_map		*map;
+};
+
+static u64 hist_field_counter(struct hist_field *field, void *event)
+{
+	return 1;
+}
+
+static u64 hist_field_string(struct hist_field *field, void *event)
+{
+	return (u64)(unsigned long)(event + field->field->offset);
+}
+
+static u64 hist_field_dynstring(struct hist_field *field, void *event)
+{
+	u32 str_item = *(u32 *)(event + field->field->offset);
+
+	return (u64)(unsigned long)(event + (str_item & 0xffff));
+}
+
+static u64 hist_field_comm(struct hist_field *field, void *event)
+{
+	return (u64)(unsigned long)current->comm;
+}
+
+static u64 hist_field_cpu(struct hist_field *field, void *event)
+{
+	return (u64)raw_smp_processor_id();
+}
+
+#define DEFINE_HIST_FIELD_FN(type)					\
+static u64 hist_field_##type(struct hist_field *hist_field, void *event)\
+{									\
+	type *addr = (type *)(event + hist_field->field->offset);	\
+									\
+	return (u64)(s64)*addr;						\
+}
+
+DEFINE_HIST_FIELD_FN(s64);
+DEFINE_HIST_FIELD_FN(s32);
+DEFINE_HIST_FIELD_FN(s16);
+DEFINE_HIST_FIELD_FN(s8);
+
+#undef DEFINE_HIST_FIELD_FN
+#define DEFINE_HIST_FIELD_FN(type)					\
+static u64 hist_field_##type(struct hist_field *hist_field, void *event)\
+{									\
+	type *addr = (type *)(event + hist_field->field->offset);	\
+									\
+	return (u64)*addr;						\
+}
+
+DEFINE_HIST_FIELD_FN(u64);
+DEFINE_HIST_FIELD_FN(u32);
+DEFINE_HIST_FIELD_FN(u16);
+DEFINE_HIST_FIELD_FN(u8);
+
+static hist_field_fn_t select_value_fn(int field_size, int field_is_signed)
+{
+	hist_field_fn_t fn = NULL;
+
+	switch (field_size) {
+	case 8:
+		fn = field_is_signed ? hist_field_s64 : hist_field_u64;
+		break;
+	case 4:
+		fn = field_is_signed ? hist_field_s32 : hist_field_u32;
+		break;
+	case 2:
+		fn = field_is_signed ? hist_field_s16 : hist_field_u16;
+		break;
+	case 1:
+		fn = field_is_signed ? hist_field_s8 : hist_field_u8;
+		break;
+	}
+
+	return fn;
+}
+
+static bool is_string_field(struct ftrace_event_field *field)
+{
+	return field->filter_type == FILTER_STATIC_STRING ||
+	       field->filter_type == FILTER_DYN_STRING ||
+	       field->filter_type == FILTER_COMM;
+}
+
+static void destroy_hist_field(struct hist_field *hist_field)
+{
+	kfree(hist_field);
+}
+
+static struct hist_field *create_hist_field(struct ftrace_event_field *field,
+					    unsigned long flags)
+{
+	struct hist_field *hist_field;
+
+	hist_field = kzalloc(sizeof(*hist_field), GFP_KERNEL);
+	if (!hist_field)
+		return NULL;
+
+	hist_field->field = field;
+	hist_field->flags = flags;
+
+	if (flags & HIST_FIELD_FL_HITCOUNT) {
+		hist_field->fn = hist_field_counter;
+		hist_field->name = "hitcount";
+		return hist_field;
+	}
+
+	hist_field->name = field->name;
+
+	if (is_string_field(field)) {
+		hist_field->flags |= HIST_FIELD_FL_STRING;
+		hist_field->size = HIST_KEY_STR_MAX;
+		if (field->filter_type == FILTER_STATIC_STRING)
+			hist_field->fn = hist_field_string;
+		else if (field->filter_type == FILTER_DYN_STRING)
+			hist_field->fn = hist_field_dynstring;
+		else
+			hist_field->fn = hist_field_comm;
+	} else if (field->filter_type == FILTER_CPU) {
+		hist_field->size = sizeof(u64);
+		hist_field->fn = hist_field_cpu;
+	} else if (field->filter_type == FILTER_OTHER) {
+		hist_field->size = sizeof(u64);
+		hist_field->fn = select_value_fn(field->size, field->is_signed);
+	}
+
+	if (!hist_field->fn) {
+		destroy_hist_field(hist_field);
+		return NULL;
+	}
+
+	return hist_field;
+}
+
+static void destroy_hist_data(struct hist_trigger_data *hist_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < TRACING_MAP_FIELDS_MAX; i++)
+		destroy_hist_field(hist_data->fields[i]);
+
+	tracing_map_destroy(hist_data->map);
+	kfree(hist_data);
+}
+
+static int create_val_field(struct hist_trigger_data *hist_data,
+			    struct ftrace_event_call *call, char *field_name)
+{
+	struct ftrace_event_field *field;
+	unsigned int i = hist_data->n_vals;
+
+	if (i >= TRACING_MAP_VALS_MAX)
+		return -EINVAL;
+
+	field = trace_find_event_field(call, field_name);
+	if (!field || is_string_field(field) ||
+	    field->filter_type != FILTER_OTHER)
+		return -EINVAL;
+
+	hist_data->fields[i] = create_hist_field(field, 0);
+	if (!hist_data->fields[i])
+		return -EINVAL;
+
+	hist_data->n_vals++;
+
+	return 0;
+}
+
+static int create_val_fields(struct hist_trigger_data *hist_data,
+			     struct ftrace_event_call *call, char *vals_str)
+{
+	char *field_name;
+	int ret;
+
+	/* hitcount is always val 0 */
+	hist_data->fields[0] = create_hist_field(NULL, HIST_FIELD_FL_HITCOUNT);
+	if (!hist_data->fields[0])
+		return -ENOMEM;
+	hist_data->n_vals = 1;
+
+	while (vals_str && (field_name = strsep(&vals_str, ",")) != NULL) {
+		if (!*field_name || strcmp(field_name, "hitcount") == 0)
+			continue;
+		ret = create_val_field(hist_data, call, field_name);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int create_key_field(struct hist_trigger_data *hist_data,
+			    struct ftrace_event_call *call, char *field_str)
+{
+	struct ftrace_event_field *field;
+	unsigned long flags = HIST_FIELD_FL_KEY;
+	unsigned int idx = hist_data->n_vals + hist_data->n_keys;
+	char *field_name, *modifier;
+
+	if (hist_data->n_keys >= TRACING_MAP_KEYS_MAX)
+		return -EINVAL;
+
+	field_name = strsep(&field_str, ".");
+	modifier = field_str;
+	if (modifier) {
+		if (strcmp(modifier, "hex") == 0)
+			flags |= HIST_FIELD_FL_HEX;
+		else if (strcmp(modifier, "sym") == 0)
+			flags |= HIST_FIELD_FL_SYM;
+		else if (strcmp(modifier, "log2") == 0)
+			flags |= HIST_FIELD_FL_LOG2;
+		else
+			return -EINVAL;
+	}
+
+	field = trace_find_event_field(call, field_name);
+	if (!field)
+		return -EINVAL;
+
+	/* modifiers only make sense on numbers */
+	if (modifier && is_string_field(field))
+		return -EINVAL;
+
+	hist_data->fields[idx] = create_hist_field(field, flags);
+	if (!hist_data->fields[idx])
+		return -EINVAL;
+
+	hist_data->fields[idx]->offset = hist_data->key_size;
+	hist_data->key_size += hist_data->fields[idx]->size;
+	hist_data->n_keys++;
+
+	return 0;
+}
+
+static int create_key_fields(struct hist_trigger_data *hist_data,
+			     struct ftrace_event_call *call, char *keys_str)
+{
+	char *field_str;
+	int ret;
+
+	while ((field_str = strsep(&keys_str, ",")) != NULL) {
+		if (!*field_str)
+			continue;
+		ret = create_key_field(hist_data, call, field_str);
+		if (ret)
+			return ret;
+	}
+
+	return hist_data->n_keys ? 0 : -EINVAL;
+}
+
+static int create_sort_keys(struct hist_trigger_data *hist_data,
+			    char *sort_str)
+{
+	struct tracing_map_sort_key *sort_key;
+	char *field_str, *field_name, *modifier;
+	unsigned int i, j;
+
+	/* default: sort on hitcount, ascending */
+	hist_data->n_sort_keys = 1;
+	hist_data->sort_keys[0].field_idx = 0;
+	hist_data->sort_keys[0].descending = false;
+
+	if (!sort_str)
+		return 0;
+
+	for (i = 0; i < TRACING_MAP_SORT_KEYS_MAX; i++) {
+		field_str = strsep(&sort_str, ",");
+		if (!field_str)
+			break;
+
+		field_name = strsep(&field_str, ".");
+		modifier = field_str;
+		sort_key = &hist_data->sort_keys[i];
+
+		for (j = 0; j < hist_data->n_fields; j++) {
+			if (strcmp(field_name, hist_data->fields[j]->name) == 0)
+				break;
+		}
+		if (j == hist_data->n_fields)
+			return -EINVAL;
+
+		sort_key->field_idx = j;
+		if (!modifier || strcmp(modifier, "ascending") == 0)
+			sort_key->descending = false;
+		else if (strcmp(modifier, "descending") == 0)
+			sort_key->descending = true;
+		else
+			return -EINVAL;
+	}
+
+	if (sort_str)
+		return -EINVAL;
+
+	hist_data->n_sort_keys = i;
+
+	return 0;
+}
+
+static int create_tracing_map_fields(struct hist_trigger_data *hist_data)
+{
+	struct tracing_map *map = hist_data->map;
+	struct hist_field *hist_field;
+	tracing_map_cmp_fn_t cmp_fn;
+	unsigned int i;
+	int idx;
+
+	for (i = 0; i < hist_data->n_fields; i++) {
+		hist_field = hist_data->fields[i];
+
+		if (hist_field->flags & HIST_FIELD_FL_KEY) {
+			if (hist_field->flags & HIST_FIELD_FL_STRING)
+				cmp_fn = tracing_map_cmp_string;
+			else if (hist_field->flags & HIST_FIELD_FL_LOG2)
+				cmp_fn = tracing_map_cmp_num(8, 0);
+			else
+				cmp_fn = tracing_map_cmp_num(8,
+						hist_field->field->is_signed);
+			idx = tracing_map_add_key_field(map, hist_field->offset,
+							cmp_fn);
+		} else {
+			idx = tracing_map_add_sum_field(map);
+		}
+
+		/* field indexes must line up with hist_data->fields[] */
+		if (idx != i)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static struct hist_trigger_data *
+create_hist_data(struct ftrace_event_call *call, char *spec)
+{
+	char *keys_str = NULL, *vals_str = NULL, *sort_str = NULL;
+	struct hist_trigger_data *hist_data;
+	char *str, *name;
+	int ret = -EINVAL;
+
+	hist_data = kzalloc(sizeof(*hist_data), GFP_KERNEL);
+	if (!hist_data)
+		return ERR_PTR(-ENOMEM);
+
+	hist_data->map_bits = TRACING_MAP_BITS_DEFAULT;
+
+	while ((str = strsep(&spec, ":")) != NULL) {
+		name = strsep(&str, "=");
+		if (strcmp(name, "pause") == 0 && !str) {
+			hist_data->paused = true;
+		} else if (!str) {
+			goto free;
+		} else if (strcmp(name, "keys") == 0 ||
+			   strcmp(name, "key") == 0) {
+			keys_str = str;
+		} else if (strcmp(name, "vals") == 0 ||
+			   strcmp(name, "values") == 0) {
+			vals_str = str;
+		} else if (strcmp(name, "sort") == 0) {
+			sort_str = str;
+		} else if (strcmp(name, "size") == 0) {
+			unsigned long size;
+
+			if (kstrtoul(str, 0, &size) || !size)
+				goto free;
+			hist_data->map_bits = ilog2(roundup_pow_of_two(size));
+			if (hist_data->map_bits < TRACING_MAP_BITS_MIN ||
+			    hist_data->map_bits > TRACING_MAP_BITS_MAX)
+				goto free;
+		} else {
+			goto free;
+		}
+	}
+
+	if (!keys_str)
+		goto free;
+
+	ret = create_val_fields(hist_data, call, vals_str);
+	if (ret)
+		goto free;
+
+	ret = create_key_fields(hist_data, call, keys_str);
+	if (ret)
+		goto free;
+
+	hist_data->n_fields = hist_data->n_vals + hist_data->n_keys;
+
+	ret = create_sort_keys(hist_data, sort_str);
+	if (ret)
+		goto free;
+
+	hist_data->map = tracing_map_create(hist_data->map_bits,
+					    hist_data->key_size);
+	if (IS_ERR(hist_data->map)) {
+		ret = PTR_ERR(hist_data->map);
+		hist_data->map = NULL;
+		goto free;
+	}
+
+	ret = create_tracing_map_fields(hist_data);
+	if (ret)
+		goto free;
+
+	ret = tracing_map_init(hist_data->map);
+	if (ret)
+		goto free;
+
+	return hist_data;
+free:
+	destroy_hist_data(hist_data);
+	return ERR_PTR(ret);
+}
+
+static void hist_key_add_string(char *key, struct hist_field *hist_field,
+				void *rec)
+{
+	char *str = (char *)(unsigned long)hist_field->fn(hist_field, rec);
+	unsigned int size = HIST_KEY_STR_MAX - 1;
+
+	if (hist_field->field->filter_type == FILTER_STATIC_STRING)
+		size = min_t(unsigned int, size, hist_field->field->size);
+
+	strncpy(key + hist_field->offset, str, size);
+}
+
+/**
+ * event_hist_call - Aggregate one event record into its histogram
+ * @file: The event file the record was generated for
+ * @rec: The record, as laid out in the ring buffer
+ *
+ * Called from the event's tracepoint probe, with preemption disabled.
+ */
+void event_hist_call(struct ftrace_event_file *file, void *rec)
+{
+	struct ftrace_event_call *call = file->event_call;
+	struct hist_trigger_data *hist_data;
+	struct hist_field *key_field;
+	struct tracing_map_elt *elt;
+	char compound_key[HIST_KEY_SIZE_MAX];
+	unsigned int i;
+	u64 field_contents;
+
+	hist_data = rcu_dereference_sched(file->hist_data);
+	if (!hist_data || ACCESS_ONCE(hist_data->paused))
+		return;
+
+	if (unlikely(call->flags & TRACE_EVENT_FL_FILTERED) &&
+	    !filter_match_preds(call->filter, rec))
+		return;
+
+	memset(compound_key, 0, hist_data->key_size);
+
+	for (i = hist_data->n_vals; i < hist_data->n_fields; i++) {
+		key_field = hist_data->fields[i];
+
+		if (key_field->flags & HIST_FIELD_FL_STRING) {
+			hist_key_add_string(compound_key, key_field, rec);
+			continue;
+		}
+
+		field_contents = key_field->fn(key_field, rec);
+		if (key_field->flags & HIST_FIELD_FL_LOG2)
+			field_contents = field_contents ?
+				ilog2(roundup_pow_of_two(field_contents)) : 0;
+
+		memcpy(compound_key + key_field->offset, &field_contents,
+		       sizeof(field_contents));
+	}
+
+	elt = tracing_map_insert(hist_data->map, compound_key);
+	if (!elt)
+		return;
+
+	for (i = 0; i < hist_data->n_vals; i++) {
+		struct hist_field *hist_field = hist_data->fields[i];
+
+		tracing_map_update_sum(elt, i, hist_field->fn(hist_field, rec));
+	}
+}
+EXPORT_SYMBOL_GPL(event_hist_call);
+
+static void hist_print_spec(struct seq_file *m,
+			    struct hist_trigger_data *hist_data)
+{
+	struct hist_field *hist_field;
+	unsigned int i;
+
+	seq_puts(m, "keys=");
+	for (i = hist_data->n_vals; i < hist_data->n_fields; i++) {
+		hist_field = hist_data->fields[i];
+		if (i > hist_data->n_vals)
+			seq_puts(m, ",");
+		seq_puts(m, hist_field->name);
+		if (hist_field->flags & HIST_FIELD_FL_HEX)
+			seq_puts(m, ".hex");
+		else if (hist_field->flags & HIST_FIELD_FL_SYM)
+			seq_puts(m, ".sym");
+		else if (hist_field->flags & HIST_FIELD_FL_LOG2)
+			seq_puts(m, ".log2");
+	}
+
+	seq_puts(m, ":vals=");
+	for (i = 0; i < hist_data->n_vals; i++) {
+		if (i)
+			seq_puts(m, ",");
+		seq_puts(m, hist_data->fields[i]->name);
+	}
+
+	seq_puts(m, ":sort=");
+	for (i = 0; i < hist_data->n_sort_keys; i++) {
+		struct tracing_map_sort_key *sort_key = &hist_data->sort_keys[i];
+
+		if (i)
+			seq_puts(m, ",");
+		seq_puts(m, hist_data->fields[sort_key->field_idx]->name);
+		if (sort_key->descending)
+			seq_puts(m, ".descending");
+	}
+
+	seq_printf(m, ":size=%u", 1U << hist_data->map_bits);
+	seq_printf(m, " [%s]\n", hist_data->paused ? "paused" : "active");
+}
+
+static void hist_print_key(struct seq_file *m,
+			   struct hist_trigger_data *hist_data, void *key)
+{
+	char str[KSYM_SYMBOL_LEN];
+	struct hist_field *key_field;
+	unsigned int i;
+	u64 uval;
+
+	seq_puts(m, "{ ");
+
+	for (i = hist_data->n_vals; i < hist_data->n_fields; i++) {
+		key_field = hist_data->fields[i];
+
+		if (i > hist_data->n_vals)
+			seq_puts(m, ", ");
+
+		if (key_field->flags & HIST_FIELD_FL_STRING) {
+			seq_printf(m, "%s: %-50s", key_field->name,
+				   (char *)(key + key_field->offset));
+			continue;
+		}
+
+		uval = *(u64 *)(key + key_field->offset);
+		if (key_field->flags & HIST_FIELD_FL_HEX) {
+			seq_printf(m, "%s: %llx", key_field->name, uval);
+		} else if (key_field->flags & HIST_FIELD_FL_SYM) {
+			sprint_symbol_no_offset(str, (unsigned long)uval);
+			seq_printf(m, "%s: [%llx] %-45s", key_field->name,
+				   uval, str);
+		} else if (key_field->flags & HIST_FIELD_FL_LOG2) {
+			seq_printf(m, "%s: ~ 2^%-2llu", key_field->name, uval);
+		} else if (key_field->field->is_signed) {
+			seq_printf(m, "%s: %10lld", key_field->name, uval);
+		} else {
+			seq_printf(m, "%s: %10llu", key_field->name, uval);
+		}
+	}
+
+	seq_puts(m, " }");
+}
+
+static void hist_print_entry(struct seq_file *m,
+			     struct hist_trigger_data *hist_data,
+			     struct tracing_map_sort_entry *sort_entry)
+{
+	unsigned int i;
+
+	hist_print_key(m, hist_data, sort_entry->key);
+
+	for (i = 0; i < hist_data->n_vals; i++)
+		seq_printf(m, " %s: %10llu", hist_data->fields[i]->name,
+			   tracing_map_read_sum(sort_entry->elt, i));
+
+	seq_puts(m, "\n");
+}
+
+static int hist_show(struct seq_file *m, void *v)
+{
+	struct tracing_map_sort_entry **sort_entries = NULL;
+	struct hist_trigger_data *hist_data;
+	struct ftrace_event_file *file;
+	int i, n_entries, ret = 0;
+
+	mutex_lock(&event_mutex);
+
+	file = event_file_data(m->private);
+	if (unlikely(!file)) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	seq_puts(m, "# event histogram\n#\n");
+
+	hist_data = rcu_dereference_protected(file->hist_data,
+					lockdep_is_held(&event_mutex));
+	if (!hist_data) {
+		seq_puts(m, "# no histogram attached\n");
+		goto out_unlock;
+	}
+
+	seq_puts(m, "# hist spec: ");
+	hist_print_spec(m, hist_data);
+	seq_puts(m, "#\n\n");
+
+	n_entries = tracing_map_sort_entries(hist_data->map,
+					     hist_data->sort_keys,
+					     hist_data->n_sort_keys,
+					     &sort_entries);
+	if (n_entries < 0) {
+		ret = n_entries;
+		goto out_unlock;
+	}
+
+	for (i = 0; i < n_entries; i++)
+		hist_print_entry(m, hist_data, sort_entries[i]);
+
+	tracing_map_destroy_sort_entries(sort_entries, n_entries);
+
+	seq_printf(m, "\nTotals:\n    Hits: %llu\n    Entries: %u\n"
+		   "    Dropped: %llu\n",
+		   (u64)atomic64_read(&hist_data->map->hits), n_entries,
+		   (u64)atomic64_read(&hist_data->map->drops));
+out_unlock:
+	mutex_unlock(&event_mutex);
+
+	return ret;
+}
+
+static int event_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hist_show, file);
+}
+
+static int hist_register(struct ftrace_event_file *file, char *spec)
+{
+	struct hist_trigger_data *hist_data;
+	int ret;
+
+	if (rcu_access_pointer(file->hist_data))
+		return -EEXIST;
+
+	hist_data = create_hist_data(file->event_call, spec);
+	if (IS_ERR(hist_data))
+		return PTR_ERR(hist_data);
+
+	rcu_assign_pointer(file->hist_data, hist_data);
+	set_bit(FTRACE_EVENT_FL_HIST_BIT, &file->flags);
+
+	/* register the tracepoint without enabling the event itself */
+	ret = trace_event_enable_disable(file, 1, 1);
+	if (ret) {
+		clear_bit(FTRACE_EVENT_FL_HIST_BIT, &file->flags);
+		RCU_INIT_POINTER(file->hist_data, NULL);
+		synchronize_sched();
+		destroy_hist_data(hist_data);
+	}
+
+	return ret;
+}
+
+/**
+ * event_hist_remove - Detach and free the histogram of an event file
+ * @file: The event file
+ *
+ * Called with event_mutex held.
+ */
+void event_hist_remove(struct ftrace_event_file *file)
+{
+	struct hist_trigger_data *hist_data;
+
+	hist_data = rcu_dereference_protected(file->hist_data,
+					lockdep_is_held(&event_mutex));
+	if (!hist_data)
+		return;
+
+	trace_event_enable_disable(file, 0, 1);
+	clear_bit(FTRACE_EVENT_FL_HIST_BIT, &file->flags);
+	RCU_INIT_POINTER(file->hist_data, NULL);
+
+	/* tracepoint probes run with preemption disabled */
+	synchronize_sched();
+	destroy_hist_data(hist_data);
+}
+
+static int hist_command(struct ftrace_event_file *file, char *buf)
+{
+	struct hist_trigger_data *hist_data;
+
+	if (buf[0] == '!') {
+		event_hist_remove(file);
+		return 0;
+	}
+
+	hist_data = rcu_dereference_protected(file->hist_data,
+					lockdep_is_held(&event_mutex));
+
+	if (strcmp(buf, "pause") == 0 || strcmp(buf, "cont") == 0 ||
+	    strcmp(buf, "clear") == 0) {
+		if (!hist_data)
+			return -ENOENT;
+
+		if (buf[0] == 'c' && buf[1] == 'l') {
+			bool paused = hist_data->paused;
+
+			hist_data->paused = true;
+			synchronize_sched();
+			tracing_map_clear(hist_data->map);
+			hist_data->paused = paused;
+		} else {
+			hist_data->paused = (buf[0] == 'p');
+		}
+		return 0;
+	}
+
+	return hist_register(file, buf);
+}
+
+static ssize_t event_hist_write(struct file *filp, const char __user *ubuf,
+				size_t cnt, loff_t *ppos)
+{
+	struct ftrace_event_file *file;
+	char *buf, *cmd;
+	int ret = 0;
+
+	if (!cnt)
+		return 0;
+
+	if (cnt >= PAGE_SIZE)
+		return -EINVAL;
+
+	buf = (char *)__get_free_page(GFP_TEMPORARY);
+	if (!buf)
+		return -ENOMEM;
+
+	if (copy_from_user(buf, ubuf, cnt)) {
+		free_page((unsigned long)buf);
+		return -EFAULT;
+	}
+	buf[cnt] = '\0';
+	cmd = strstrip(buf);
+
+	mutex_lock(&event_mutex);
+	file = event_file_data(filp);
+	if (unlikely(!file))
+		ret = -ENODEV;
+	else if (*cmd)
+		ret = hist_command(file, cmd);
+	mutex_unlock(&event_mutex);
+
+	free_page((unsigned long)buf);
+	if (ret < 0)
+		return ret;
+
+	*ppos += cnt;
+
+	return cnt;
+}
+
+const struct file_operations event_hist_fops = {
+	.open		= event_hist_open,
+	.read		= seq_read,
+	.write		= event_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
@@ -0,0 +1,508 @@
+/*
+ * tracing_map - lock-free map for tracing
+ *
+ * Aggregates values keyed by event fields from tracepoint context, see
+ * tracing_map.h for the design.
+ */
+
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
+
+#include "tracing_map.h"
+#include "trace.h"
+
+#define TRACING_MAP_CMP_NUM(type)					\
+static int tracing_map_cmp_##type(void *val_a, void *val_b)		\
+{									\
+	type a = *(type *)val_a;					\
+	type b = *(type *)val_b;					\
+									\
+	return (a > b) ? 1 : ((a < b) ? -1 : 0);			\
+}
+
+TRACING_MAP_CMP_NUM(s64);
+TRACING_MAP_CMP_NUM(u64);
+TRACING_MAP_CMP_NUM(s32);
+TRACING_MAP_CMP_NUM(u32);
+TRACING_MAP_CMP_NUM(s16);
+TRACING_MAP_CMP_NUM(u16);
+TRACING_MAP_CMP_NUM(s8);
+TRACING_MAP_CMP_NUM(u8);
+
+int tracing_map_cmp_string(void *val_a, void *val_b)
+{
+	char *a = val_a;
+	char *b = val_b;
+
+	return strcmp(a, b);
+}
+
+int tracing_map_cmp_none(void *val_a, void *val_b)
+{
+	return 0;
+}
+
+tracing_map_cmp_fn_t tracing_map_cmp_num(int field_size,
+					 int field_is_signed)
+{
+	tracing_map_cmp_fn_t fn = tracing_map_cmp_none;
+
+	switch (field_size) {
+	case 8:
+		fn = field_is_signed ? tracing_map_cmp_s64 : tracing_map_cmp_u64;
+		break;
+	case 4:
+		fn = field_is_signed ? tracing_map_cmp_s32 : tracing_map_cmp_u32;
+		break;
+	case 2:
+		fn = field_is_signed ? tracing_map_cmp_s16 : tracing_map_cmp_u16;
+		break;
+	case 1:
+		fn = field_is_signed ? tracing_map_cmp_s8 : tracing_map_cmp_u8;
+		break;
+	}
+
+	return fn;
+}
+
+static int tracing_map_add_field(struct tracing_map *map,
+				 tracing_map_cmp_fn_t cmp_fn)
+{
+	int ret = -EINVAL;
+
+	if (map->n_fields < TRACING_MAP_FIELDS_MAX) {
+		ret = map->n_fields;
+		map->fields[map->n_fields++].cmp_fn = cmp_fn;
+	}
+
+	return ret;
+}
+
+/**
+ * tracing_map_add_sum_field - Add a field describing a tracing_map sum
+ * @map: The tracing_map
+ *
+ * Sums are 64-bit and updated atomically with tracing_map_update_sum().
+ * Must be called before tracing_map_init().
+ *
+ * Return: The index identifying the field in the map, or -EINVAL.
+ */
+int tracing_map_add_sum_field(struct tracing_map *map)
+{
+	int idx = tracing_map_add_field(map, tracing_map_cmp_num(8, 0));
+
+	if (idx < 0)
+		return idx;
+
+	map->fields[idx].sum_idx = map->n_sums++;
+
+	return idx;
+}
+
+/**
+ * tracing_map_add_key_field - Add a field describing a tracing_map key
+ * @map: The tracing_map
+ * @offset: The offset of this part of the key within the compound key
+ * @cmp_fn: The comparison function used when sorting on this field
+ *
+ * Key fields only matter for sorting; the map itself hashes and
+ * compares the whole key.  Must be called before tracing_map_init().
+ *
+ * Return: The index identifying the field in the map, or -EINVAL.
+ */
+int tracing_map_add_key_field(struct tracing_map *map, unsigned int offset,
+			      tracing_map_cmp_fn_t cmp_fn)
+{
+	int idx = tracing_map_add_field(map, cmp_fn);
+
+	if (idx < 0)
+		return idx;
+
+	map->fields[idx].offset = offset;
+	map->fields[idx].is_key = true;
+
+	return idx;
+}
+
+static void tracing_map_elt_free(struct tracing_map_elt *elt)
+{
+	if (!elt)
+		return;
+
+	kfree(elt->sums);
+	kfree(elt->key);
+	kfree(elt);
+}
+
+static struct tracing_map_elt *tracing_map_elt_alloc(struct tracing_map *map)
+{
+	struct tracing_map_elt *elt;
+
+	elt = kzalloc(sizeof(*elt), GFP_KERNEL);
+	if (!elt)
+		return NULL;
+
+	elt->map = map;
+
+	elt->key = kzalloc(map->key_size, GFP_KERNEL);
+	if (!elt->key)
+		goto free;
+
+	elt->sums = kcalloc(map->n_sums, sizeof(*elt->sums), GFP_KERNEL);
+	if (!elt->sums)
+		goto free;
+
+	return elt;
+free:
+	tracing_map_elt_free(elt);
+	return NULL;
+}
+
+static void tracing_map_free_elts(struct tracing_map *map)
+{
+	unsigned int i;
+
+	if (!map->elts)
+		return;
+
+	for (i = 0; i < map->max_elts; i++)
+		tracing_map_elt_free(map->elts[i]);
+
+	vfree(map->elts);
+	map->elts = NULL;
+}
+
+static int tracing_map_alloc_elts(struct tracing_map *map)
+{
+	unsigned int i;
+
+	map->elts = vzalloc(map->max_elts * sizeof(*map->elts));
+	if (!map->elts)
+		return -ENOMEM;
+
+	for (i = 0; i < map->max_elts; i++) {
+		map->elts[i] = tracing_map_elt_alloc(map);
+		if (!map->elts[i]) {
+			tracing_map_free_elts(map);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static struct tracing_map_elt *get_free_elt(struct tracing_map *map)
+{
+	int idx;
+
+	/*
+	 * Stop counting once the map is full, so that a long run of
+	 * dropped inserts can't wrap the counter and hand out live
+	 * elements again.
+	 */
+	idx = __atomic_add_unless(&map->next_elt, 1, map->max_elts);
+	if (idx < map->max_elts)
+		return map->elts[idx];
+
+	return NULL;
+}
+
+static inline bool keys_match(void *key, void *test_key, unsigned key_size)
+{
+	return memcmp(key, test_key, key_size) == 0;
+}
+
+/* How long to wait for a concurrent insert of the same key to publish
+ * its element before giving up and using another slot for it.
+ */
+#define TRACING_MAP_PUBLISH_SPINS	1000
+
+/**
+ * tracing_map_insert - Insert key and/or retrieve val from a tracing_map
+ * @map: The tracing_map to insert into
+ * @key: The key to insert, map->key_size bytes
+ *
+ * Looks up @key and returns its element, claiming a free slot and a
+ * preallocated element for it if it isn't in the map yet.  Safe to call
+ * from any context, including NMI, and concurrently on all cpus.
+ *
+ * A concurrent insert of the same new key may, very rarely, end up in
+ * two slots if the first one was not published in time; both elements
+ * are then reported when the map is read.
+ *
+ * Return: The element for @key, or NULL if the map is out of elements.
+ */
+struct tracing_map_elt *tracing_map_insert(struct tracing_map *map, void *key)
+{
+	struct tracing_map_entry *entry;
+	struct tracing_map_elt *elt;
+	u32 idx, key_hash, test_key;
+	unsigned int probes = 0;
+	int spins;
+
+	key_hash = jhash(key, map->key_size, 0);
+	if (key_hash == 0)
+		key_hash = 1;
+	idx = key_hash >> (32 - (map->map_bits + 1));
+
+	while (probes++ < map->map_size) {
+		idx &= (map->map_size - 1);
+		entry = &map->map[idx];
+		test_key = ACCESS_ONCE(entry->key);
+
+		if (test_key && test_key == key_hash) {
+			spins = TRACING_MAP_PUBLISH_SPINS;
+			while (!(elt = ACCESS_ONCE(entry->val)) && --spins)
+				cpu_relax();
+			if (elt) {
+				smp_rmb();
+				if (keys_match(key, elt->key, map->key_size)) {
+					atomic64_inc(&map->hits);
+					return elt;
+				}
+			}
+		} else if (!test_key) {
+			if (cmpxchg(&entry->key, 0, key_hash)) {
+				/* lost the race for this slot, look again */
+				probes--;
+				continue;
+			}
+
+			elt = get_free_elt(map);
+			if (!elt) {
+				entry->key = 0;
+				break;
+			}
+
+			memcpy(elt->key, key, map->key_size);
+			smp_wmb();
+			entry->val = elt;
+			atomic64_inc(&map->hits);
+
+			return elt;
+		}
+
+		idx++;
+	}
+
+	atomic64_inc(&map->drops);
+
+	return NULL;
+}
+
+/**
+ * tracing_map_clear - Clear a tracing_map
+ * @map: The tracing_map to clear
+ *
+ * Empties the map and zeroes every element so they can be reused.  The
+ * caller must make sure nothing is inserting concurrently.
+ */
+void tracing_map_clear(struct tracing_map *map)
+{
+	unsigned int i;
+
+	atomic_set(&map->next_elt, 0);
+	atomic64_set(&map->hits, 0);
+	atomic64_set(&map->drops, 0);
+
+	memset(map->map, 0, map->map_size * sizeof(*map->map));
+
+	for (i = 0; i < map->max_elts; i++) {
+		struct tracing_map_elt *elt = map->elts[i];
+
+		memset(elt->key, 0, map->key_size);
+		memset(elt->sums, 0, map->n_sums * sizeof(*elt->sums));
+	}
+}
+
+/**
+ * tracing_map_create - Create a lock-free map and element pool
+ * @map_bits: The size of the element pool as a power of 2
+ * @key_size: The size of the key for the map in bytes
+ *
+ * Fields are then added with tracing_map_add_sum_field() and
+ * tracing_map_add_key_field(), and the element pool is allocated by
+ * tracing_map_init().
+ *
+ * Return: the tracing_map pointer if successful, ERR_PTR if not.
+ */
+struct tracing_map *tracing_map_create(unsigned int map_bits,
+				       unsigned int key_size)
+{
+	struct tracing_map *map;
+
+	if (map_bits < TRACING_MAP_BITS_MIN ||
+	    map_bits > TRACING_MAP_BITS_MAX || !key_size)
+		return ERR_PTR(-EINVAL);
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return ERR_PTR(-ENOMEM);
+
+	map->map_bits = map_bits;
+	map->max_elts = (1 << map_bits);
+	map->map_size = (1 << (map_bits + 1));
+	map->key_size = key_size;
+	atomic_set(&map->next_elt, 0);
+
+	map->map = vzalloc(map->map_size * sizeof(*map->map));
+	if (!map->map) {
+		kfree(map);
+		return ERR_PTR(-ENOMEM);
+	}
+
+	return map;
+}
+
+/**
+ * tracing_map_init - Allocate the elements of a tracing_map
+ * @map: The tracing_map to initialize
+ *
+ * Return: 0 if successful, a negative error otherwise.
+ */
+int tracing_map_init(struct tracing_map *map)
+{
+	if (map->n_fields < 2)
+		return -EINVAL;	/* need at least one key and one val */
+
+	return tracing_map_alloc_elts(map);
+}
+
+/**
+ * tracing_map_destroy - Destroy a tracing_map
+ * @map: The tracing_map to destroy
+ *
+ * The caller must make sure nothing uses the map anymore.
+ */
+void tracing_map_destroy(struct tracing_map *map)
+{
+	if (!map)
+		return;
+
+	tracing_map_free_elts(map);
+	vfree(map->map);
+	kfree(map);
+}
+
+static int cmp_entries(const void *A, const void *B)
+{
+	const struct tracing_map_sort_entry *a, *b;
+	struct tracing_map *map;
+	unsigned int i;
+	int ret = 0;
+
+	a = *(const struct tracing_map_sort_entry **)A;
+	b = *(const struct tracing_map_sort_entry **)B;
+	map = a->elt->map;
+
+	for (i = 0; i < map->n_sort_keys; i++) {
+		struct tracing_map_sort_key *sort_key = &map->sort_keys[i];
+		struct tracing_map_field *field;
+
+		field = &map->fields[sort_key->field_idx];
+		if (field->is_key) {
+			ret = field->cmp_fn(a->key + field->offset,
+					    b->key + field->offset);
+		} else {
+			u64 val_a = tracing_map_read_sum(a->elt, field->sum_idx);
+			u64 val_b = tracing_map_read_sum(b->elt, field->sum_idx);
+
+			ret = field->cmp_fn(&val_a, &val_b);
+		}
+
+		if (sort_key->descending)
+			ret = -ret;
+		if (ret)
+			break;
+	}
+
+	return ret;
+}
+
+/**
+ * tracing_map_destroy_sort_entries - Destroy an array of sort entries
+ * @entries: The entries returned by tracing_map_sort_entries()
+ * @n_entries: The number of entries in the array
+ */
+void tracing_map_destroy_sort_entries(struct tracing_map_sort_entry **entries,
+				      unsigned int n_entries)
+{
+	unsigned int i;
+
+	for (i = 0; i < n_entries; i++)
+		kfree(entries[i]);
+
+	vfree(entries);
+}
+
+/**
+ * tracing_map_sort_entries - Sort the current set of tracing_map_elts
+ * @map: The tracing_map
+ * @sort_keys: The fields to sort on, in order of precedence
+ * @n_sort_keys: The number of sort keys
+ * @sort_entries: outval: pointer to the allocated array of sorted entries
+ *
+ * Takes a snapshot of the published entries of @map and sorts it.  The
+ * map may keep being updated meanwhile; the sums of an entry are read
+ * at compare time, so the order is only as stable as the data is.
+ * Callers must serialize calls for the same map.
+ *
+ * Return: the number of sort entries, or a negative error.  The array
+ * must be freed with tracing_map_destroy_sort_entries().
+ */
+int tracing_map_sort_entries(struct tracing_map *map,
+			     struct tracing_map_sort_key *sort_keys,
+			     unsigned int n_sort_keys,
+			     struct tracing_map_sort_entry ***sort_entries)
+{
+	struct tracing_map_sort_entry **entries;
+	unsigned int i, n_entries = 0;
+
+	if (n_sort_keys > TRACING_MAP_SORT_KEYS_MAX)
+		return -EINVAL;
+
+	entries = vmalloc(map->max_elts * sizeof(*entries));
+	if (!entries)
+		return -ENOMEM;
+
+	for (i = 0; i < map->map_size; i++) {
+		struct tracing_map_entry *entry = &map->map[i];
+		struct tracing_map_elt *elt;
+
+		if (!ACCESS_ONCE(entry->key))
+			continue;
+		elt = ACCESS_ONCE(entry->val);
+		if (!elt)
+			continue;
+		smp_rmb();
+
+		if (n_entries == map->max_elts)
+			break;
+
+		entries[n_entries] = kzalloc(sizeof(**entries), GFP_KERNEL);
+		if (!entries[n_entries]) {
+			tracing_map_destroy_sort_entries(entries, n_entries);
+			return -ENOMEM;
+		}
+		entries[n_entries]->key = elt->key;
+		entries[n_entries]->elt = elt;
+		n_entries++;
+	}
+
+	if (n_entries == 0) {
+		vfree(entries);
+		*sort_entries = NULL;
+		return 0;
+	}
+
+	memcpy(map->sort_keys, sort_keys, n_sort_keys * sizeof(*sort_keys));
+	map->n_sort_keys = n_sort_keys;
+
+	sort(entries, n_entries, sizeof(*entries), cmp_entries, NULL);
+
+	*sort_entries = entries;
+
+	return n_entries;
+}
@@ -0,0 +1,121 @@
+#ifndef __TRACING_MAP_H
+#define __TRACING_MAP_H
+
+#define TRACING_MAP_BITS_DEFAULT	11
+#define TRACING_MAP_BITS_MAX		17
+#define TRACING_MAP_BITS_MIN		7
+
+#define TRACING_MAP_KEYS_MAX		3
+#define TRACING_MAP_VALS_MAX		4
+#define TRACING_MAP_FIELDS_MAX		(TRACING_MAP_KEYS_MAX + \
+					 TRACING_MAP_VALS_MAX)
+#define TRACING_MAP_SORT_KEYS_MAX	2
+
+typedef int (*tracing_map_cmp_fn_t) (void *val_a, void *val_b);
+
+/*
+ * A tracing_map is a lock-free, insert-only hash table meant to be
+ * updated from any context a tracepoint can fire in, NMI included.
+ *
+ * Entries are claimed with cmpxchg() on the key hash and point to an
+ * element taken from a pool allocated up front, so the insert path
+ * never allocates memory or takes a lock.  An element holds a copy of
+ * the (compound) key and one atomic64_t per sum field.  Once the pool
+ * is exhausted, new keys are counted in ->drops and otherwise ignored;
+ * existing keys keep being updated.
+ *
+ * The map size is twice the number of elements, so the table never
+ * fills up and a probe sequence always terminates.
+ *
+ * Fields describe either a slice of the key (key fields) or a sum
+ * (sum fields); both can be used to sort the entries when reading the
+ * map back with tracing_map_sort_entries().
+ */
+struct tracing_map_field {
+	tracing_map_cmp_fn_t		cmp_fn;
+	union {
+		unsigned int		offset;		/* key fields */
+		unsigned int		sum_idx;	/* sum fields */
+	};
+	bool				is_key;
+};
+
+struct tracing_map_elt {
+	struct tracing_map		*map;
+	atomic64_t			*sums;
+	void				*key;
+};
+
+struct tracing_map_entry {
+	u32				key;
+	struct tracing_map_elt		*val;
+};
+
+struct tracing_map_sort_key {
+	unsigned int			field_idx;
+	bool				descending;
+};
+
+struct tracing_map_sort_entry {
+	void				*key;
+	struct tracing_map_elt		*elt;
+};
+
+struct tracing_map {
+	unsigned int			key_size;
+	unsigned int			map_bits;
+	unsigned int			map_size;
+	unsigned int			max_elts;
+	atomic_t			next_elt;
+	struct tracing_map_elt		**elts;
+	struct tracing_map_entry	*map;
+	unsigned int			n_fields;
+	unsigned int			n_sums;
+	struct tracing_map_field	fields[TRACING_MAP_FIELDS_MAX];
+	struct tracing_map_sort_key	sort_keys[TRACING_MAP_SORT_KEYS_MAX];
+	unsigned int			n_sort_keys;
+	atomic64_t			hits;
+	atomic64_t			drops;
+};
+
+extern struct tracing_map *tracing_map_create(unsigned int map_bits,
+					      unsigned int key_size);
+extern int tracing_map_init(struct tracing_map *map);
+extern void tracing_map_destroy(struct tracing_map *map);
+extern void tracing_map_clear(struct tracing_map *map);
+
+extern int tracing_map_add_sum_field(struct tracing_map *map);
+extern int tracing_map_add_key_field(struct tracing_map *map,
+				     unsigned int offset,
+				     tracing_map_cmp_fn_t cmp_fn);
+
+extern struct tracing_map_elt *
+tracing_map_insert(struct tracing_map *map, void *key);
+
+extern tracing_map_cmp_fn_t tracing_map_cmp_num(int field_size,
+						int field_is_signed);
+extern int tracing_map_cmp_string(void *val_a, void *val_b);
+extern int tracing_map_cmp_none(void *val_a, void *val_b);
+
+static inline void tracing_map_update_sum(struct tracing_map_elt *elt,
+					  unsigned int i, u64 n)
+{
+	atomic64_add(n, &elt->sums[i]);
+}
+
+static inline u64 tracing_map_read_sum(struct tracing_map_elt *elt,
+				       unsigned int i)
+{
+	return (u64)atomic64_read(&elt->sums[i]);
+}
+
+extern int
+tracing_map_sort_entries(struct tracing_map *map,
+			 struct tracing_map_sort_key *sort_keys,
+			 unsigned int n_sort_keys,
+			 struct tracing_map_sort_entry ***sort_entries);
+extern void
+tracing_map_destroy_sort_entries(struct tracing_map_sort_entry **entries,
+				 unsigned int n_entries);
+
+#endif /* __TRACING_MAP_H */
@@ -2091,20 +2091,21 @@ static DEFINE_MUTEX(xps_map_mutex);
 	rcu_dereference_protected((P), lockdep_is_held(&xps_map_mutex))
 
 static struct xps_map *remove_xps_queue(struct xps_dev_maps *dev_maps,
-					int cpu, u16 index)
+					int attr_index, u16 index)
 {
 	struct xps_map *map = NULL;
 	int pos;
 
 	if (dev_maps)
-		map = xmap_dereference(dev_maps->cpu_map[cpu]);
+		map = xmap_dereference(dev_maps->cpu_map[attr_index]);
 
 	for (pos = 0; map && pos < map->len; pos++) {
 		if (map->queues[pos] == index) {
 			if (map->len > 1) {
 				map->queues[pos] = map->queues[--map->len];
 			} else {
-				RCU_INIT_POINTER(dev_maps->cpu_map[cpu], NULL);
+				RCU_INIT_POINTER(dev_maps->cpu_map[attr_index],
+						 NULL);
 				kfree_rcu(map, rcu);
 				map = NULL;
 			}
@@ -2115,21 +2116,21 @@ static struct xps_map *remove_xps_queue(struct xps_dev_maps *dev_maps,
 	return map;
 }
 
-static void netif_reset_xps_queues_gt(struct net_device *dev, u16 index)
+static void clean_xps_maps(struct net_device *dev,
+			   struct xps_dev_maps __rcu **maps_p,
+			   unsigned int nr_ids, u16 index)
 {
 	struct xps_dev_maps *dev_maps;
-	int cpu, i;
 	bool active = false;
+	int j, i;
 
-	mutex_lock(&xps_map_mutex);
-	dev_maps = xmap_dereference(dev->xps_maps);
-
+	dev_maps = xmap_dereference(*maps_p);
 	if (!dev_maps)
-		goto out_no_maps;
+		return;
 
-	for_each_possible_cpu(cpu) {
+	for (j = 0; j < nr_ids; j++) {
 		for (i = index; i < dev->num_tx_queues; i++) {
-			if (!remove_xps_queue(dev_maps, cpu, i))
+			if (!remove_xps_queue(dev_maps, j, i))
 				break;
 		}
 		if (i == dev->num_tx_queues)
@@ -2137,9 +2138,24 @@ static void netif_reset_xps_queues_gt(struct net_device *dev, u16 index)
 	}
 
 	if (!active) {
-		RCU_INIT_POINTER(dev->xps_maps, NULL);
+		RCU_INIT_POINTER(*maps_p, NULL);
 		kfree_rcu(dev_maps, rcu);
 	}
+}
+
+static void netif_reset_xps_queues_gt(struct net_device *dev, u16 index)
+{
+	int i;
+
+	mutex_lock(&xps_map_mutex);
+
+	clean_xps_maps(dev, &dev->extended->xps_rxqs_map,
+		       dev->num_rx_queues, index);
+
+	if (!xmap_dereference(dev->xps_maps))
+		goto out_no_maps;
+
+	clean_xps_maps(dev, &dev->xps_maps, nr_cpu_ids, index);
 
 	for (i = index; i < dev->num_tx_queues; i++)
 		netdev_queue_numa_node_write(netdev_get_tx_queue(dev, i),
@@ -2149,8 +2165,8 @@ out_no_maps:
 	mutex_unlock(&xps_map_mutex);
 }
 
-static struct xps_map *expand_xps_map(struct xps_map *map,
-				      int cpu, u16 index)
+static struct xps_map *expand_xps_map(struct xps_map *map, int attr_index,
+				      u16 index, bool is_rxqs_map)
 {
 	struct xps_map *new_map;
 	int alloc_len = XPS_MIN_MAP_ALLOC;
@@ -2171,8 +2187,11 @@ static struct xps_map *expand_xps_map(struct xps_map *map,
 	}
 
 	/* Need to allocate new map to store queue on this CPU's map */
-	new_map = kzalloc_node(XPS_MAP_SIZE(alloc_len), GFP_KERNEL,
-			       cpu_to_node(cpu));
+	if (is_rxqs_map)
+		new_map = kzalloc(XPS_MAP_SIZE(alloc_len), GFP_KERNEL);
+	else
+		new_map = kzalloc_node(XPS_MAP_SIZE(alloc_len), GFP_KERNEL,
+				       cpu_to_node(attr_index));
 	if (!new_map)
 		return NULL;
 
@@ -2184,22 +2203,45 @@ static struct xps_map *expand_xps_map(struct xps_map *map,
 	return new_map;
 }
 
-int netif_set_xps_queue(struct net_device *dev, const struct cpumask *mask,
-			u16 index)
+/* CPU maps only ever hold online CPUs, RX queue maps hold any queue */
+static bool xps_attr_active(int attr_index, const unsigned long *mask,
+			    bool is_rxqs_map)
 {
+	if (!test_bit(attr_index, mask))
+		return false;
+
+	return is_rxqs_map || cpu_online(attr_index);
+}
+
+int __netif_set_xps_queue(struct net_device *dev, const unsigned long *mask,
+			  u16 index, bool is_rxqs_map)
+{
+	struct xps_dev_maps __rcu **maps_p;
 	struct xps_dev_maps *dev_maps, *new_dev_maps = NULL;
 	struct xps_map *map, *new_map;
-	int maps_sz = max_t(unsigned int, XPS_DEV_MAPS_SIZE, L1_CACHE_BYTES);
-	int cpu, numa_node_id = -2;
+	unsigned int nr_ids;
+	int maps_sz;
+	int j, numa_node_id = -2;
 	bool active = false;
 
+	if (is_rxqs_map) {
+		maps_p = &dev->extended->xps_rxqs_map;
+		nr_ids = dev->num_rx_queues;
+		maps_sz = XPS_RXQ_DEV_MAPS_SIZE(nr_ids);
+	} else {
+		maps_p = &dev->xps_maps;
+		nr_ids = nr_cpu_ids;
+		maps_sz = XPS_DEV_MAPS_SIZE;
+	}
+	maps_sz = max_t(unsigned int, maps_sz, L1_CACHE_BYTES);
+
 	mutex_lock(&xps_map_mutex);
 
-	dev_maps = xmap_dereference(dev->xps_maps);
+	dev_maps = xmap_dereference(*maps_p);
 
 	/* allocate memory for queue storage */
-	for_each_online_cpu(cpu) {
-		if (!cpumask_test_cpu(cpu, mask))
+	for (j = 0; j < nr_ids; j++) {
+		if (!xps_attr_active(j, mask, is_rxqs_map))
 			continue;
 
 		if (!new_dev_maps)
@@ -2209,51 +2251,53 @@ int netif_set_xps_queue(struct net_device *dev, const struct cpumask *mask,
 			return -ENOMEM;
 		}
 
-		map = dev_maps ? xmap_dereference(dev_maps->cpu_map[cpu]) :
+		map = dev_maps ? xmap_dereference(dev_maps->cpu_map[j]) :
 				 NULL;
 
-		map = expand_xps_map(map, cpu, index);
+		map = expand_xps_map(map, j, index, is_rxqs_map);
 		if (!map)
 			goto error;
 
-		RCU_INIT_POINTER(new_dev_maps->cpu_map[cpu], map);
+		RCU_INIT_POINTER(new_dev_maps->cpu_map[j], map);
 	}
 
 	if (!new_dev_maps)
 		goto out_no_new_maps;
 
-	for_each_possible_cpu(cpu) {
-		if (cpumask_test_cpu(cpu, mask) && cpu_online(cpu)) {
+	for (j = 0; j < nr_ids; j++) {
+		if (xps_attr_active(j, mask, is_rxqs_map)) {
 			/* add queue to CPU maps */
 			int pos = 0;
 
-			map = xmap_dereference(new_dev_maps->cpu_map[cpu]);
+			map = xmap_dereference(new_dev_maps->cpu_map[j]);
 			while ((pos < map->len) && (map->queues[pos] != index))
 				pos++;
 
 			if (pos == map->len)
 				map->queues[map->len++] = index;
 #ifdef CONFIG_NUMA
-			if (numa_node_id == -2)
-				numa_node_id = cpu_to_node(cpu);
-			else if (numa_node_id != cpu_to_node(cpu))
-				numa_node_id = -1;
+			if (!is_rxqs_map) {
+				if (numa_node_id == -2)
+					numa_node_id = cpu_to_node(j);
+				else if (numa_node_id != cpu_to_node(j))
+					numa_node_id = -1;
+			}
 #endif
 		} else if (dev_maps) {
 			/* fill in the new device map from the old device map */
-			map = xmap_dereference(dev_maps->cpu_map[cpu]);
-			RCU_INIT_POINTER(new_dev_maps->cpu_map[cpu], map);
+			map = xmap_dereference(dev_maps->cpu_map[j]);
+			RCU_INIT_POINTER(new_dev_maps->cpu_map[j], map);
 		}
 
 	}
 
-	rcu_assign_pointer(dev->xps_maps, new_dev_maps);
+	rcu_assign_pointer(*maps_p, new_dev_maps);
 
 	/* Cleanup old maps */
 	if (dev_maps) {
-		for_each_possible_cpu(cpu) {
-			new_map = xmap_dereference(new_dev_maps->cpu_map[cpu]);
-			map = xmap_dereference(dev_maps->cpu_map[cpu]);
+		for (j = 0; j < nr_ids; j++) {
+			new_map = xmap_dereference(new_dev_maps->cpu_map[j]);
+			map = xmap_dereference(dev_maps->cpu_map[j]);
 			if (map && map != new_map)
 				kfree_rcu(map, rcu);
 		}
@@ -2266,25 +2310,26 @@ int netif_set_xps_queue(struct net_device *dev, const struct cpumask *mask,
 
 out_no_new_maps:
 	/* update Tx queue numa node */
-	netdev_queue_numa_node_write(netdev_get_tx_queue(dev, index),
-				     (numa_node_id >= 0) ? numa_node_id :
-				     NUMA_NO_NODE);
+	if (!is_rxqs_map)
+		netdev_queue_numa_node_write(netdev_get_tx_queue(dev, index),
+					     (numa_node_id >= 0) ?
+					     numa_node_id : NUMA_NO_NODE);
 
 	if (!dev_maps)
 		goto out_no_maps;
 
 	/* removes queue from unused CPUs */
-	for_each_possible_cpu(cpu) {
-		if (cpumask_test_cpu(cpu, mask) && cpu_online(cpu))
+	for (j = 0; j < nr_ids; j++) {
+		if (xps_attr_active(j, mask, is_rxqs_map))
 			continue;
 
-		if (remove_xps_queue(dev_maps, cpu, index))
+		if (remove_xps_queue(dev_maps, j, index))
 			active = true;
 	}
 
 	/* free map if not active */
 	if (!active) {
-		RCU_INIT_POINTER(dev->xps_maps, NULL);
+		RCU_INIT_POINTER(*maps_p, NULL);
 		kfree_rcu(dev_maps, rcu);
 	}
 
@@ -2294,9 +2339,9 @@ out_no_maps:
 	return 0;
 error:
 	/* remove any maps that we added */
-	for_each_possible_cpu(cpu) {
-		new_map = xmap_dereference(new_dev_maps->cpu_map[cpu]);
-		map = dev_maps ? xmap_dereference(dev_maps->cpu_map[cpu]) :
+	for (j = 0; j < nr_ids; j++) {
+		new_map = xmap_dereference(new_dev_maps->cpu_map[j]);
+		map = dev_maps ? xmap_dereference(dev_maps->cpu_map[j]) :
 				 NULL;
 		if (new_map && new_map != map)
 			kfree(new_map);
@@ -2307,6 +2352,13 @@ error:
 	kfree(new_dev_maps);
 	return -ENOMEM;
 }
+EXPORT_SYMBOL(__netif_set_xps_queue);
+
+int netif_set_xps_queue(struct net_device *dev, const struct cpumask *mask,
+			u16 index)
+{
+	return __netif_set_xps_queue(dev, cpumask_bits(mask), index, false);
+}
 EXPORT_SYMBOL(netif_set_xps_queue);
 
 #endif
@@ -3308,27 +3360,51 @@ sch_handle_egress(struct sk_buff *skb, int *ret, struct net_device *dev)
 }
 #endif /* CONFIG_NET_EGRESS */
 
+#ifdef CONFIG_XPS
+static int __get_xps_queue_idx(struct net_device *dev, struct sk_buff *skb,
+			       struct xps_dev_maps *dev_maps,
+			       unsigned int attr_index)
+{
+	struct xps_map *map;
+	int queue_index = -1;
+
+	map = rcu_dereference(dev_maps->cpu_map[attr_index]);
+	if (map) {
+		if (map->len == 1)
+			queue_index = map->queues[0];
+		else
+			queue_index = map->queues[reciprocal_scale(skb_get_hash(skb),
+								   map->len)];
+		if (unlikely(queue_index >= dev->real_num_tx_queues))
+			queue_index = -1;
+	}
+	return queue_index;
+}
+#endif
+
 static inline int get_xps_queue(struct net_device *dev, struct sk_buff *skb)
 {
 #ifdef CONFIG_XPS
 	struct xps_dev_maps *dev_maps;
-	struct xps_map *map;
+	struct sock *sk = skb->sk;
 	int queue_index = -1;
 
 	rcu_read_lock();
-	dev_maps = rcu_dereference(dev->xps_maps);
-	if (dev_maps) {
-		map = rcu_dereference(
-		    dev_maps->cpu_map[skb->sender_cpu - 1]);
-		if (map) {
-			if (map->len == 1)
-				queue_index = map->queues[0];
-			else
-				queue_index = map->queues[reciprocal_scale(skb_get_hash(skb),
-									   map->len)];
-			if (unlikely(queue_index >= dev->real_num_tx_queues))
-				queue_index = -1;
-		}
+	/* a flow's own RX queue takes precedence over the sending CPU */
+	dev_maps = rcu_dereference(dev->extended->xps_rxqs_map);
+	if (dev_maps && sk && sk_fullsock(sk)) {
+		int rxq = sk_rx_queue_get(sk);
+
+		if (rxq >= 0 && rxq < dev->num_rx_queues)
+			queue_index = __get_xps_queue_idx(dev, skb, dev_maps,
+							  rxq);
+	}
+
+	if (queue_index < 0) {
+		dev_maps = rcu_dereference(dev->xps_maps);
+		if (dev_maps)
+			queue_index = __get_xps_queue_idx(dev, skb, dev_maps,
+							  skb->sender_cpu - 1);
 	}
 	rcu_read_unlock();
 
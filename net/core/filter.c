@@ -37,6 +37,7 @@
 #include <asm/uaccess.h>
 #include <asm/unaligned.h>
 #include <linux/filter.h>
+#include <linux/bpf.h>
 #include <linux/ratelimit.h>
 #include <linux/seccomp.h>
 #include <linux/if_vlan.h>
@@ -639,6 +640,564 @@ int sk_chk_filter(struct sock_filter *filter, unsigned int flen)
 }
 EXPORT_SYMBOL(sk_chk_filter);
 
+/* Helpers for ancillary loads that have no direct eBPF equivalent. They
+ * are called from converted programs with R1 = skb, R2 = A and R3 = X,
+ * and return the new value of A in R0.
+ */
+static u64 __skb_get_pay_offset(u64 ctx, u64 a, u64 x, u64 r4, u64 r5)
+{
+	return skb_get_poff((struct sk_buff *)(unsigned long) ctx);
+}
+
+static u64 __skb_get_pkt_type(u64 ctx, u64 a, u64 x, u64 r4, u64 r5)
+{
+	return ((struct sk_buff *)(unsigned long) ctx)->pkt_type;
+}
+
+static u64 __skb_get_nlattr(u64 ctx, u64 a, u64 x, u64 r4, u64 r5)
+{
+	struct sk_buff *skb = (struct sk_buff *)(unsigned long) ctx;
+	struct nlattr *nla;
+
+	if (skb_is_nonlinear(skb))
+		return 0;
+
+	if (skb->len < sizeof(struct nlattr))
+		return 0;
+
+	if (a > skb->len - sizeof(struct nlattr))
+		return 0;
+
+	nla = nla_find((struct nlattr *) &skb->data[a], skb->len - a, x);
+	if (nla)
+		return (void *) nla - (void *) skb->data;
+
+	return 0;
+}
+
+static u64 __skb_get_nlattr_nest(u64 ctx, u64 a, u64 x, u64 r4, u64 r5)
+{
+	struct sk_buff *skb = (struct sk_buff *)(unsigned long) ctx;
+	struct nlattr *nla;
+
+	if (skb_is_nonlinear(skb))
+		return 0;
+
+	if (skb->len < sizeof(struct nlattr))
+		return 0;
+
+	if (a > skb->len - sizeof(struct nlattr))
+		return 0;
+
+	nla = (struct nlattr *) &skb->data[a];
+	if (nla->nla_len > skb->len - a)
+		return 0;
+
+	nla = nla_find_nested(nla, x);
+	if (nla)
+		return (void *) nla - (void *) skb->data;
+
+	return 0;
+}
+
+static u64 __get_raw_cpu_id(u64 ctx, u64 a, u64 x, u64 r4, u64 r5)
+{
+	return raw_smp_processor_id();
+}
+
+static void convert_bpf_call(struct bpf_insn **insnp,
+			     u64 (*func)(u64, u64, u64, u64, u64))
+{
+	struct bpf_insn *insn = *insnp;
+
+	/* arg1 = ctx, arg2 = A, arg3 = X */
+	*insn++ = BPF_MOV64_REG(BPF_REG_ARG1, BPF_REG_CTX);
+	*insn++ = BPF_MOV64_REG(BPF_REG_ARG2, BPF_REG_A);
+	*insn++ = BPF_MOV64_REG(BPF_REG_ARG3, BPF_REG_X);
+	/* A = func(ctx, A, X) */
+	*insn = BPF_EMIT_CALL(func);
+
+	*insnp = insn;
+}
+
+static bool convert_bpf_extensions(const struct sock_filter *fp,
+				   struct bpf_insn **insnp)
+{
+	struct bpf_insn *insn = *insnp;
+
+	switch (fp->code) {
+	case BPF_S_ANC_PROTOCOL:
+		/* A = ntohs(skb->protocol) */
+		*insn++ = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct sk_buff, protocol),
+				      BPF_REG_A, BPF_REG_CTX,
+				      offsetof(struct sk_buff, protocol));
+		*insn = BPF_ENDIAN(BPF_FROM_BE, BPF_REG_A, 16);
+		break;
+
+	case BPF_S_ANC_IFINDEX:
+	case BPF_S_ANC_HATYPE:
+		BUILD_BUG_ON(FIELD_SIZEOF(struct net_device, ifindex) != 4);
+		BUILD_BUG_ON(FIELD_SIZEOF(struct net_device, type) != 2);
+
+		*insn++ = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct sk_buff, dev),
+				      BPF_REG_TMP, BPF_REG_CTX,
+				      offsetof(struct sk_buff, dev));
+		/* if (tmp == NULL) return 0; */
+		*insn++ = BPF_JMP_IMM(BPF_JNE, BPF_REG_TMP, 0, 2);
+		*insn++ = BPF_MOV32_IMM(BPF_REG_A, 0);
+		*insn++ = BPF_EXIT_INSN();
+		if (fp->code == BPF_S_ANC_IFINDEX)
+			*insn = BPF_LDX_MEM(BPF_W, BPF_REG_A, BPF_REG_TMP,
+					    offsetof(struct net_device, ifindex));
+		else
+			*insn = BPF_LDX_MEM(BPF_H, BPF_REG_A, BPF_REG_TMP,
+					    offsetof(struct net_device, type));
+		break;
+
+	case BPF_S_ANC_MARK:
+		*insn = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct sk_buff, mark),
+				    BPF_REG_A, BPF_REG_CTX,
+				    offsetof(struct sk_buff, mark));
+		break;
+
+	case BPF_S_ANC_RXHASH:
+		*insn = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct sk_buff, hash),
+				    BPF_REG_A, BPF_REG_CTX,
+				    offsetof(struct sk_buff, hash));
+		break;
+
+	case BPF_S_ANC_QUEUE:
+		*insn = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct sk_buff, queue_mapping),
+				    BPF_REG_A, BPF_REG_CTX,
+				    offsetof(struct sk_buff, queue_mapping));
+		break;
+
+	case BPF_S_ANC_VLAN_TAG:
+	case BPF_S_ANC_VLAN_TAG_PRESENT:
+		BUILD_BUG_ON(VLAN_TAG_PRESENT != 0x1000);
+
+		/* A = skb->vlan_tci */
+		*insn++ = BPF_LDX_MEM(BPF_FIELD_SIZEOF(struct sk_buff, vlan_tci),
+				      BPF_REG_A, BPF_REG_CTX,
+				      offsetof(struct sk_buff, vlan_tci));
+		if (fp->code == BPF_S_ANC_VLAN_TAG) {
+			*insn = BPF_ALU32_IMM(BPF_AND, BPF_REG_A,
+					      ~VLAN_TAG_PRESENT);
+		} else {
+			/* A >>= 12 */
+			*insn++ = BPF_ALU32_IMM(BPF_RSH, BPF_REG_A, 12);
+			/* A &= 1 */
+			*insn = BPF_ALU32_IMM(BPF_AND, BPF_REG_A, 1);
+		}
+		break;
+
+	case BPF_S_ANC_PKTTYPE:
+		convert_bpf_call(&insn, __skb_get_pkt_type);
+		break;
+	case BPF_S_ANC_PAY_OFFSET:
+		convert_bpf_call(&insn, __skb_get_pay_offset);
+		break;
+	case BPF_S_ANC_NLATTR:
+		convert_bpf_call(&insn, __skb_get_nlattr);
+		break;
+	case BPF_S_ANC_NLATTR_NEST:
+		convert_bpf_call(&insn, __skb_get_nlattr_nest);
+		break;
+	case BPF_S_ANC_CPU:
+		convert_bpf_call(&insn, __get_raw_cpu_id);
+		break;
+
+	case BPF_S_ANC_ALU_XOR_X:
+		/* A ^= X */
+		*insn = BPF_ALU32_REG(BPF_XOR, BPF_REG_A, BPF_REG_X);
+		break;
+
+	case BPF_S_ANC_SECCOMP_LD_W:
+		/* A = *(u32 *) (ctx + K), ctx being struct seccomp_data */
+		*insn = BPF_LDX_MEM(BPF_W, BPF_REG_A, BPF_REG_CTX, fp->k);
+		break;
+
+	default:
+		return false;
+	}
+
+	*insnp = insn;
+	return true;
+}
+
+/**
+ *	bpf_convert_filter - convert a checked classic filter to eBPF
+ *	@prog: classic program, already checked by sk_chk_filter()
+ *	@len: length of the classic program
+ *	@new_prog: eBPF program to fill in, or NULL
+ *	@new_len: length of the resulting eBPF program
+ *
+ * Remap the classic instructions onto eBPF ones: A and X live in
+ * BPF_REG_A and BPF_REG_X, the scratch memory store lives on the eBPF
+ * stack and ctx (the skb, or struct seccomp_data for seccomp) is kept
+ * in BPF_REG_CTX. Ancillary loads are expanded inline or turned into
+ * helper calls.
+ *
+ * Called first with @new_prog == NULL to compute @new_len, then with an
+ * allocated program of that length to emit the instructions.
+ */
+static int bpf_convert_filter(const struct sock_filter *prog, int len,
+			      struct bpf_prog *new_prog, int *new_len)
+{
+	int new_flen = 0, pass = 0, target, i, stack_off;
+	struct bpf_insn *new_insn, *first_insn = NULL;
+	const struct sock_filter *fp;
+	int *addrs = NULL;
+	u8 bpf_src;
+
+	BUILD_BUG_ON(BPF_MEMWORDS * sizeof(u32) > MAX_BPF_STACK);
+	BUILD_BUG_ON(BPF_REG_FP + 1 != MAX_BPF_REG);
+
+	if (len <= 0 || len > BPF_MAXINSNS)
+		return -EINVAL;
+
+	if (new_prog) {
+		first_insn = new_prog->insnsi;
+		addrs = kcalloc(len, sizeof(*addrs), GFP_KERNEL | __GFP_NOWARN);
+		if (!addrs)
+			return -ENOMEM;
+	}
+
+do_pass:
+	new_insn = first_insn;
+	fp = prog;
+
+	/* Classic BPF expects A and X to be reset first, and ctx has to
+	 * be kept in the callee saved BPF_REG_CTX for ld_abs/ld_ind and
+	 * helper calls. Initial ctx is present in BPF_REG_ARG1.
+	 */
+	if (new_prog) {
+		*new_insn++ = BPF_ALU64_REG(BPF_XOR, BPF_REG_A, BPF_REG_A);
+		*new_insn++ = BPF_ALU64_REG(BPF_XOR, BPF_REG_X, BPF_REG_X);
+		*new_insn++ = BPF_MOV64_REG(BPF_REG_CTX, BPF_REG_ARG1);
+	} else {
+		new_insn += 3;
+	}
+
+	for (i = 0; i < len; fp++, i++) {
+		struct bpf_insn tmp_insns[6] = { };
+		struct bpf_insn *insn = tmp_insns;
+		struct sock_filter cfp;
+
+		if (addrs)
+			addrs[i] = new_insn - first_insn;
+
+		/* Get back the classic opcode for the BPF_S_* one. */
+		sk_decode_filter((struct sock_filter *) fp, &cfp);
+
+		switch (fp->code) {
+		/* All arithmetic insns and skb loads map as-is. */
+		case BPF_S_ALU_ADD_X:
+		case BPF_S_ALU_ADD_K:
+		case BPF_S_ALU_SUB_X:
+		case BPF_S_ALU_SUB_K:
+		case BPF_S_ALU_AND_X:
+		case BPF_S_ALU_AND_K:
+		case BPF_S_ALU_OR_X:
+		case BPF_S_ALU_OR_K:
+		case BPF_S_ALU_LSH_X:
+		case BPF_S_ALU_LSH_K:
+		case BPF_S_ALU_RSH_X:
+		case BPF_S_ALU_RSH_K:
+		case BPF_S_ALU_XOR_X:
+		case BPF_S_ALU_XOR_K:
+		case BPF_S_ALU_MUL_X:
+		case BPF_S_ALU_MUL_K:
+		case BPF_S_ALU_DIV_X:
+		case BPF_S_ALU_DIV_K:
+		case BPF_S_ALU_MOD_X:
+		case BPF_S_ALU_MOD_K:
+		case BPF_S_ALU_NEG:
+		case BPF_S_LD_W_ABS:
+		case BPF_S_LD_H_ABS:
+		case BPF_S_LD_B_ABS:
+		case BPF_S_LD_W_IND:
+		case BPF_S_LD_H_IND:
+		case BPF_S_LD_B_IND:
+			if (fp->code == BPF_S_ALU_DIV_X ||
+			    fp->code == BPF_S_ALU_MOD_X) {
+				/* Classic BPF returns 0 on division by 0. */
+				*insn++ = BPF_JMP_IMM(BPF_JNE, BPF_REG_X, 0, 2);
+				*insn++ = BPF_ALU32_REG(BPF_XOR, BPF_REG_A, BPF_REG_A);
+				*insn++ = BPF_EXIT_INSN();
+			}
+
+			*insn = BPF_RAW_INSN(cfp.code, BPF_REG_A, BPF_REG_X, 0, fp->k);
+			break;
+
+		/* Ancillary data loads are overloaded ld_abs insns. */
+		case BPF_S_ANC_PROTOCOL:
+		case BPF_S_ANC_PKTTYPE:
+		case BPF_S_ANC_IFINDEX:
+		case BPF_S_ANC_NLATTR:
+		case BPF_S_ANC_NLATTR_NEST:
+		case BPF_S_ANC_MARK:
+		case BPF_S_ANC_QUEUE:
+		case BPF_S_ANC_HATYPE:
+		case BPF_S_ANC_RXHASH:
+		case BPF_S_ANC_CPU:
+		case BPF_S_ANC_ALU_XOR_X:
+		case BPF_S_ANC_SECCOMP_LD_W:
+		case BPF_S_ANC_VLAN_TAG:
+		case BPF_S_ANC_VLAN_TAG_PRESENT:
+		case BPF_S_ANC_PAY_OFFSET:
+			if (!convert_bpf_extensions(fp, &insn))
+				goto err;
+			break;
+
+		/* Jump transformation cannot use BPF block macros
+		 * everywhere as offset calculation and target updates
+		 * require a bit more work than the rest, i.e. jump
+		 * opcodes map as-is, but offsets need adjustment.
+		 */
+
+#define BPF_EMIT_JMP							\
+	do {								\
+		const s32 off_min = S16_MIN, off_max = S16_MAX;		\
+		s32 off;						\
+									\
+		if (target >= len || target < 0)			\
+			goto err;					\
+		off = addrs ? addrs[target] - addrs[i] - 1 : 0;		\
+		/* Adjust pc relative offset for 2nd or 3rd insn. */	\
+		off -= insn - tmp_insns;				\
+		/* Reject anything not fitting into insn->off. */	\
+		if (off < off_min || off > off_max)			\
+			goto err;					\
+		insn->off = off;					\
+	} while (0)
+
+		case BPF_S_JMP_JA:
+			target = i + fp->k + 1;
+			insn->code = cfp.code;
+			BPF_EMIT_JMP;
+			break;
+
+		case BPF_S_JMP_JEQ_K:
+		case BPF_S_JMP_JEQ_X:
+		case BPF_S_JMP_JSET_K:
+		case BPF_S_JMP_JSET_X:
+		case BPF_S_JMP_JGT_K:
+		case BPF_S_JMP_JGT_X:
+		case BPF_S_JMP_JGE_K:
+		case BPF_S_JMP_JGE_X:
+			if (BPF_SRC(cfp.code) == BPF_K && (int) fp->k < 0) {
+				/* BPF immediates are signed, zero extend
+				 * immediate into tmp register and use it
+				 * in compare insn.
+				 */
+				*insn++ = BPF_MOV32_IMM(BPF_REG_TMP, fp->k);
+
+				insn->dst_reg = BPF_REG_A;
+				insn->src_reg = BPF_REG_TMP;
+				bpf_src = BPF_X;
+			} else {
+				insn->dst_reg = BPF_REG_A;
+				insn->imm = fp->k;
+				bpf_src = BPF_SRC(cfp.code);
+				insn->src_reg = bpf_src == BPF_X ? BPF_REG_X : 0;
+			}
+
+			/* Common case where 'jump_false' is next insn. */
+			if (fp->jf == 0) {
+				insn->code = BPF_JMP | BPF_OP(cfp.code) | bpf_src;
+				target = i + fp->jt + 1;
+				BPF_EMIT_JMP;
+				break;
+			}
+
+			/* Convert some jumps when 'jump_true' is next insn. */
+			if (fp->jt == 0) {
+				switch (BPF_OP(cfp.code)) {
+				case BPF_JEQ:
+					insn->code = BPF_JMP | BPF_JNE | bpf_src;
+					break;
+				case BPF_JGT:
+					insn->code = BPF_JMP | BPF_JLE | bpf_src;
+					break;
+				case BPF_JGE:
+					insn->code = BPF_JMP | BPF_JLT | bpf_src;
+					break;
+				default:
+					goto jmp_rest;
+				}
+
+				target = i + fp->jf + 1;
+				BPF_EMIT_JMP;
+				break;
+			}
+jmp_rest:
+			/* Other jumps are mapped into two insns: Jxx and JA. */
+			target = i + fp->jt + 1;
+			insn->code = BPF_JMP | BPF_OP(cfp.code) | bpf_src;
+			BPF_EMIT_JMP;
+			insn++;
+
+			insn->code = BPF_JMP | BPF_JA;
+			target = i + fp->jf + 1;
+			BPF_EMIT_JMP;
+			break;
+
+		/* ldxb 4 * ([14] & 0xf) is remaped into 6 insns. */
+		case BPF_S_LDX_B_MSH:
+			/* tmp = A */
+			*insn++ = BPF_MOV64_REG(BPF_REG_TMP, BPF_REG_A);
+			/* A = BPF_R0 = *(u8 *) (skb->data + K) */
+			*insn++ = BPF_LD_ABS(BPF_B, fp->k);
+			/* A &= 0xf */
+			*insn++ = BPF_ALU32_IMM(BPF_AND, BPF_REG_A, 0xf);
+			/* A <<= 2 */
+			*insn++ = BPF_ALU32_IMM(BPF_LSH, BPF_REG_A, 2);
+			/* X = A */
+			*insn++ = BPF_MOV64_REG(BPF_REG_X, BPF_REG_A);
+			/* A = tmp */
+			*insn = BPF_MOV64_REG(BPF_REG_A, BPF_REG_TMP);
+			break;
+
+		/* RET_K is remaped into 2 insns. RET_A case doesn't need an
+		 * extra mov as BPF_REG_0 is already mapped into BPF_REG_A.
+		 */
+		case BPF_S_RET_A:
+		case BPF_S_RET_K:
+			if (fp->code == BPF_S_RET_K)
+				*insn++ = BPF_MOV32_RAW(BPF_K, BPF_REG_0,
+							0, fp->k);
+			*insn = BPF_EXIT_INSN();
+			break;
+
+		/* Store to stack. */
+		case BPF_S_ST:
+		case BPF_S_STX:
+			stack_off = fp->k * 4 + 4;
+			*insn = BPF_STX_MEM(BPF_W, BPF_REG_FP,
+					    fp->code == BPF_S_ST ?
+					    BPF_REG_A : BPF_REG_X, -stack_off);
+			/* check_load_and_stores() verifies that classic BPF
+			 * only loads from stack after a write, so tracking
+			 * stack_depth for ST|STX insns is enough.
+			 */
+			if (new_prog && new_prog->aux->stack_depth < stack_off)
+				new_prog->aux->stack_depth = stack_off;
+			break;
+
+		/* Load from stack. */
+		case BPF_S_LD_MEM:
+		case BPF_S_LDX_MEM:
+			stack_off = fp->k * 4 + 4;
+			*insn = BPF_LDX_MEM(BPF_W, fp->code == BPF_S_LD_MEM ?
+					    BPF_REG_A : BPF_REG_X, BPF_REG_FP,
+					    -stack_off);
+			break;
+
+		/* A = K or X = K */
+		case BPF_S_LD_IMM:
+		case BPF_S_LDX_IMM:
+			*insn = BPF_MOV32_IMM(fp->code == BPF_S_LD_IMM ?
+					      BPF_REG_A : BPF_REG_X, fp->k);
+			break;
+
+		/* X = A */
+		case BPF_S_MISC_TAX:
+			*insn = BPF_MOV64_REG(BPF_REG_X, BPF_REG_A);
+			break;
+
+		/* A = X */
+		case BPF_S_MISC_TXA:
+			*insn = BPF_MOV64_REG(BPF_REG_A, BPF_REG_X);
+			break;
+
+		/* A = skb->len or X = skb->len */
+		case BPF_S_LD_W_LEN:
+		case BPF_S_LDX_W_LEN:
+			*insn = BPF_LDX_MEM(BPF_W, fp->code == BPF_S_LD_W_LEN ?
+					    BPF_REG_A : BPF_REG_X, BPF_REG_CTX,
+					    offsetof(struct sk_buff, len));
+			break;
+
+		/* Unknown instruction. */
+		default:
+			goto err;
+		}
+
+		insn++;
+		if (new_prog)
+			memcpy(new_insn, tmp_insns,
+			       sizeof(*insn) * (insn - tmp_insns));
+		new_insn += insn - tmp_insns;
+	}
+
+	if (!new_prog) {
+		/* Only calculating new length. */
+		*new_len = new_insn - first_insn;
+		return 0;
+	}
+
+	pass++;
+	if (new_flen != new_insn - first_insn) {
+		new_flen = new_insn - first_insn;
+		if (pass > 2)
+			goto err;
+		goto do_pass;
+	}
+
+	kfree(addrs);
+	BUG_ON(*new_len != new_flen);
+	return 0;
+err:
+	kfree(addrs);
+	return -EINVAL;
+}
+
+/**
+ *	bpf_migrate_filter - move a checked classic filter onto eBPF
+ *	@insns: classic program, already checked by sk_chk_filter()
+ *	@len: length of the classic program
+ *
+ * Translate the classic program into eBPF and hand it to
+ * bpf_prog_select_runtime(), so that it runs on the eBPF JIT (with
+ * constant blinding where enabled) or on the eBPF interpreter.
+ *
+ * Returns the eBPF program or an ERR_PTR() on failure, in which case
+ * the caller keeps running the classic program.
+ */
+struct bpf_prog *bpf_migrate_filter(const struct sock_filter *insns,
+				    unsigned int len)
+{
+	struct bpf_prog *fp;
+	int err, new_len;
+
+	/* 1st pass: calculate the new program length. */
+	err = bpf_convert_filter(insns, len, NULL, &new_len);
+	if (err)
+		return ERR_PTR(err);
+
+	fp = bpf_prog_alloc(bpf_prog_size(new_len), __GFP_NOWARN);
+	if (!fp)
+		return ERR_PTR(-ENOMEM);
+
+	/* 2nd pass: remap the classic program into eBPF insns. */
+	fp->len = new_len;
+	err = bpf_convert_filter(insns, len, fp, &new_len);
+	if (err) {
+		__bpf_prog_free(fp);
+		return ERR_PTR(err);
+	}
+
+	fp = bpf_prog_select_runtime(fp, &err);
+	if (err) {
+		bpf_prog_free(fp);
+		return ERR_PTR(err);
+	}
+
+	return fp;
+}
+EXPORT_SYMBOL_GPL(bpf_migrate_filter);
+
 /**
  * 	sk_filter_release_rcu - Release a socket filter by rcu_head
  *	@rcu: rcu_head that contains the sk_filter to free
@@ -646,23 +1205,63 @@ EXPORT_SYMBOL(sk_chk_filter);
 void sk_filter_release_rcu(struct rcu_head *rcu)
 {
 	struct sk_filter *fp = container_of(rcu, struct sk_filter, rcu);
-
-	bpf_jit_free(fp);
-	kfree(fp);
+	struct sk_filter_ext *ext = container_of(fp, struct sk_filter_ext,
+						 filter);
+
+	if (ext->prog)
+		bpf_prog_free(ext->prog);
+	else
+		bpf_jit_free(fp);
+	kfree(ext);
 }
 EXPORT_SYMBOL(sk_filter_release_rcu);
 
+/**
+ *	sk_run_filter_prog - run a filter migrated to eBPF
+ *	@skb: buffer to run the filter on
+ *	@filter: instructions of the filter, within its struct sk_filter
+ *
+ * bpf_func of migrated filters, for callers that invoke it directly
+ * rather than through SK_RUN_FILTER().
+ */
+unsigned int sk_run_filter_prog(const struct sk_buff *skb,
+				const struct sock_filter *filter)
+{
+	const struct sk_filter *fp = container_of(filter, struct sk_filter,
+						  insns[0]);
+
+	return BPF_PROG_RUN(sk_filter_prog(fp), skb);
+}
+EXPORT_SYMBOL(sk_run_filter_prog);
+
 static int __sk_prepare_filter(struct sk_filter *fp)
 {
+	struct sk_filter_ext *ext = container_of(fp, struct sk_filter_ext,
+						 filter);
+	struct bpf_prog *prog;
 	int err;
 
 	fp->bpf_func = sk_run_filter;
+	ext->prog = NULL;
 
 	err = sk_chk_filter(fp->insns, fp->len);
 	if (err)
 		return err;
 
+	/* Probe if the arch still has a classic JIT for the filter. */
 	bpf_jit_compile(fp);
+	if (fp->bpf_func != sk_run_filter)
+		return 0;
+
+	/* Otherwise move it over to eBPF, so that it is handled by the
+	 * eBPF JIT. If that fails, the classic interpreter is used.
+	 */
+	prog = bpf_migrate_filter(fp->insns, fp->len);
+	if (!IS_ERR(prog)) {
+		ext->prog = prog;
+		fp->bpf_func = sk_run_filter_prog;
+	}
+
 	return 0;
 }
 
@@ -679,6 +1278,7 @@ static int __sk_prepare_filter(struct sk_filter *fp)
 int sk_unattached_filter_create(struct sk_filter **pfp,
 				struct sock_fprog *fprog)
 {
+	struct sk_filter_ext *ext;
 	struct sk_filter *fp;
 	unsigned int fsize = sizeof(struct sock_filter) * fprog->len;
 	int err;
@@ -687,9 +1287,10 @@ int sk_unattached_filter_create(struct sk_filter **pfp,
 	if (fprog->filter == NULL)
 		return -EINVAL;
 
-	fp = kmalloc(fsize + sizeof(*fp), GFP_KERNEL);
-	if (!fp)
+	ext = kmalloc(fsize + sizeof(*ext), GFP_KERNEL);
+	if (!ext)
 		return -ENOMEM;
+	fp = &ext->filter;
 	memcpy(fp->insns, fprog->filter, fsize);
 
 	atomic_set(&fp->refcnt, 1);
@@ -702,7 +1303,7 @@ int sk_unattached_filter_create(struct sk_filter **pfp,
 	*pfp = fp;
 	return 0;
 free_mem:
-	kfree(fp);
+	kfree(ext);
 	return err;
 }
 EXPORT_SYMBOL_GPL(sk_unattached_filter_create);
@@ -725,6 +1326,7 @@ EXPORT_SYMBOL_GPL(sk_unattached_filter_destroy);
  */
 int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 {
+	struct sk_filter_ext *ext;
 	struct sk_filter *fp, *old_fp;
 	unsigned int fsize = sizeof(struct sock_filter) * fprog->len;
 	int err;
@@ -736,11 +1338,12 @@ int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 	if (fprog->filter == NULL)
 		return -EINVAL;
 
-	fp = sock_kmalloc(sk, fsize+sizeof(*fp), GFP_KERNEL);
-	if (!fp)
+	ext = sock_kmalloc(sk, fsize+sizeof(*ext), GFP_KERNEL);
+	if (!ext)
 		return -ENOMEM;
+	fp = &ext->filter;
 	if (copy_from_user(fp->insns, fprog->filter, fsize)) {
-		sock_kfree_s(sk, fp, fsize+sizeof(*fp));
+		sock_kfree_s(sk, ext, fsize+sizeof(*ext));
 		return -EFAULT;
 	}
 
@@ -893,6 +1496,19 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_BPF_JIT
+/* Classic JITs are only left on archs without an eBPF JIT, everyone
+ * else gets classic filters migrated to eBPF in __sk_prepare_filter().
+ */
+void __weak bpf_jit_compile(struct sk_filter *fp)
+{
+}
+
+void __weak bpf_jit_free(struct sk_filter *fp)
+{
+}
+#endif
+
 int xdp_do_redirect(struct net_device *dev, struct xdp_buff *xdp,
 		   struct bpf_prog *prog)
 {
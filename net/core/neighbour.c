@@ -118,6 +118,44 @@ unsigned long neigh_rand_reach_time(unsigned long base)
 EXPORT_SYMBOL(neigh_rand_reach_time);
 
 
+static void neigh_mark_dead(struct neighbour *n)
+{
+	n->dead = 1;
+	if (!list_empty(&n->gc_list)) {
+		list_del_init(&n->gc_list);
+		atomic_dec(&n->tbl->gc_entries);
+	}
+}
+
+static void neigh_update_gc_list(struct neighbour *n)
+{
+	bool on_gc_list, exempt_from_gc;
+
+	write_lock_bh(&n->tbl->lock);
+	write_lock(&n->lock);
+
+	if (n->dead)
+		goto out;
+
+	/* remove from the gc list if new state is permanent;
+	 * otherwise entry should be on the gc list
+	 */
+	exempt_from_gc = n->nud_state & NUD_PERMANENT;
+	on_gc_list = !list_empty(&n->gc_list);
+
+	if (exempt_from_gc && on_gc_list) {
+		list_del_init(&n->gc_list);
+		atomic_dec(&n->tbl->gc_entries);
+	} else if (!exempt_from_gc && !on_gc_list) {
+		/* add entries to the tail; cleaning removes from the front */
+		list_add_tail(&n->gc_list, &n->tbl->gc_list);
+		atomic_inc(&n->tbl->gc_entries);
+	}
+out:
+	write_unlock(&n->lock);
+	write_unlock_bh(&n->tbl->lock);
+}
+
 static bool neigh_del(struct neighbour *n, __u8 state,
 		      struct neighbour __rcu **np, struct neigh_table *tbl)
 {
@@ -130,7 +168,7 @@ static bool neigh_del(struct neighbour *n, __u8 state,
 		neigh = rcu_dereference_protected(n->next,
 						  lockdep_is_held(&tbl->lock));
 		rcu_assign_pointer(*np, neigh);
-		n->dead = 1;
+		neigh_mark_dead(n);
 		retval = true;
 	}
 	write_unlock(&n->lock);
@@ -162,38 +200,48 @@ bool neigh_remove_one(struct neighbour *ndel, struct neigh_table *tbl)
 	return false;
 }
 
+/* Forced gc walks only the entries that may be collected, oldest first,
+ * and stops as soon as the table is back under gc_thresh2 or its time
+ * budget is spent, so the table lock is never held for a full scan.
+ */
 static int neigh_forced_gc(struct neigh_table *tbl)
 {
+	int max_clean = atomic_read(&tbl->gc_entries) - tbl->gc_thresh2;
+	unsigned long tref = jiffies - 5 * HZ;
+	u64 tmax = ktime_to_ns(ktime_get()) + NSEC_PER_MSEC;
+	struct neighbour *n, *tmp;
 	int shrunk = 0;
-	int i;
-	struct neigh_hash_table *nht;
+	int loop = 0;
 
 	NEIGH_CACHE_STAT_INC(tbl, forced_gc_runs);
 
 	write_lock_bh(&tbl->lock);
-	nht = rcu_dereference_protected(tbl->nht,
-					lockdep_is_held(&tbl->lock));
-	for (i = 0; i < (1 << nht->hash_shift); i++) {
-		struct neighbour *n;
-		struct neighbour __rcu **np;
 
-		np = &nht->hash_buckets[i];
-		while ((n = rcu_dereference_protected(*np,
-					lockdep_is_held(&tbl->lock))) != NULL) {
-			/* Neighbour record may be discarded if:
-			 * - nobody refers to it.
-			 * - it is not permanent
-			 */
-			if (neigh_del(n, NUD_PERMANENT, np, tbl)) {
-				shrunk = 1;
-				continue;
+	list_for_each_entry_safe(n, tmp, &tbl->gc_list, gc_list) {
+		if (atomic_read(&n->refcnt) == 1) {
+			bool remove = false;
+
+			write_lock(&n->lock);
+			if ((n->nud_state == NUD_FAILED) ||
+			    (n->nud_state == NUD_NOARP) ||
+			    !time_in_range(n->updated, tref, jiffies))
+				remove = true;
+			write_unlock(&n->lock);
+
+			if (remove && neigh_remove_one(n, tbl))
+				shrunk++;
+			if (shrunk >= max_clean)
+				break;
+			if (++loop == 16) {
+				if (ktime_to_ns(ktime_get()) > tmax)
+					goto unlock;
+				loop = 0;
 			}
-			np = &n->next;
 		}
 	}
 
 	tbl->last_flush = jiffies;
-
+unlock:
 	write_unlock_bh(&tbl->lock);
 
 	return shrunk;
@@ -252,7 +300,7 @@ static void neigh_flush_dev(struct neigh_table *tbl, struct net_device *dev)
 						lockdep_is_held(&tbl->lock)));
 			write_lock(&n->lock);
 			neigh_del_timer(n);
-			n->dead = 1;
+			neigh_mark_dead(n);
 
 			if (atomic_read(&n->refcnt) != 1) {
 				/* The most unpleasant situation.
@@ -300,13 +348,19 @@ int neigh_ifdown(struct neigh_table *tbl, struct net_device *dev)
 }
 EXPORT_SYMBOL(neigh_ifdown);
 
-static struct neighbour *neigh_alloc(struct neigh_table *tbl, struct net_device *dev)
+static struct neighbour *neigh_alloc(struct neigh_table *tbl,
+				     struct net_device *dev,
+				     bool exempt_from_gc)
 {
 	struct neighbour *n = NULL;
 	unsigned long now = jiffies;
 	int entries;
 
-	entries = atomic_inc_return(&tbl->entries) - 1;
+	/* permanent entries don't count against the gc thresholds */
+	if (exempt_from_gc)
+		goto do_alloc;
+
+	entries = atomic_inc_return(&tbl->gc_entries) - 1;
 	if (entries >= tbl->gc_thresh3 ||
 	    (entries >= tbl->gc_thresh2 &&
 	     time_after(now, tbl->last_flush + 5 * HZ))) {
@@ -315,6 +369,7 @@ static struct neighbour *neigh_alloc(struct neigh_table *tbl, struct net_device
 			goto out_entries;
 	}
 
+do_alloc:
 	n = kzalloc(tbl->entry_size + dev->neigh_priv_len, GFP_ATOMIC);
 	if (!n)
 		goto out_entries;
@@ -333,11 +388,15 @@ static struct neighbour *neigh_alloc(struct neigh_table *tbl, struct net_device
 	n->tbl		  = tbl;
 	atomic_set(&n->refcnt, 1);
 	n->dead		  = 1;
+	INIT_LIST_HEAD(&n->gc_list);
+
+	atomic_inc(&tbl->entries);
 out:
 	return n;
 
 out_entries:
-	atomic_dec(&tbl->entries);
+	if (!exempt_from_gc)
+		atomic_dec(&tbl->gc_entries);
 	goto out;
 }
 
@@ -347,21 +406,22 @@ static void neigh_get_hash_rnd(u32 *x)
 	*x |= 1;
 }
 
-static struct neigh_hash_table *neigh_hash_alloc(unsigned int shift)
+static struct neigh_hash_table *neigh_hash_alloc(unsigned int shift,
+						 gfp_t gfp)
 {
 	size_t size = (1 << shift) * sizeof(struct neighbour *);
 	struct neigh_hash_table *ret;
 	struct neighbour __rcu **buckets;
 	int i;
 
-	ret = kmalloc(sizeof(*ret), GFP_ATOMIC);
+	ret = kmalloc(sizeof(*ret), gfp);
 	if (!ret)
 		return NULL;
 	if (size <= PAGE_SIZE)
-		buckets = kzalloc(size, GFP_ATOMIC);
+		buckets = kzalloc(size, gfp);
 	else
 		buckets = (struct neighbour __rcu **)
-			  __get_free_pages(GFP_ATOMIC | __GFP_ZERO,
+			  __get_free_pages(gfp | __GFP_ZERO,
 					   get_order(size));
 	if (!buckets) {
 		kfree(ret);
@@ -374,11 +434,8 @@ static struct neigh_hash_table *neigh_hash_alloc(unsigned int shift)
 	return ret;
 }
 
-static void neigh_hash_free_rcu(struct rcu_head *head)
+static void neigh_hash_free(struct neigh_hash_table *nht)
 {
-	struct neigh_hash_table *nht = container_of(head,
-						    struct neigh_hash_table,
-						    rcu);
 	size_t size = (1 << nht->hash_shift) * sizeof(struct neighbour *);
 	struct neighbour __rcu **buckets = nht->hash_buckets;
 
@@ -389,19 +446,22 @@ static void neigh_hash_free_rcu(struct rcu_head *head)
 	kfree(nht);
 }
 
-static struct neigh_hash_table *neigh_hash_grow(struct neigh_table *tbl,
-						unsigned long new_shift)
+static void neigh_hash_free_rcu(struct rcu_head *head)
+{
+	neigh_hash_free(container_of(head, struct neigh_hash_table, rcu));
+}
+
+/* Move every entry to @new_nht and publish it, called with tbl->lock held */
+static void neigh_hash_move(struct neigh_table *tbl,
+			    struct neigh_hash_table *new_nht)
 {
 	unsigned int i, hash;
-	struct neigh_hash_table *new_nht, *old_nht;
+	struct neigh_hash_table *old_nht;
 
 	NEIGH_CACHE_STAT_INC(tbl, hash_grows);
 
 	old_nht = rcu_dereference_protected(tbl->nht,
 					    lockdep_is_held(&tbl->lock));
-	new_nht = neigh_hash_alloc(new_shift);
-	if (!new_nht)
-		return old_nht;
 
 	for (i = 0; i < (1 << old_nht->hash_shift); i++) {
 		struct neighbour *n, *next;
@@ -427,7 +487,42 @@ static struct neigh_hash_table *neigh_hash_grow(struct neigh_table *tbl,
 
 	rcu_assign_pointer(tbl->nht, new_nht);
 	call_rcu(&old_nht->rcu, neigh_hash_free_rcu);
-	return new_nht;
+}
+
+/* Growing the hash table is deferred to process context: the new bucket
+ * array is allocated without the table lock and with GFP_KERNEL, and
+ * __neigh_create() keeps inserting into the current, slightly overloaded
+ * table meanwhile.  Lookups are RCU and never wait for it.
+ */
+static void neigh_hash_grow_work(struct work_struct *work)
+{
+	struct neigh_table *tbl = container_of(work, struct neigh_table,
+					       hash_grow_work);
+	struct neigh_hash_table *nht, *new_nht;
+	unsigned int shift;
+
+	rcu_read_lock_bh();
+	shift = rcu_dereference_bh(tbl->nht)->hash_shift;
+	rcu_read_unlock_bh();
+
+	if (atomic_read(&tbl->entries) <= (1 << shift))
+		return;
+
+	new_nht = neigh_hash_alloc(shift + 1, GFP_KERNEL);
+	if (!new_nht)
+		return;
+
+	write_lock_bh(&tbl->lock);
+	nht = rcu_dereference_protected(tbl->nht,
+					lockdep_is_held(&tbl->lock));
+	if (nht->hash_shift == shift) {
+		neigh_hash_move(tbl, new_nht);
+		new_nht = NULL;
+	}
+	write_unlock_bh(&tbl->lock);
+
+	if (new_nht)
+		neigh_hash_free(new_nht);
 }
 
 struct neighbour *neigh_lookup(struct neigh_table *tbl, const void *pkey,
@@ -491,13 +586,15 @@ struct neighbour *neigh_lookup_nodev(struct neigh_table *tbl, struct net *net,
 }
 EXPORT_SYMBOL(neigh_lookup_nodev);
 
-struct neighbour *__neigh_create(struct neigh_table *tbl, const void *pkey,
-				 struct net_device *dev, bool want_ref)
+static struct neighbour *___neigh_create(struct neigh_table *tbl,
+					 const void *pkey,
+					 struct net_device *dev,
+					 bool exempt_from_gc, bool want_ref)
 {
 	u32 hash_val;
 	int key_len = tbl->key_len;
 	int error;
-	struct neighbour *n1, *rc, *n = neigh_alloc(tbl, dev);
+	struct neighbour *n1, *rc, *n = neigh_alloc(tbl, dev, exempt_from_gc);
 	struct neigh_hash_table *nht;
 
 	if (!n) {
@@ -542,7 +639,7 @@ struct neighbour *__neigh_create(struct neigh_table *tbl, const void *pkey,
 					lockdep_is_held(&tbl->lock));
 
 	if (atomic_read(&tbl->entries) > (1 << nht->hash_shift))
-		nht = neigh_hash_grow(tbl, nht->hash_shift + 1);
+		schedule_work(&tbl->hash_grow_work);
 
 	hash_val = tbl->hash(pkey, dev, nht->hash_rnd) >> (32 - nht->hash_shift);
 
@@ -565,6 +662,8 @@ struct neighbour *__neigh_create(struct neigh_table *tbl, const void *pkey,
 	}
 
 	n->dead = 0;
+	if (!exempt_from_gc)
+		list_add_tail(&n->gc_list, &n->tbl->gc_list);
 	if (want_ref)
 		neigh_hold(n);
 	rcu_assign_pointer(n->next,
@@ -579,9 +678,17 @@ out:
 out_tbl_unlock:
 	write_unlock_bh(&tbl->lock);
 out_neigh_release:
+	if (!exempt_from_gc)
+		atomic_dec(&tbl->gc_entries);
 	neigh_release(n);
 	goto out;
 }
+
+struct neighbour *__neigh_create(struct neigh_table *tbl, const void *pkey,
+				 struct net_device *dev, bool want_ref)
+{
+	return ___neigh_create(tbl, pkey, dev, false, want_ref);
+}
 EXPORT_SYMBOL(__neigh_create);
 
 static u32 pneigh_hash(const void *pkey, int key_len)
@@ -801,7 +908,7 @@ static void neigh_periodic_work(struct work_struct *work)
 	nht = rcu_dereference_protected(tbl->nht,
 					lockdep_is_held(&tbl->lock));
 
-	if (atomic_read(&tbl->entries) < tbl->gc_thresh1)
+	if (atomic_read(&tbl->gc_entries) < tbl->gc_thresh1)
 		goto out;
 
 	/*
@@ -838,7 +945,7 @@ static void neigh_periodic_work(struct work_struct *work)
 			    (state == NUD_FAILED ||
 			     time_after(jiffies, n->used + NEIGH_VAR(n->parms, GC_STALETIME)))) {
 				*np = n->next;
-				n->dead = 1;
+				neigh_mark_dead(n);
 				write_unlock(&n->lock);
 				neigh_cleanup_and_release(n);
 				continue;
@@ -1130,6 +1237,7 @@ int neigh_update(struct neighbour *neigh, const u8 *lladdr, u8 new,
 	int notify = 0;
 	struct net_device *dev;
 	int update_isrouter = 0;
+	bool gc_update;
 
 	write_lock_bh(&neigh->lock);
 
@@ -1283,8 +1391,12 @@ out:
 			(neigh->flags | NTF_ROUTER) :
 			(neigh->flags & ~NTF_ROUTER);
 	}
+	gc_update = (old ^ neigh->nud_state) & NUD_PERMANENT;
 	write_unlock_bh(&neigh->lock);
 
+	if (gc_update)
+		neigh_update_gc_list(neigh);
+
 	if (notify)
 		neigh_update_notify(neigh, nlmsg_pid);
 
@@ -1604,7 +1716,7 @@ void neigh_table_init(int index, struct neigh_table *tbl)
 		panic("cannot create neighbour proc dir entry");
 #endif
 
-	RCU_INIT_POINTER(tbl->nht, neigh_hash_alloc(3));
+	RCU_INIT_POINTER(tbl->nht, neigh_hash_alloc(3, GFP_KERNEL));
 
 	phsize = (PNEIGH_HASHMASK + 1) * sizeof(struct pneigh_entry *);
 	tbl->phash_buckets = kzalloc(phsize, GFP_KERNEL);
@@ -1619,6 +1731,8 @@ void neigh_table_init(int index, struct neigh_table *tbl)
 		WARN_ON(tbl->entry_size % NEIGH_PRIV_ALIGN);
 
 	rwlock_init(&tbl->lock);
+	INIT_LIST_HEAD(&tbl->gc_list);
+	INIT_WORK(&tbl->hash_grow_work, neigh_hash_grow_work);
 	INIT_DEFERRABLE_WORK(&tbl->gc_work, neigh_periodic_work);
 	schedule_delayed_work(&tbl->gc_work, tbl->parms.reachable_time);
 	setup_timer(&tbl->proxy_timer, neigh_proxy_process, (unsigned long)tbl);
@@ -1637,6 +1751,7 @@ int neigh_table_clear(int index, struct neigh_table *tbl)
 	neigh_tables[index] = NULL;
 	/* It is not clean... Fix it to unload IPv6 module safely */
 	cancel_delayed_work_sync(&tbl->gc_work);
+	cancel_work_sync(&tbl->hash_grow_work);
 	del_timer_sync(&tbl->proxy_timer);
 	pneigh_queue_purge(&tbl->proxy_queue);
 	neigh_ifdown(tbl, NULL);
@@ -1803,7 +1918,8 @@ static int neigh_add(struct sk_buff *skb, struct nlmsghdr *nlh)
 			goto out;
 		}
 
-		neigh = __neigh_lookup_errno(tbl, dst, dev);
+		neigh = ___neigh_create(tbl, dst, dev,
+					ndm->ndm_state & NUD_PERMANENT, true);
 		if (IS_ERR(neigh)) {
 			err = PTR_ERR(neigh);
 			goto out;
@@ -2472,7 +2588,7 @@ void __neigh_for_each_release(struct neigh_table *tbl,
 				rcu_assign_pointer(*np,
 					rcu_dereference_protected(n->next,
 						lockdep_is_held(&tbl->lock)));
-				n->dead = 1;
+				neigh_mark_dead(n);
 			} else
 				np = &n->next;
 			write_unlock(&n->lock);
@@ -904,6 +904,13 @@ set_rcvbuf:
 	case SO_RCVLOWAT:
 		if (val < 0)
 			val = INT_MAX;
+#ifdef CONFIG_INET
+		if (sk->sk_protocol == IPPROTO_TCP &&
+		    sk->sk_type == SOCK_STREAM) {
+			ret = tcp_set_rcvlowat(sk, val);
+			break;
+		}
+#endif
 		sk->sk_rcvlowat = val ? : 1;
 		break;
 
@@ -1350,6 +1357,7 @@ static struct sock *sk_prot_alloc(struct proto *prot, gfp_t priority,
 		if (!try_module_get(prot->owner))
 			goto out_free_sec;
 		sk_tx_queue_clear(sk);
+		sk_rx_queue_clear(sk);
 	}
 
 	return sk;
@@ -2041,6 +2041,14 @@ static int devinet_conf_proc(struct ctl_table *ctl, int write,
 		    i == IPV4_DEVCONF_ROUTE_LOCALNET - 1)
 			if ((new_value == 0) && (old_value != 0))
 				rt_cache_flush(net);
+		/* the per-cpu forwarding cache skips fib_validate_source()
+		 * and the redirect decision, drop it when their inputs change
+		 */
+		if ((i == IPV4_DEVCONF_RP_FILTER - 1 ||
+		     i == IPV4_DEVCONF_SRC_VMARK - 1 ||
+		     i == IPV4_DEVCONF_SEND_REDIRECTS - 1) &&
+		    new_value != old_value)
+			rt_cache_flush(net);
 		if (i == IPV4_DEVCONF_RP_FILTER - 1 &&
 		    new_value != old_value) {
 			int ifindex;
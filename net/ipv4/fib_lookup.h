@@ -41,6 +41,12 @@ extern void rtmsg_fib(int event, __be32 key, struct fib_alias *fa,
 extern int fib_detect_death(struct fib_info *fi, int order,
 			    struct fib_info **last_resort,
 			    int *last_idx, int dflt);
+extern int fib_nh_init(struct net *net, struct fib_nh *nh,
+		       struct fib_config *cfg);
+extern void fib_nh_release(struct fib_nh *nh);
+
+/* Exported by fib_frontend.c */
+extern void fib_flush(struct net *net);
 
 static inline void fib_result_assign(struct fib_result *res,
 				     struct fib_info *fi)
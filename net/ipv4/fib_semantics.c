@@ -200,6 +200,17 @@ static void rt_fibinfo_free_cpus(struct rtable __rcu * __percpu *rtp)
 	free_percpu(rtp);
 }
 
+/* Drop everything a nexthop holds: device, encap state and cached routes */
+void fib_nh_release(struct fib_nh *nh)
+{
+	if (nh->nh_dev)
+		dev_put(nh->nh_dev);
+	lwtstate_put(nh->nh_lwtstate);
+	free_nh_exceptions(nh);
+	rt_fibinfo_free_cpus(nh->nh_pcpu_rth_output);
+	rt_fibinfo_free(&nh->nh_rth_input);
+}
+
 /* Release a nexthop info record */
 static void free_fib_info_rcu(struct rcu_head *head)
 {
@@ -207,14 +218,12 @@ static void free_fib_info_rcu(struct rcu_head *head)
 	struct dst_metrics *m;
 
 	change_nexthops(fi) {
-		if (nexthop_nh->nh_dev)
-			dev_put(nexthop_nh->nh_dev);
-		lwtstate_put(nexthop_nh->nh_lwtstate);
-		free_nh_exceptions(nexthop_nh);
-		rt_fibinfo_free_cpus(nexthop_nh->nh_pcpu_rth_output);
-		rt_fibinfo_free(&nexthop_nh->nh_rth_input);
+		fib_nh_release(nexthop_nh);
 	} endfor_nexthops(fi);
 
+	if (fi->nh)
+		nexthop_put(fi->nh);
+
 	m = fi->fib_metrics;
 	if (m != &dst_default_metrics && atomic_dec_and_test(&m->refcnt))
 		kfree(m);
@@ -234,6 +243,8 @@ void free_fib_info(struct fib_info *fi)
 			fi->fib_net->ipv4.fib_num_tclassid_users--;
 	} endfor_nexthops(fi);
 #endif
+	/* the forwarding cache may still point at our nh_rth_input */
+	ip_fwd_cache_flush();
 	call_rcu(&fi->rcu, free_fib_info_rcu);
 }
 EXPORT_SYMBOL_GPL(free_fib_info);
@@ -245,6 +256,8 @@ void fib_release_info(struct fib_info *fi)
 		hlist_del(&fi->fib_hash);
 		if (fi->fib_prefsrc)
 			hlist_del(&fi->fib_lhash);
+		if (fi->nh)
+			list_del(&fi->nh_list);
 		change_nexthops(fi) {
 			if (!nexthop_nh->nh_dev)
 				continue;
@@ -295,6 +308,8 @@ static inline unsigned int fib_info_hashfn(const struct fib_info *fi)
 	val ^= (fi->fib_protocol << 8) | fi->fib_scope;
 	val ^= (__force u32)fi->fib_prefsrc;
 	val ^= fi->fib_priority;
+	if (fi->nh)
+		val ^= fi->nh->id;
 	for_nexthops(fi) {
 		val ^= fib_devindex_hashfn(nh->nh_oif);
 	} endfor_nexthops(fi)
@@ -314,7 +329,7 @@ static struct fib_info *fib_find_info(const struct fib_info *nfi)
 	hlist_for_each_entry(fi, head, fib_hash) {
 		if (!net_eq(fi->fib_net, nfi->fib_net))
 			continue;
-		if (fi->fib_nhs != nfi->fib_nhs)
+		if (fi->fib_nhs != nfi->fib_nhs || fi->nh != nfi->nh)
 			continue;
 		if (nfi->fib_protocol == fi->fib_protocol &&
 		    nfi->fib_scope == fi->fib_scope &&
@@ -370,6 +385,9 @@ static inline size_t fib_nlmsg_size(struct fib_info *fi)
 	/* space for nested metrics */
 	payload += nla_total_size((RTAX_MAX * nla_total_size(4)));
 
+	if (fi->nh)
+		payload += nla_total_size(4); /* RTA_NH_ID */
+
 	if (fi->fib_nhs) {
 		size_t nh_encapsize = 0;
 		/* Also handles the special case fib_nhs == 1 */
@@ -432,10 +450,11 @@ errout:
 int fib_detect_death(struct fib_info *fi, int order,
 		     struct fib_info **last_resort, int *last_idx, int dflt)
 {
+	const struct fib_nh *nh = fib_info_nh(fi, 0);
 	struct neighbour *n;
 	int state = NUD_NONE;
 
-	n = neigh_lookup(&arp_tbl, &fi->fib_nh[0].nh_gw, fi->fib_dev);
+	n = neigh_lookup(&arp_tbl, &nh->nh_gw, nh->nh_dev);
 	if (n) {
 		state = n->nud_state;
 		neigh_release(n);
@@ -613,6 +632,19 @@ int fib_nh_match(struct fib_config *cfg, struct fib_info *fi)
 	if (cfg->fc_priority && cfg->fc_priority != fi->fib_priority)
 		return 1;
 
+	if (cfg->fc_nh_id) {
+		if (fi->nh && cfg->fc_nh_id == fi->nh->id)
+			return 0;
+		return 1;
+	}
+
+	/* routes using a nexthop object can only be matched by its id */
+	if (fi->nh) {
+		if (cfg->fc_oif || cfg->fc_gw || cfg->fc_mp)
+			return 1;
+		return 0;
+	}
+
 	if (cfg->fc_oif || cfg->fc_gw) {
 		if (cfg->fc_encap) {
 			if (fib_encap_match(net, cfg->fc_encap_type,
@@ -915,9 +947,13 @@ static void fib_info_hash_move(struct hlist_head *new_info_hash,
 
 __be32 fib_info_update_nh_saddr(struct net *net, struct fib_nh *nh)
 {
-	nh->nh_saddr = inet_select_addr(nh->nh_dev,
-					nh->nh_gw,
-					nh->nh_parent->fib_scope);
+	unsigned char scope = RT_SCOPE_UNIVERSE;
+
+	/* nexthop objects are not owned by a single fib_info */
+	if (nh->nh_parent)
+		scope = nh->nh_parent->fib_scope;
+
+	nh->nh_saddr = inet_select_addr(nh->nh_dev, nh->nh_gw, scope);
 	nh->nh_saddr_genid = atomic_read(&net->ipv4.dev_addr_genid);
 
 	return nh->nh_saddr;
@@ -969,11 +1005,38 @@ fib_convert_metrics(struct fib_info *fi, const struct fib_config *cfg)
 	return 0;
 }
 
+/* Set up a nexthop that is not embedded in a fib_info, i.e. the one
+ * backing a nexthop object.
+ */
+int fib_nh_init(struct net *net, struct fib_nh *nh, struct fib_config *cfg)
+{
+	int err;
+
+	nh->nh_pcpu_rth_output = alloc_percpu(struct rtable __rcu *);
+	if (!nh->nh_pcpu_rth_output)
+		return -ENOMEM;
+
+	nh->nh_oif = cfg->fc_oif;
+	nh->nh_gw = cfg->fc_gw;
+	nh->nh_flags = cfg->fc_flags;
+#ifdef CONFIG_IP_ROUTE_MULTIPATH
+	nh->nh_weight = 1;
+#endif
+
+	err = fib_check_nh(cfg, NULL, nh);
+	if (err)
+		return err;
+
+	fib_info_update_nh_saddr(net, nh);
+	return 0;
+}
+
 struct fib_info *fib_create_info(struct fib_config *cfg)
 {
 	int err;
 	struct fib_info *fi = NULL;
 	struct fib_info *ofi;
+	struct nexthop *nh = NULL;
 	int nhs = 1;
 	struct net *net = cfg->fc_nlinfo.nl_net;
 
@@ -984,6 +1047,17 @@ struct fib_info *fib_create_info(struct fib_config *cfg)
 	if (fib_props[cfg->fc_type].scope > cfg->fc_scope)
 		goto err_inval;
 
+	if (cfg->fc_nh_id) {
+		/* the nexthop object replaces the inline nexthop spec */
+		if (cfg->fc_oif || cfg->fc_gw || cfg->fc_mp || cfg->fc_encap)
+			goto err_inval;
+
+		nh = nexthop_find_by_id(net, cfg->fc_nh_id);
+		if (!nh)
+			goto err_inval;
+		nhs = 0;
+	}
+
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
 	if (cfg->fc_mp) {
 		nhs = fib_count_nexthops(cfg->fc_mp, cfg->fc_mp_len);
@@ -1035,6 +1109,11 @@ struct fib_info *fib_create_info(struct fib_config *cfg)
 	fi->fib_priority = cfg->fc_priority;
 	fi->fib_prefsrc = cfg->fc_prefsrc;
 	fi->fib_type = cfg->fc_type;
+	INIT_LIST_HEAD(&fi->nh_list);
+	if (nh) {
+		nexthop_get(nh);
+		fi->nh = nh;
+	}
 
 	fi->fib_nhs = nhs;
 	change_nexthops(fi) {
@@ -1064,7 +1143,7 @@ struct fib_info *fib_create_info(struct fib_config *cfg)
 #else
 		goto err_inval;
 #endif
-	} else {
+	} else if (!fi->nh) {
 		struct fib_nh *nh = fi->fib_nh;
 
 		if (cfg->fc_encap) {
@@ -1097,7 +1176,7 @@ struct fib_info *fib_create_info(struct fib_config *cfg)
 	}
 
 	if (fib_props[cfg->fc_type].error) {
-		if (cfg->fc_gw || cfg->fc_oif || cfg->fc_mp)
+		if (cfg->fc_gw || cfg->fc_oif || cfg->fc_mp || fi->nh)
 			goto err_inval;
 		goto link_it;
 	} else {
@@ -1116,7 +1195,11 @@ struct fib_info *fib_create_info(struct fib_config *cfg)
 	if (cfg->fc_scope > RT_SCOPE_HOST)
 		goto err_inval;
 
-	if (cfg->fc_scope == RT_SCOPE_HOST) {
+	if (fi->nh) {
+		err = fib_check_nexthop(fi->nh, cfg->fc_scope);
+		if (err != 0)
+			goto failure;
+	} else if (cfg->fc_scope == RT_SCOPE_HOST) {
 		struct fib_nh *nh = fi->fib_nh;
 
 		/* Local address is added. */
@@ -1169,6 +1252,8 @@ link_it:
 		head = &fib_info_laddrhash[fib_laddr_hashfn(fi->fib_prefsrc)];
 		hlist_add_head(&fi->fib_lhash, head);
 	}
+	if (fi->nh)
+		list_add(&fi->nh_list, &fi->nh->fi_list);
 	change_nexthops(fi) {
 		struct hlist_head *head;
 		unsigned int hash;
@@ -1233,6 +1318,9 @@ int fib_dump_info(struct sk_buff *skb, u32 portid, u32 seq, int event,
 	if (fi->fib_prefsrc &&
 	    nla_put_in_addr(skb, RTA_PREFSRC, fi->fib_prefsrc))
 		goto nla_put_failure;
+	if (fi->nh &&
+	    nla_put_u32(skb, RTA_NH_ID, fi->nh->id))
+		goto nla_put_failure;
 	if (fi->fib_nhs == 1) {
 		if (fi->fib_nh->nh_gw &&
 		    nla_put_in_addr(skb, RTA_GATEWAY, fi->fib_nh->nh_gw))
@@ -1424,6 +1512,7 @@ void fib_select_default(const struct flowi4 *flp, struct fib_result *res)
 
 	hlist_for_each_entry_rcu(fa, fa_head, fa_list) {
 		struct fib_info *next_fi = fa->fa_info;
+		struct fib_nh *nh;
 
 		if (fa->fa_slen != slen)
 			continue;
@@ -1445,8 +1534,8 @@ void fib_select_default(const struct flowi4 *flp, struct fib_result *res)
 		if (next_fi->fib_scope != res->scope ||
 		    fa->fa_type != RTN_UNICAST)
 			continue;
-		if (!next_fi->fib_nh[0].nh_gw ||
-		    next_fi->fib_nh[0].nh_scope != RT_SCOPE_LINK)
+		nh = fib_info_nh(next_fi, 0);
+		if (!nh->nh_gw || nh->nh_scope != RT_SCOPE_LINK)
 			continue;
 
 		fib_alias_accessed(fa);
@@ -1548,6 +1637,11 @@ void fib_select_multipath(struct fib_result *res, int hash)
 {
 	struct fib_info *fi = res->fi;
 
+	if (fi->nh) {
+		res->nh_sel = nexthop_select_path(fi->nh, hash);
+		return;
+	}
+
 	for_nexthops(fi) {
 		if (hash > atomic_read(&nh->nh_upper_bound))
 			continue;
@@ -1565,7 +1659,7 @@ void fib_select_path(struct net *net, struct fib_result *res,
 		     struct flowi4 *fl4, const struct sk_buff *skb)
 {
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
-	if (res->fi->fib_nhs > 1 && fl4->flowi4_oif == 0) {
+	if (fib_info_num_path(res->fi) > 1 && fl4->flowi4_oif == 0) {
 		int h = fib_multipath_hash(res->fi, fl4, skb);
 
 		fib_select_multipath(res, h);
@@ -80,6 +80,7 @@
 #include <net/tcp.h>
 #include <net/sock.h>
 #include <net/ip_fib.h>
+#include <net/nexthop.h>
 #include <net/fib_notifier.h>
 #include "fib_lookup.h"
 
@@ -1434,8 +1435,15 @@ found:
 		}
 		if (fi->fib_flags & RTNH_F_DEAD)
 			continue;
-		for (nhsel = 0; nhsel < fi->fib_nhs; nhsel++) {
-			const struct fib_nh *nh = &fi->fib_nh[nhsel];
+		if (unlikely(fi->nh && nexthop_is_blackhole(fi->nh))) {
+			err = fib_props[RTN_BLACKHOLE].error;
+#ifdef CONFIG_IP_FIB_TRIE_STATS
+			this_cpu_inc(stats->semantic_match_passed);
+#endif
+			return err;
+		}
+		for (nhsel = 0; nhsel < fib_info_num_path(fi); nhsel++) {
+			const struct fib_nh *nh = fib_info_nh(fi, nhsel);
 
 			if (nh->nh_flags & RTNH_F_DEAD)
 				continue;
@@ -2598,13 +2606,13 @@ static void fib_route_seq_stop(struct seq_file *seq, void *v)
 	rcu_read_unlock();
 }
 
-static unsigned int fib_flag_trans(int type, __be32 mask, const struct fib_info *fi)
+static unsigned int fib_flag_trans(int type, __be32 mask, struct fib_info *fi)
 {
 	unsigned int flags = 0;
 
 	if (type == RTN_UNREACHABLE || type == RTN_PROHIBIT)
 		flags = RTF_REJECT;
-	if (fi && fi->fib_nh->nh_gw)
+	if (fi && fib_info_nh(fi, 0)->nh_gw)
 		flags |= RTF_GATEWAY;
 	if (mask == htonl(0xFFFFFFFF))
 		flags |= RTF_HOST;
@@ -2636,9 +2644,10 @@ static int fib_route_seq_show(struct seq_file *seq, void *v)
 	prefix = htonl(l->key);
 
 	hlist_for_each_entry_rcu(fa, &l->leaf, fa_list) {
-		const struct fib_info *fi = fa->fa_info;
+		struct fib_info *fi = fa->fa_info;
 		__be32 mask = inet_make_mask(KEYLENGTH - fa->fa_slen);
 		unsigned int flags = fib_flag_trans(fa->fa_type, mask, fi);
+		const struct fib_nh *nh;
 		int len;
 
 		if ((fa->fa_type == RTN_BROADCAST) ||
@@ -2648,20 +2657,21 @@ static int fib_route_seq_show(struct seq_file *seq, void *v)
 		if (fa->tb_id != tb->tb_id)
 			continue;
 
-		if (fi)
+		if (fi) {
+			nh = fib_info_nh(fi, 0);
 			seq_printf(seq,
 				 "%s\t%08X\t%08X\t%04X\t%d\t%u\t"
 				 "%d\t%08X\t%d\t%u\t%u%n",
-				 fi->fib_dev ? fi->fib_dev->name : "*",
+				 nh->nh_dev ? nh->nh_dev->name : "*",
 				 prefix,
-				 fi->fib_nh->nh_gw, flags, 0, 0,
+				 nh->nh_gw, flags, 0, 0,
 				 fi->fib_priority,
 				 mask,
 				 (fi->fib_advmss ?
 				  fi->fib_advmss + 40 : 0),
 				 fi->fib_window,
 				 fi->fib_rtt >> 3, &len);
-		else
+		} else
 			seq_printf(seq,
 				 "*\t%08X\t%08X\t%04X\t%d\t%u\t"
 				 "%d\t%08X\t%d\t%u\t%u%n",
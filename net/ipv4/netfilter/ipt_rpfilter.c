@@ -49,8 +49,8 @@ static bool rpfilter_lookup_reverse(struct flowi4 *fl4,
 	}
 	dev_match = false;
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
-	for (ret = 0; ret < res.fi->fib_nhs; ret++) {
-		struct fib_nh *nh = &res.fi->fib_nh[ret];
+	for (ret = 0; ret < fib_info_num_path(res.fi); ret++) {
+		struct fib_nh *nh = fib_info_nh(res.fi, ret);
 
 		if (nh->nh_dev == dev) {
 			dev_match = true;
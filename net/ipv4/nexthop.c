@@ -0,0 +1,1249 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		IPv4 nexthop objects.
+ *
+ *		Nexthops are managed separately from routes through
+ *		RTM_{NEW,DEL,GET}NEXTHOP and routes refer to them by id
+ *		(RTA_NH_ID).  Many routes sharing a nexthop or a multipath
+ *		group means a gateway change or a path failure is a single
+ *		pointer update instead of a walk over every route using it.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/netdevice.h>
+#include <linux/inetdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/nexthop.h>
+
+#include <net/ip.h>
+#include <net/route.h>
+#include <net/sock.h>
+#include <net/ip_fib.h>
+#include <net/nexthop.h>
+#include <net/rtnetlink.h>
+
+#include "fib_lookup.h"
+
+#define NH_DEV_HASHBITS		8
+#define NH_DEV_HASHSIZE		(1U << NH_DEV_HASHBITS)
+
+/* fib_result.nh_sel is 8 bits wide */
+#define NH_GRP_MAX_PATHS	256
+
+#define NEXTHOP_VALID_USER_FLAGS RTNH_F_ONLINK
+
+struct nh_config {
+	u32		nh_id;
+
+	u8		nh_family;
+	u8		nh_protocol;
+	u8		nh_blackhole;
+	u32		nh_flags;
+
+	int		nh_ifindex;
+	__be32		gw;
+
+	struct nlattr	*nh_grp;
+	u16		nh_grp_type;
+
+	u32		nlflags;
+	struct nl_info	nlinfo;
+};
+
+static const struct nla_policy rtm_nh_policy[NHA_MAX + 1] = {
+	[NHA_ID]		= { .type = NLA_U32 },
+	[NHA_GROUP]		= { .type = NLA_BINARY },
+	[NHA_GROUP_TYPE]	= { .type = NLA_U16 },
+	[NHA_BLACKHOLE]		= { .type = NLA_FLAG },
+	[NHA_OIF]		= { .type = NLA_U32 },
+	[NHA_GATEWAY]		= { .type = NLA_U32 },
+	[NHA_ENCAP_TYPE]	= { .type = NLA_U16 },
+	[NHA_ENCAP]		= { .type = NLA_NESTED },
+	[NHA_GROUPS]		= { .type = NLA_FLAG },
+	[NHA_MASTER]		= { .type = NLA_U32 },
+};
+
+static unsigned int nh_dev_hashfn(unsigned int val)
+{
+	unsigned int mask = NH_DEV_HASHSIZE - 1;
+
+	return (val ^
+		(val >> NH_DEV_HASHBITS) ^
+		(val >> (NH_DEV_HASHBITS * 2))) & mask;
+}
+
+static void nexthop_devhash_add(struct net *net, struct nh_info *nhi)
+{
+	struct net_device *dev = nhi->fib_nh.nh_dev;
+	struct hlist_head *head;
+
+	head = &net->nexthop.devhash[nh_dev_hashfn(dev->ifindex)];
+	hlist_add_head(&nhi->dev_hash, head);
+}
+
+static void nh_base_seq_inc(struct net *net)
+{
+	while (++net->nexthop.seq == 0)
+		;
+}
+
+static void nh_info_free(struct nh_info *nhi)
+{
+	fib_nh_release(&nhi->fib_nh);
+	kfree(nhi);
+}
+
+static void nh_group_free(struct nh_group *nhg)
+{
+	int i;
+
+	for (i = 0; i < nhg->num_nh; i++)
+		nexthop_put(nhg->nh_entries[i].nh);
+
+	kfree(nhg->spare);
+	kfree(nhg);
+}
+
+void nexthop_free_rcu(struct rcu_head *head)
+{
+	struct nexthop *nh = container_of(head, struct nexthop, rcu);
+
+	if (nh->is_group)
+		nh_group_free(rcu_dereference_raw(nh->nh_grp));
+	else
+		nh_info_free(rcu_dereference_raw(nh->nh_info));
+	kfree(nh);
+}
+EXPORT_SYMBOL_GPL(nexthop_free_rcu);
+
+static struct nexthop *nexthop_alloc(void)
+{
+	struct nexthop *nh;
+
+	nh = kzalloc(sizeof(*nh), GFP_KERNEL);
+	if (nh) {
+		INIT_LIST_HEAD(&nh->fi_list);
+		INIT_LIST_HEAD(&nh->grp_list);
+		atomic_set(&nh->refcnt, 1);
+	}
+	return nh;
+}
+
+static struct nh_group *nexthop_grp_alloc(u16 num_nh)
+{
+	struct nh_group *nhg;
+
+	nhg = kzalloc(sizeof(*nhg) + num_nh * sizeof(struct nh_grp_entry),
+		      GFP_KERNEL);
+	if (nhg)
+		nhg->num_nh = num_nh;
+
+	return nhg;
+}
+
+/* Must be called with rtnl held. */
+struct nexthop *nexthop_find_by_id(struct net *net, u32 id)
+{
+	struct rb_node *node = net->nexthop.rb_root.rb_node;
+
+	ASSERT_RTNL();
+
+	while (node) {
+		struct nexthop *nh = rb_entry(node, struct nexthop, rb_node);
+
+		if (id < nh->id)
+			node = node->rb_left;
+		else if (id > nh->id)
+			node = node->rb_right;
+		else
+			return nh;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(nexthop_find_by_id);
+
+static u32 nh_find_unused_id(struct net *net)
+{
+	u32 id_start = net->nexthop.last_id_allocated;
+
+	while (1) {
+		net->nexthop.last_id_allocated++;
+		if (net->nexthop.last_id_allocated == id_start)
+			break;
+		if (!net->nexthop.last_id_allocated)
+			continue;
+		if (!nexthop_find_by_id(net, net->nexthop.last_id_allocated))
+			return net->nexthop.last_id_allocated;
+	}
+	return 0;
+}
+
+static bool nexthop_is_dead(struct nexthop *nh)
+{
+	struct nh_info *nhi = rtnl_dereference(nh->nh_info);
+
+	return !!(nhi->fib_nh.nh_flags & RTNH_F_DEAD);
+}
+
+/* Same hash-threshold split as fib_rebalance(), over the group members */
+static void nh_group_rebalance(struct nh_group *nhg)
+{
+	int total = 0;
+	int w = 0;
+	int i;
+
+	for (i = 0; i < nhg->num_nh; i++) {
+		if (!nexthop_is_dead(nhg->nh_entries[i].nh))
+			total += nhg->nh_entries[i].weight;
+	}
+
+	for (i = 0; i < nhg->num_nh; i++) {
+		struct nh_grp_entry *nhge = &nhg->nh_entries[i];
+		int upper_bound;
+
+		if (nexthop_is_dead(nhge->nh)) {
+			upper_bound = -1;
+		} else {
+			w += nhge->weight;
+			upper_bound = DIV_ROUND_CLOSEST_ULL((u64)w << 31,
+							    total) - 1;
+		}
+
+		atomic_set(&nhge->upper_bound, upper_bound);
+	}
+}
+
+static void nh_rebalance_groups(struct nexthop *nh)
+{
+	struct nh_grp_entry *nhge;
+
+	list_for_each_entry(nhge, &nh->grp_list, nh_list)
+		nh_group_rebalance(rtnl_dereference(nhge->nh_parent->nh_grp));
+}
+
+int nexthop_num_path(const struct nexthop *nh)
+{
+	if (nh->is_group) {
+		const struct nh_group *nhg = rcu_dereference_rtnl(nh->nh_grp);
+
+		return nhg->num_nh;
+	}
+	return 1;
+}
+EXPORT_SYMBOL_GPL(nexthop_num_path);
+
+struct fib_nh *nexthop_fib_nh(struct nexthop *nh, int nhsel)
+{
+	struct nh_info *nhi;
+
+	if (nh->is_group) {
+		struct nh_group *nhg = rcu_dereference_rtnl(nh->nh_grp);
+
+		/* the group may have shrunk since nh_sel was chosen */
+		if (unlikely(nhsel >= nhg->num_nh))
+			nhsel = 0;
+		nh = nhg->nh_entries[nhsel].nh;
+	}
+
+	nhi = rcu_dereference_rtnl(nh->nh_info);
+	return &nhi->fib_nh;
+}
+EXPORT_SYMBOL_GPL(nexthop_fib_nh);
+
+int nexthop_select_path(struct nexthop *nh, int hash)
+{
+	struct nh_group *nhg;
+	int i;
+
+	if (!nh->is_group)
+		return 0;
+
+	nhg = rcu_dereference(nh->nh_grp);
+	for (i = 0; i < nhg->num_nh; i++) {
+		if (hash > atomic_read(&nhg->nh_entries[i].upper_bound))
+			continue;
+		return i;
+	}
+
+	/* Race condition: group has just become dead. */
+	return 0;
+}
+
+static int nh_info_check_scope(struct nh_info *nhi, u8 scope)
+{
+	if (nhi->fib_nh.nh_flags & RTNH_F_ONLINK && scope >= RT_SCOPE_LINK)
+		return -EINVAL;
+	return 0;
+}
+
+int fib_check_nexthop(struct nexthop *nh, u8 scope)
+{
+	struct nh_group *nhg;
+	int err = 0;
+	int i;
+
+	if (scope == RT_SCOPE_HOST)
+		return -EINVAL;
+
+	if (!nh->is_group)
+		return nh_info_check_scope(rtnl_dereference(nh->nh_info), scope);
+
+	nhg = rtnl_dereference(nh->nh_grp);
+	for (i = 0; i < nhg->num_nh && !err; i++)
+		err = nh_info_check_scope(
+			rtnl_dereference(nhg->nh_entries[i].nh->nh_info), scope);
+
+	return err;
+}
+
+static size_t nh_nlmsg_size(struct nexthop *nh)
+{
+	size_t sz = NLMSG_ALIGN(sizeof(struct nhmsg))
+		    + nla_total_size(4); /* NHA_ID */
+
+	if (nh->is_group) {
+		struct nh_group *nhg = rtnl_dereference(nh->nh_grp);
+
+		sz += nla_total_size(2) /* NHA_GROUP_TYPE */
+		      + nla_total_size(sizeof(struct nexthop_grp) * nhg->num_nh);
+	} else {
+		sz += nla_total_size(0)	/* NHA_BLACKHOLE */
+		      + nla_total_size(4)	/* NHA_OIF */
+		      + nla_total_size(4);	/* NHA_GATEWAY */
+	}
+
+	return sz;
+}
+
+static int nla_put_nh_group(struct sk_buff *skb, struct nh_group *nhg)
+{
+	struct nexthop_grp *p;
+	struct nlattr *nla;
+	int i;
+
+	if (nla_put_u16(skb, NHA_GROUP_TYPE, NEXTHOP_GRP_TYPE_MPATH))
+		return -EMSGSIZE;
+
+	nla = nla_reserve(skb, NHA_GROUP, nhg->num_nh * sizeof(*p));
+	if (!nla)
+		return -EMSGSIZE;
+
+	p = nla_data(nla);
+	for (i = 0; i < nhg->num_nh; i++, p++) {
+		p->id = nhg->nh_entries[i].nh->id;
+		p->weight = nhg->nh_entries[i].weight - 1;
+		p->resvd1 = 0;
+		p->resvd2 = 0;
+	}
+
+	return 0;
+}
+
+static int nh_fill_node(struct sk_buff *skb, struct nexthop *nh,
+			int event, u32 portid, u32 seq, unsigned int nlflags)
+{
+	struct fib_nh *fib_nh;
+	struct nlmsghdr *nlh;
+	struct nh_info *nhi;
+	struct nhmsg *nhm;
+
+	nlh = nlmsg_put(skb, portid, seq, event, sizeof(*nhm), nlflags);
+	if (!nlh)
+		return -EMSGSIZE;
+
+	nhm = nlmsg_data(nlh);
+	nhm->nh_family = AF_UNSPEC;
+	nhm->nh_flags = nh->nh_flags;
+	nhm->nh_protocol = nh->protocol;
+	nhm->nh_scope = 0;
+	nhm->resvd = 0;
+
+	if (nla_put_u32(skb, NHA_ID, nh->id))
+		goto nla_put_failure;
+
+	if (nh->is_group) {
+		if (nla_put_nh_group(skb, rtnl_dereference(nh->nh_grp)))
+			goto nla_put_failure;
+		goto out;
+	}
+
+	nhi = rtnl_dereference(nh->nh_info);
+	nhm->nh_family = nhi->family;
+	if (nhi->reject_nh) {
+		if (nla_put_flag(skb, NHA_BLACKHOLE))
+			goto nla_put_failure;
+		goto out;
+	}
+
+	fib_nh = &nhi->fib_nh;
+	nhm->nh_scope = fib_nh->nh_scope;
+	nhm->nh_flags = fib_nh->nh_flags & 0xFF;
+	if (fib_nh->nh_dev &&
+	    nla_put_u32(skb, NHA_OIF, fib_nh->nh_dev->ifindex))
+		goto nla_put_failure;
+	if (fib_nh->nh_gw &&
+	    nla_put_in_addr(skb, NHA_GATEWAY, fib_nh->nh_gw))
+		goto nla_put_failure;
+
+out:
+	nlmsg_end(skb, nlh);
+	return 0;
+
+nla_put_failure:
+	nlmsg_cancel(skb, nlh);
+	return -EMSGSIZE;
+}
+
+static void nexthop_notify(int event, struct nexthop *nh, struct nl_info *info)
+{
+	unsigned int nlflags = info->nlh ? info->nlh->nlmsg_flags : 0;
+	u32 seq = info->nlh ? info->nlh->nlmsg_seq : 0;
+	struct sk_buff *skb;
+	int err = -ENOBUFS;
+
+	skb = nlmsg_new(nh_nlmsg_size(nh), gfp_any());
+	if (!skb)
+		goto errout;
+
+	err = nh_fill_node(skb, nh, event, info->portid, seq, nlflags);
+	if (err < 0) {
+		/* -EMSGSIZE implies BUG in nh_nlmsg_size() */
+		WARN_ON(err == -EMSGSIZE);
+		kfree_skb(skb);
+		goto errout;
+	}
+
+	rtnl_notify(skb, info->nl_net, info->portid, RTNLGRP_NEXTHOP,
+		    info->nlh, gfp_any());
+	return;
+errout:
+	if (err < 0)
+		rtnl_set_sk_err(info->nl_net, RTNLGRP_NEXTHOP, err);
+}
+
+static void nh_group_unlink(struct nh_group *nhg)
+{
+	int i;
+
+	for (i = 0; i < nhg->num_nh; i++)
+		list_del(&nhg->nh_entries[i].nh_list);
+}
+
+static void remove_nexthop(struct net *net, struct nexthop *nh,
+			   struct nl_info *nlinfo);
+
+/* Drop one member from a group.  The group is rebuilt in its spare array
+ * and published with a single pointer swap; readers that still see the
+ * old array are waited for by the caller before the spare is reused.
+ */
+static void remove_nh_grp_entry(struct net *net, struct nh_grp_entry *nhge,
+				struct nl_info *nlinfo)
+{
+	struct nexthop *nhp = nhge->nh_parent;
+	struct nh_grp_entry *nhges, *new_nhges;
+	struct nh_group *nhg, *newg;
+	int i, j;
+
+	nhg = rtnl_dereference(nhp->nh_grp);
+
+	/* last member gone, the group goes with it */
+	if (nhg->num_nh == 1) {
+		remove_nexthop(net, nhp, nlinfo);
+		return;
+	}
+
+	newg = nhg->spare;
+	newg->spare = nhg;
+	newg->mpath = nhg->mpath;
+	newg->num_nh = nhg->num_nh - 1;
+
+	nhges = nhg->nh_entries;
+	new_nhges = newg->nh_entries;
+	for (i = 0, j = 0; i < nhg->num_nh; i++) {
+		if (&nhges[i] == nhge)
+			continue;
+
+		list_del(&nhges[i].nh_list);
+		new_nhges[j].nh_parent = nhp;
+		new_nhges[j].nh = nhges[i].nh;
+		new_nhges[j].weight = nhges[i].weight;
+		list_add(&new_nhges[j].nh_list, &new_nhges[j].nh->grp_list);
+		j++;
+	}
+
+	nh_group_rebalance(newg);
+	rcu_assign_pointer(nhp->nh_grp, newg);
+
+	list_del(&nhge->nh_list);
+	nexthop_put(nhge->nh);
+
+	if (nlinfo)
+		nexthop_notify(RTM_NEWNEXTHOP, nhp, nlinfo);
+}
+
+static void remove_nexthop_from_groups(struct net *net, struct nexthop *nh,
+				       struct nl_info *nlinfo)
+{
+	struct nh_grp_entry *nhge, *tmp;
+
+	if (list_empty(&nh->grp_list))
+		return;
+
+	list_for_each_entry_safe(nhge, tmp, &nh->grp_list, nh_list)
+		remove_nh_grp_entry(net, nhge, nlinfo);
+
+	/* routes cached on the member may still be reachable through the
+	 * forwarding cache; invalidate them before the member goes away
+	 */
+	rt_cache_flush(net);
+
+	/* make sure all see the newly published arrays before the spares
+	 * can be reused
+	 */
+	synchronize_net();
+}
+
+/* Kill every route using this nexthop */
+static void __remove_nexthop_fib(struct net *net, struct nexthop *nh)
+{
+	struct fib_info *fi;
+	bool do_flush = false;
+
+	list_for_each_entry(fi, &nh->fi_list, nh_list) {
+		fi->fib_flags |= RTNH_F_DEAD;
+		do_flush = true;
+	}
+	if (do_flush)
+		fib_flush(net);
+}
+
+static void __remove_nexthop(struct net *net, struct nexthop *nh,
+			     struct nl_info *nlinfo)
+{
+	__remove_nexthop_fib(net, nh);
+
+	if (nh->is_group) {
+		nh_group_unlink(rtnl_dereference(nh->nh_grp));
+	} else {
+		struct nh_info *nhi = rtnl_dereference(nh->nh_info);
+
+		if (nhi->fib_nh.nh_dev)
+			hlist_del(&nhi->dev_hash);
+
+		remove_nexthop_from_groups(net, nh, nlinfo);
+	}
+}
+
+static void remove_nexthop(struct net *net, struct nexthop *nh,
+			   struct nl_info *nlinfo)
+{
+	rb_erase(&nh->rb_node, &net->nexthop.rb_root);
+
+	if (nlinfo)
+		nexthop_notify(RTM_DELNEXTHOP, nh, nlinfo);
+
+	__remove_nexthop(net, nh, nlinfo);
+	nh_base_seq_inc(net);
+
+	nexthop_put(nh);
+}
+
+static int replace_nexthop_single(struct net *net, struct nexthop *old,
+				  struct nexthop *new)
+{
+	struct nh_info *oldi, *newi;
+	struct fib_info *fi;
+	int err;
+
+	if (new->is_group)
+		return -EINVAL;
+
+	oldi = rtnl_dereference(old->nh_info);
+	newi = rtnl_dereference(new->nh_info);
+
+	/* blackholes can not be group members */
+	if (newi->reject_nh && !list_empty(&old->grp_list))
+		return -EINVAL;
+
+	list_for_each_entry(fi, &old->fi_list, nh_list) {
+		err = nh_info_check_scope(newi, fi->fib_scope);
+		if (err)
+			return err;
+	}
+
+	if (oldi->fib_nh.nh_dev)
+		hlist_del(&oldi->dev_hash);
+	if (newi->fib_nh.nh_dev)
+		nexthop_devhash_add(net, newi);
+
+	newi->nh_parent = old;
+	oldi->nh_parent = new;
+
+	old->protocol = new->protocol;
+	old->nh_flags = new->nh_flags;
+
+	rcu_assign_pointer(old->nh_info, newi);
+	rcu_assign_pointer(new->nh_info, oldi);
+
+	nh_rebalance_groups(old);
+
+	return 0;
+}
+
+static int replace_nexthop_grp(struct net *net, struct nexthop *old,
+			       struct nexthop *new)
+{
+	struct nh_group *oldg, *newg;
+	struct fib_info *fi;
+	int err, i;
+
+	if (!new->is_group)
+		return -EINVAL;
+
+	oldg = rtnl_dereference(old->nh_grp);
+	newg = rtnl_dereference(new->nh_grp);
+
+	list_for_each_entry(fi, &old->fi_list, nh_list) {
+		err = fib_check_nexthop(new, fi->fib_scope);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < newg->num_nh; i++)
+		newg->nh_entries[i].nh_parent = old;
+	for (i = 0; i < oldg->num_nh; i++)
+		oldg->nh_entries[i].nh_parent = new;
+
+	old->protocol = new->protocol;
+	old->nh_flags = new->nh_flags;
+
+	rcu_assign_pointer(old->nh_grp, newg);
+	rcu_assign_pointer(new->nh_grp, oldg);
+
+	return 0;
+}
+
+/* Replace the contents of @old with those of @new.  Routes keep pointing
+ * at @old, so the update is atomic for all of them; @new ends up owning
+ * the previous contents and is released by the caller.
+ */
+static int replace_nexthop(struct net *net, struct nexthop *old,
+			   struct nexthop *new)
+{
+	int err;
+
+	if (old->is_group)
+		err = replace_nexthop_grp(net, old, new);
+	else
+		err = replace_nexthop_single(net, old, new);
+
+	if (!err)
+		rt_cache_flush(net);
+
+	return err;
+}
+
+static int insert_nexthop(struct net *net, struct nexthop *new_nh,
+			  struct nh_config *cfg)
+{
+	struct rb_node **pp = &net->nexthop.rb_root.rb_node;
+	bool replace = !!(cfg->nlflags & NLM_F_REPLACE);
+	struct rb_node *parent = NULL;
+	struct nexthop *nh;
+	int err;
+
+	while (*pp) {
+		nh = rb_entry(*pp, struct nexthop, rb_node);
+		parent = *pp;
+
+		if (new_nh->id < nh->id) {
+			pp = &(*pp)->rb_left;
+		} else if (new_nh->id > nh->id) {
+			pp = &(*pp)->rb_right;
+		} else {
+			if (!replace)
+				return -EEXIST;
+
+			err = replace_nexthop(net, nh, new_nh);
+			if (err)
+				return err;
+
+			if (new_nh->is_group)
+				nh_group_unlink(rtnl_dereference(new_nh->nh_grp));
+			nexthop_put(new_nh);
+			goto out;
+		}
+	}
+
+	if (replace)
+		return -ENOENT;
+
+	rb_link_node(&new_nh->rb_node, parent, pp);
+	rb_insert_color(&new_nh->rb_node, &net->nexthop.rb_root);
+	if (!new_nh->is_group) {
+		struct nh_info *nhi = rtnl_dereference(new_nh->nh_info);
+
+		if (nhi->fib_nh.nh_dev)
+			nexthop_devhash_add(net, nhi);
+	}
+	nh = new_nh;
+out:
+	nh_base_seq_inc(net);
+	nexthop_notify(RTM_NEWNEXTHOP, nh, &cfg->nlinfo);
+	return 0;
+}
+
+static int nh_create_group(struct net *net, struct nexthop *nh,
+			   struct nh_config *cfg)
+{
+	struct nexthop_grp *entry = nla_data(cfg->nh_grp);
+	u16 num_nh = nla_len(cfg->nh_grp) / sizeof(*entry);
+	struct nh_group *nhg;
+	int i;
+
+	nhg = nexthop_grp_alloc(num_nh);
+	if (!nhg)
+		return -ENOMEM;
+
+	nhg->spare = nexthop_grp_alloc(num_nh);
+	if (!nhg->spare) {
+		kfree(nhg);
+		return -ENOMEM;
+	}
+	nhg->mpath = cfg->nh_grp_type == NEXTHOP_GRP_TYPE_MPATH;
+
+	/* members were validated in nh_check_attr_group() under rtnl */
+	for (i = 0; i < num_nh; i++) {
+		struct nexthop *nhe = nexthop_find_by_id(net, entry[i].id);
+
+		nexthop_get(nhe);
+		nhg->nh_entries[i].nh = nhe;
+		nhg->nh_entries[i].weight = entry[i].weight + 1;
+		nhg->nh_entries[i].nh_parent = nh;
+		list_add(&nhg->nh_entries[i].nh_list, &nhe->grp_list);
+	}
+	nh_group_rebalance(nhg);
+
+	nh->is_group = true;
+	rcu_assign_pointer(nh->nh_grp, nhg);
+
+	return 0;
+}
+
+static int nh_create_info(struct net *net, struct nexthop *nh,
+			  struct nh_config *cfg)
+{
+	struct nh_info *nhi;
+	int err;
+
+	nhi = kzalloc(sizeof(*nhi), GFP_KERNEL);
+	if (!nhi)
+		return -ENOMEM;
+
+	nhi->nh_parent = nh;
+	nhi->family = cfg->nh_family;
+
+	if (cfg->nh_blackhole) {
+		nhi->reject_nh = true;
+	} else {
+		struct fib_config fib_cfg = {
+			.fc_oif   = cfg->nh_ifindex,
+			.fc_gw    = cfg->gw,
+			.fc_flags = cfg->nh_flags,
+			.fc_nlinfo = cfg->nlinfo,
+		};
+
+		err = fib_nh_init(net, &nhi->fib_nh, &fib_cfg);
+		if (err) {
+			nh_info_free(nhi);
+			return err;
+		}
+	}
+
+	rcu_assign_pointer(nh->nh_info, nhi);
+
+	return 0;
+}
+
+static int nexthop_add(struct net *net, struct nh_config *cfg)
+{
+	struct nexthop *nh;
+	int err;
+
+	if (cfg->nlflags & NLM_F_REPLACE && !cfg->nh_id)
+		return -EINVAL;
+
+	if (!cfg->nh_id) {
+		cfg->nh_id = nh_find_unused_id(net);
+		if (!cfg->nh_id)
+			return -ENFILE;
+	}
+
+	nh = nexthop_alloc();
+	if (!nh)
+		return -ENOMEM;
+
+	nh->net = net;
+	nh->id = cfg->nh_id;
+	nh->protocol = cfg->nh_protocol;
+	nh->nh_flags = cfg->nh_flags;
+
+	if (cfg->nh_grp)
+		err = nh_create_group(net, nh, cfg);
+	else
+		err = nh_create_info(net, nh, cfg);
+	if (err) {
+		kfree(nh);
+		return err;
+	}
+
+	err = insert_nexthop(net, nh, cfg);
+	if (err) {
+		if (nh->is_group)
+			nh_group_unlink(rtnl_dereference(nh->nh_grp));
+		nexthop_put(nh);
+	}
+
+	return err;
+}
+
+static int nh_check_attr_group(struct net *net, struct nlattr *attr)
+{
+	unsigned int len = nla_len(attr);
+	struct nexthop_grp *nhg;
+	unsigned int i, j;
+
+	if (!len || len % sizeof(*nhg))
+		return -EINVAL;
+
+	/* convert len to number of nexthop ids */
+	len /= sizeof(*nhg);
+	if (len > NH_GRP_MAX_PATHS)
+		return -EINVAL;
+
+	nhg = nla_data(attr);
+	for (i = 0; i < len; i++) {
+		struct nexthop *nh;
+
+		if (nhg[i].resvd1 || nhg[i].resvd2)
+			return -EINVAL;
+
+		for (j = i + 1; j < len; j++) {
+			if (nhg[i].id == nhg[j].id)
+				return -EINVAL;
+		}
+
+		/* groups of groups and blackhole members are not supported */
+		nh = nexthop_find_by_id(net, nhg[i].id);
+		if (!nh || nh->is_group || nexthop_is_blackhole(nh))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int rtm_to_nh_config(struct net *net, struct sk_buff *skb,
+			    struct nlmsghdr *nlh, struct nh_config *cfg)
+{
+	struct nlattr *tb[NHA_MAX + 1];
+	struct nhmsg *nhm;
+	int err;
+
+	err = nlmsg_parse(nlh, sizeof(*nhm), tb, NHA_MAX, rtm_nh_policy);
+	if (err < 0)
+		return err;
+
+	err = -EINVAL;
+	nhm = nlmsg_data(nlh);
+	if (nhm->resvd || nhm->nh_scope)
+		goto out;
+	if (nhm->nh_flags & ~NEXTHOP_VALID_USER_FLAGS)
+		goto out;
+
+	switch (nhm->nh_family) {
+	case AF_INET:
+		break;
+	case AF_UNSPEC:
+		if (tb[NHA_GROUP])
+			break;
+		/* fallthrough */
+	default:
+		err = -EAFNOSUPPORT;
+		goto out;
+	}
+
+	/* dump filters only */
+	if (tb[NHA_GROUPS] || tb[NHA_MASTER])
+		goto out;
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->nlflags = nlh->nlmsg_flags;
+	cfg->nlinfo.portid = NETLINK_CB(skb).portid;
+	cfg->nlinfo.nlh = nlh;
+	cfg->nlinfo.nl_net = net;
+
+	cfg->nh_family = nhm->nh_family;
+	cfg->nh_protocol = nhm->nh_protocol;
+	cfg->nh_flags = nhm->nh_flags;
+
+	if (tb[NHA_ID])
+		cfg->nh_id = nla_get_u32(tb[NHA_ID]);
+
+	if (tb[NHA_GROUP]) {
+		if (tb[NHA_BLACKHOLE] || tb[NHA_OIF] || tb[NHA_GATEWAY] ||
+		    tb[NHA_ENCAP])
+			goto out;
+
+		cfg->nh_grp = tb[NHA_GROUP];
+		cfg->nh_grp_type = NEXTHOP_GRP_TYPE_MPATH;
+		if (tb[NHA_GROUP_TYPE])
+			cfg->nh_grp_type = nla_get_u16(tb[NHA_GROUP_TYPE]);
+		if (cfg->nh_grp_type > NEXTHOP_GRP_TYPE_MAX)
+			goto out;
+
+		err = nh_check_attr_group(net, tb[NHA_GROUP]);
+		goto out;
+	}
+
+	if (tb[NHA_BLACKHOLE]) {
+		if (tb[NHA_GATEWAY] || tb[NHA_OIF] || tb[NHA_ENCAP])
+			goto out;
+
+		cfg->nh_blackhole = 1;
+		err = 0;
+		goto out;
+	}
+
+	/* lightweight tunnel encap is not supported on nexthop objects */
+	if (tb[NHA_ENCAP] || tb[NHA_ENCAP_TYPE]) {
+		err = -EOPNOTSUPP;
+		goto out;
+	}
+
+	if (!tb[NHA_OIF])
+		goto out;
+
+	cfg->nh_ifindex = nla_get_u32(tb[NHA_OIF]);
+	if (tb[NHA_GATEWAY])
+		cfg->gw = nla_get_in_addr(tb[NHA_GATEWAY]);
+
+	err = 0;
+out:
+	return err;
+}
+
+static int rtm_new_nexthop(struct sk_buff *skb, struct nlmsghdr *nlh)
+{
+	struct net *net = sock_net(skb->sk);
+	struct nh_config cfg;
+	int err;
+
+	err = rtm_to_nh_config(net, skb, nlh, &cfg);
+	if (!err)
+		err = nexthop_add(net, &cfg);
+
+	return err;
+}
+
+static int nh_valid_get_del_req(struct nlmsghdr *nlh, u32 *id)
+{
+	struct nhmsg *nhm = nlmsg_data(nlh);
+	struct nlattr *tb[NHA_MAX + 1];
+	int err, i;
+
+	err = nlmsg_parse(nlh, sizeof(*nhm), tb, NHA_MAX, rtm_nh_policy);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i <= NHA_MAX; i++) {
+		if (tb[i] && i != NHA_ID)
+			return -EINVAL;
+	}
+
+	if (nhm->nh_protocol || nhm->resvd || nhm->nh_scope || nhm->nh_flags)
+		return -EINVAL;
+
+	if (!tb[NHA_ID])
+		return -EINVAL;
+
+	*id = nla_get_u32(tb[NHA_ID]);
+	if (!*id)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int rtm_del_nexthop(struct sk_buff *skb, struct nlmsghdr *nlh)
+{
+	struct net *net = sock_net(skb->sk);
+	struct nl_info nlinfo = {
+		.nlh = nlh,
+		.nl_net = net,
+		.portid = NETLINK_CB(skb).portid,
+	};
+	struct nexthop *nh;
+	int err;
+	u32 id;
+
+	err = nh_valid_get_del_req(nlh, &id);
+	if (err)
+		return err;
+
+	nh = nexthop_find_by_id(net, id);
+	if (!nh)
+		return -ENOENT;
+
+	remove_nexthop(net, nh, &nlinfo);
+
+	return 0;
+}
+
+static int rtm_get_nexthop(struct sk_buff *in_skb, struct nlmsghdr *nlh)
+{
+	struct net *net = sock_net(in_skb->sk);
+	struct sk_buff *skb = NULL;
+	struct nexthop *nh;
+	int err;
+	u32 id;
+
+	err = nh_valid_get_del_req(nlh, &id);
+	if (err)
+		return err;
+
+	err = -ENOENT;
+	nh = nexthop_find_by_id(net, id);
+	if (!nh)
+		goto errout;
+
+	err = -ENOBUFS;
+	skb = nlmsg_new(nh_nlmsg_size(nh), GFP_KERNEL);
+	if (!skb)
+		goto errout;
+
+	err = nh_fill_node(skb, nh, RTM_NEWNEXTHOP, NETLINK_CB(in_skb).portid,
+			   nlh->nlmsg_seq, 0);
+	if (err < 0) {
+		WARN_ON(err == -EMSGSIZE);
+		goto errout_free;
+	}
+
+	return rtnl_unicast(skb, net, NETLINK_CB(in_skb).portid);
+
+errout_free:
+	kfree_skb(skb);
+errout:
+	return err;
+}
+
+static bool nh_dump_filtered(struct nexthop *nh, int dev_idx, int master_idx,
+			     bool group_filter, u8 family)
+{
+	const struct net_device *dev;
+	const struct nh_info *nhi;
+
+	if (group_filter && !nh->is_group)
+		return true;
+
+	if (!dev_idx && !master_idx && !family)
+		return false;
+
+	if (nh->is_group)
+		return true;
+
+	nhi = rtnl_dereference(nh->nh_info);
+	if (family && nhi->family != family)
+		return true;
+
+	dev = nhi->fib_nh.nh_dev;
+	if (dev_idx && (!dev || dev->ifindex != dev_idx))
+		return true;
+
+	if (master_idx) {
+		struct net_device *master;
+
+		if (!dev)
+			return true;
+
+		master = netdev_master_upper_dev_get((struct net_device *)dev);
+		if (!master || master->ifindex != master_idx)
+			return true;
+	}
+
+	return false;
+}
+
+/* rtnetlink dumps run under rtnl_mutex (the socket's cb_mutex) */
+static int rtm_dump_nexthop(struct sk_buff *skb, struct netlink_callback *cb)
+{
+	struct net *net = sock_net(skb->sk);
+	struct nlattr *tb[NHA_MAX + 1];
+	int dev_filter_idx = 0, master_idx = 0;
+	bool group_filter = false;
+	struct rb_node *node;
+	int idx = 0, s_idx;
+	u8 family = 0;
+	int err;
+
+	if (nlmsg_len(cb->nlh) >= sizeof(struct nhmsg)) {
+		struct nhmsg *nhm = nlmsg_data(cb->nlh);
+
+		err = nlmsg_parse(cb->nlh, sizeof(*nhm), tb, NHA_MAX,
+				  rtm_nh_policy);
+		if (err < 0)
+			return err;
+
+		if (tb[NHA_OIF])
+			dev_filter_idx = nla_get_u32(tb[NHA_OIF]);
+		if (tb[NHA_MASTER])
+			master_idx = nla_get_u32(tb[NHA_MASTER]);
+		if (tb[NHA_GROUPS])
+			group_filter = true;
+		family = nhm->nh_family;
+	}
+
+	s_idx = cb->args[0];
+	for (node = rb_first(&net->nexthop.rb_root); node;
+	     node = rb_next(node), idx++) {
+		struct nexthop *nh;
+
+		if (idx < s_idx)
+			continue;
+
+		nh = rb_entry(node, struct nexthop, rb_node);
+		if (nh_dump_filtered(nh, dev_filter_idx, master_idx,
+				     group_filter, family))
+			continue;
+
+		err = nh_fill_node(skb, nh, RTM_NEWNEXTHOP,
+				   NETLINK_CB(cb->skb).portid,
+				   cb->nlh->nlmsg_seq, NLM_F_MULTI);
+		if (err < 0) {
+			if (likely(skb->len))
+				goto out;
+			goto out_err;
+		}
+	}
+
+out:
+	err = skb->len;
+out_err:
+	cb->args[0] = idx;
+	cb->seq = net->nexthop.seq;
+	nl_dump_check_consistent(cb, nlmsg_hdr(skb));
+
+	return err;
+}
+
+static void nexthop_sync_dev(struct net_device *dev, unsigned long event)
+{
+	struct net *net = dev_net(dev);
+	struct nl_info nlinfo = {
+		.nl_net = net,
+	};
+	struct hlist_head *head;
+	struct hlist_node *tmp;
+	struct nh_info *nhi;
+	bool changed = false;
+
+	head = &net->nexthop.devhash[nh_dev_hashfn(dev->ifindex)];
+	hlist_for_each_entry_safe(nhi, tmp, head, dev_hash) {
+		if (nhi->fib_nh.nh_dev != dev)
+			continue;
+
+		switch (event) {
+		case NETDEV_UNREGISTER:
+			remove_nexthop(net, nhi->nh_parent, &nlinfo);
+			continue;
+		case NETDEV_DOWN:
+			nhi->fib_nh.nh_flags |= RTNH_F_DEAD;
+			break;
+		case NETDEV_UP:
+			nhi->fib_nh.nh_flags &= ~RTNH_F_DEAD;
+			break;
+		}
+
+		nh_rebalance_groups(nhi->nh_parent);
+		changed = true;
+	}
+
+	if (changed)
+		rt_cache_flush(net);
+}
+
+static int nh_netdev_event(struct notifier_block *this,
+			   unsigned long event, void *ptr)
+{
+	struct net_device *dev = netdev_notifier_info_to_dev(ptr);
+
+	switch (event) {
+	case NETDEV_UNREGISTER:
+	case NETDEV_DOWN:
+	case NETDEV_UP:
+		nexthop_sync_dev(dev, event);
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block nh_netdev_notifier = {
+	.notifier_call = nh_netdev_event,
+};
+
+static void flush_all_nexthops(struct net *net)
+{
+	struct rb_root *root = &net->nexthop.rb_root;
+	struct rb_node *node;
+
+	while ((node = rb_first(root)))
+		remove_nexthop(net, rb_entry(node, struct nexthop, rb_node),
+			       NULL);
+}
+
+static int __net_init nexthop_net_init(struct net *net)
+{
+	size_t sz = sizeof(struct hlist_head) * NH_DEV_HASHSIZE;
+
+	net->nexthop.rb_root = RB_ROOT;
+	net->nexthop.devhash = kzalloc(sz, GFP_KERNEL);
+	if (!net->nexthop.devhash)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void __net_exit nexthop_net_exit(struct net *net)
+{
+	rtnl_lock();
+	flush_all_nexthops(net);
+	rtnl_unlock();
+	kfree(net->nexthop.devhash);
+}
+
+static struct pernet_operations nexthop_net_ops = {
+	.init = nexthop_net_init,
+	.exit = nexthop_net_exit,
+};
+
+static int __init nexthop_init(void)
+{
+	register_pernet_subsys(&nexthop_net_ops);
+	register_netdevice_notifier_rh(&nh_netdev_notifier);
+
+	rtnl_register(PF_UNSPEC, RTM_NEWNEXTHOP, rtm_new_nexthop, NULL, NULL);
+	rtnl_register(PF_UNSPEC, RTM_DELNEXTHOP, rtm_del_nexthop, NULL, NULL);
+	rtnl_register(PF_UNSPEC, RTM_GETNEXTHOP, rtm_get_nexthop,
+		      rtm_dump_nexthop, NULL);
+
+	return 0;
+}
+subsys_initcall(nexthop_init);
@@ -204,6 +204,16 @@ EXPORT_SYMBOL(ip_tos2prio);
 static DEFINE_PER_CPU(struct rt_cache_stat, rt_cache_stat);
 #define RT_CACHE_STAT_INC(field) __this_cpu_inc(rt_cache_stat.field)
 
+/* bumped before any route the forwarding cache may hold is released,
+ * see ip_fwd_cache_lookup()
+ */
+static atomic_t ip_fwd_cache_genid = ATOMIC_INIT(0);
+
+void ip_fwd_cache_flush(void)
+{
+	atomic_inc(&ip_fwd_cache_genid);
+}
+
 #ifdef CONFIG_PROC_FS
 static void *rt_cache_seq_start(struct seq_file *seq, loff_t *pos)
 {
@@ -720,8 +730,10 @@ static void update_or_create_fnhe(struct fib_nh *nh, __be32 daddr, __be32 gw,
 		 * applies to them.
 		 */
 		rt = rcu_dereference(nh->nh_rth_input);
-		if (rt)
+		if (rt) {
 			rt->dst.obsolete = DST_OBSOLETE_KILL;
+			ip_fwd_cache_flush();
+		}
 
 		for_each_possible_cpu(i) {
 			struct rtable __rcu **prt;
@@ -1360,8 +1372,11 @@ static bool rt_cache_route(struct fib_nh *nh, struct rtable *rt)
 
 	prev = cmpxchg(p, orig, rt);
 	if (prev == orig) {
-		if (orig)
+		if (orig) {
+			if (rt_is_input_route(orig))
+				ip_fwd_cache_flush();
 			rt_free(orig);
+		}
 	} else
 		ret = false;
 
@@ -1395,6 +1410,8 @@ static void ipv4_dst_destroy(struct dst_entry *dst)
 
 void rt_flush_dev(struct net_device *dev)
 {
+	ip_fwd_cache_flush();
+
 	if (!list_empty(&rt_uncached_list)) {
 		struct net *net = dev_net(dev);
 		struct rtable *rt;
@@ -1418,6 +1435,126 @@ static bool rt_cache_valid(const struct rtable *rt)
 		!rt_is_expired(rt);
 }
 
+/*
+ * Per-cpu forwarding cache.
+ *
+ * A small direct-mapped table per cpu remembering the input route picked
+ * for recently forwarded flows, keyed on (daddr, saddr, tos, mark, dev),
+ * so later packets of the same flow skip fib_lookup() and
+ * fib_validate_source() altogether.  Only the route cached on the nexthop
+ * (nh_rth_input) is remembered and entries hold no reference.  Instead,
+ * ip_fwd_cache_flush() is called before such a route can go away: when
+ * rt_cache_route() replaces it, when a nexthop exception kills it, when
+ * its fib_info is freed and when its device is unregistered.  All of
+ * those release the route through RCU, so a lookup that still saw the
+ * old ip_fwd_cache_genid runs inside a read-side section the free has to
+ * wait for.  Entries are also dropped when the netns route genid moves.
+ */
+#define IP_FWD_CACHE_BITS	8
+#define IP_FWD_CACHE_SIZE	(1U << IP_FWD_CACHE_BITS)
+
+struct ip_fwd_cache_entry {
+	__be32			daddr;
+	__be32			saddr;
+	const struct net_device	*dev;
+	u32			mark;
+	u8			tos;
+	int			rt_genid;
+	int			genid;
+	struct rtable		*rth;
+};
+
+static struct ip_fwd_cache_entry __percpu *ip_fwd_cache __read_mostly;
+static u32 ip_fwd_cache_seed __read_mostly;
+
+static bool ip_fwd_cache_usable(struct sk_buff *skb)
+{
+	/* entries are only ever touched from softirq on the local cpu */
+	if (!in_softirq() || in_irq())
+		return false;
+
+	/* proxy arp, tunnel metadata and icmp errors (multipath hashes
+	 * their inner header) always take the slow path
+	 */
+	return skb->protocol == htons(ETH_P_IP) &&
+	       !skb_tunnel_info(skb) &&
+	       ip_hdr(skb)->protocol != IPPROTO_ICMP;
+}
+
+static struct ip_fwd_cache_entry *ip_fwd_cache_slot(__be32 daddr,
+						    __be32 saddr,
+						    const struct net_device *dev,
+						    u32 mark, u8 tos)
+{
+	u32 hash;
+
+	hash = jhash_3words((__force u32)daddr, (__force u32)saddr,
+			    dev->ifindex ^ mark ^ tos, ip_fwd_cache_seed);
+
+	return this_cpu_ptr(ip_fwd_cache) + (hash & (IP_FWD_CACHE_SIZE - 1));
+}
+
+static struct rtable *ip_fwd_cache_lookup(struct sk_buff *skb,
+					  __be32 daddr, __be32 saddr, u8 tos,
+					  const struct net_device *dev)
+{
+	struct ip_fwd_cache_entry *e;
+
+	if (!ip_fwd_cache_usable(skb))
+		return NULL;
+
+	e = ip_fwd_cache_slot(daddr, saddr, dev, skb->mark, tos);
+	if (e->daddr != daddr || e->saddr != saddr || e->dev != dev ||
+	    e->mark != skb->mark || e->tos != tos)
+		return NULL;
+
+	if (e->genid != atomic_read(&ip_fwd_cache_genid) ||
+	    e->rt_genid != rt_genid_ipv4(dev_net(dev)))
+		return NULL;
+
+	if (!rt_cache_valid(e->rth))
+		return NULL;
+
+	return e->rth;
+}
+
+static void ip_fwd_cache_store(struct sk_buff *skb,
+			       struct fib_result *res,
+			       __be32 daddr, __be32 saddr, u8 tos,
+			       const struct net_device *dev)
+{
+	struct rtable *rth = skb_rtable(skb);
+	struct ip_fwd_cache_entry *e;
+
+	if (!ip_fwd_cache_usable(skb))
+		return;
+
+	/* redirects are decided per packet */
+	if (IPCB(skb)->flags & IPSKB_DOREDIRECT)
+		return;
+
+	if (rth != rcu_dereference(FIB_RES_NH(*res).nh_rth_input) ||
+	    !rt_cache_valid(rth))
+		return;
+
+#ifdef CONFIG_IP_ROUTE_MULTIPATH
+	/* L4 multipath hashing spreads one address pair over several paths */
+	if (fib_info_num_path(res->fi) > 1 &&
+	    dev_net(dev)->ipv4_sysctl_fib_multipath_hash_policy)
+		return;
+#endif
+
+	e = ip_fwd_cache_slot(daddr, saddr, dev, skb->mark, tos);
+	e->daddr = daddr;
+	e->saddr = saddr;
+	e->dev = dev;
+	e->mark = skb->mark;
+	e->tos = tos;
+	e->rt_genid = rth->rt_genid;
+	e->genid = atomic_read(&ip_fwd_cache_genid);
+	e->rth = rth;
+}
+
 static void rt_set_nexthop(struct rtable *rt, __be32 daddr,
 			   const struct fib_result *res,
 			   struct fib_nh_exception *fnhe,
@@ -1828,8 +1965,10 @@ static int ip_mkroute_input(struct sk_buff *skb,
 			    struct in_device *in_dev,
 			    __be32 daddr, __be32 saddr, u32 tos)
 {
+	int err;
+
 #ifdef CONFIG_IP_ROUTE_MULTIPATH
-	if (res->fi && res->fi->fib_nhs > 1) {
+	if (res->fi && fib_info_num_path(res->fi) > 1) {
 		int h = fib_multipath_hash(res->fi, NULL, skb);
 
 		fib_select_multipath(res, h);
@@ -1837,7 +1976,10 @@ static int ip_mkroute_input(struct sk_buff *skb,
 #endif
 
 	/* create a routing cache entry */
-	return __mkroute_input(skb, res, in_dev, daddr, saddr, tos);
+	err = __mkroute_input(skb, res, in_dev, daddr, saddr, tos);
+	if (!err)
+		ip_fwd_cache_store(skb, res, daddr, saddr, tos, in_dev->dev);
+	return err;
 }
 
 /*
@@ -2034,6 +2176,7 @@ martian_source_keep_err:
 int ip_route_input_noref(struct sk_buff *skb, __be32 daddr, __be32 saddr,
 			 u8 tos, struct net_device *dev)
 {
+	struct rtable *rth;
 	int res;
 
 	rcu_read_lock();
@@ -2071,6 +2214,15 @@ int ip_route_input_noref(struct sk_buff *skb, __be32 daddr, __be32 saddr,
 		rcu_read_unlock();
 		return -EINVAL;
 	}
+
+	rth = ip_fwd_cache_lookup(skb, daddr, saddr, tos, dev);
+	if (rth) {
+		skb_dst_drop(skb);
+		skb_dst_set_noref(skb, &rth->dst);
+		rcu_read_unlock();
+		return 0;
+	}
+
 	res = ip_route_input_slow(skb, daddr, saddr, tos, dev);
 	rcu_read_unlock();
 	return res;
@@ -2937,6 +3089,13 @@ int __init ip_rt_init(void)
 		panic("IP: failed to allocate ip_rt_acct\n");
 #endif
 
+	ip_fwd_cache = __alloc_percpu(IP_FWD_CACHE_SIZE *
+				      sizeof(struct ip_fwd_cache_entry),
+				      __alignof__(struct ip_fwd_cache_entry));
+	if (!ip_fwd_cache)
+		panic("IP: failed to allocate ip_fwd_cache\n");
+	get_random_bytes(&ip_fwd_cache_seed, sizeof(ip_fwd_cache_seed));
+
 	ipv4_dst_ops.kmem_cachep =
 		kmem_cache_create("ip_dst_cache", sizeof(struct rtable), 0,
 				  SLAB_HWCACHE_ALIGN|SLAB_PANIC, NULL);
@@ -311,8 +311,10 @@ static int proc_fib_multipath_hash_policy(struct ctl_table *table, int write,
 	int ret;
 
 	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
-	if (write && ret == 0)
+	if (write && ret == 0) {
 		call_netevent_notifiers(NETEVENT_IPV4_MPATH_HASH_UPDATE, net);
+		rt_cache_flush(net);
+	}
 
 	return ret;
 }
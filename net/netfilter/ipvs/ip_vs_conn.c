@@ -36,6 +36,10 @@
 #include <linux/seq_file.h>
 #include <linux/jhash.h>
 #include <linux/random.h>
+#include <linux/log2.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
+#include <linux/percpu_counter.h>
 
 #include <net/net_namespace.h>
 #include <net/ip_vs.h>
@@ -45,6 +49,9 @@
 #define CONFIG_IP_VS_TAB_BITS	12
 #endif
 
+/* Upper limit for the size the connection hash can grow to */
+#define IP_VS_CONN_TAB_MAX_BITS	24
+
 /*
  * Connection hash size. Default is what was selected at compile time.
 */
@@ -52,14 +59,42 @@ static int ip_vs_conn_tab_bits = CONFIG_IP_VS_TAB_BITS;
 module_param_named(conn_tab_bits, ip_vs_conn_tab_bits, int, 0444);
 MODULE_PARM_DESC(conn_tab_bits, "Set connections' hash size");
 
-/* size and mask values */
+/*
+ * The table is doubled from a work item when the number of hashed
+ * connections exceeds the number of buckets, up to this size.
+ */
+static int ip_vs_conn_tab_max_bits = 22;
+module_param_named(conn_tab_max_bits, ip_vs_conn_tab_max_bits, int, 0444);
+MODULE_PARM_DESC(conn_tab_max_bits, "Set connections' maximum hash size");
+
+/* current size of the table, for reporting */
 int ip_vs_conn_tab_size __read_mostly;
-static int ip_vs_conn_tab_mask __read_mostly;
 
 /*
  *  Connection hash table: for input and output packets lookups of IPVS
  */
-static struct hlist_head *ip_vs_conn_tab __read_mostly;
+struct ip_vs_conn_tab {
+	unsigned int		size;
+	unsigned int		mask;
+	struct hlist_head	buckets[0];
+};
+
+/*
+ * Lookups walk ip_vs_conn_tab under RCU. While a resize is in progress
+ * the entries are moved, one lock stripe at a time, into
+ * ip_vs_conn_tab_new and lookups search both tables. Every move is
+ * covered by ip_vs_conn_tab_seq, so a lookup that misses while entries
+ * were moving under it retries instead of reporting a false miss.
+ */
+static struct ip_vs_conn_tab __rcu *ip_vs_conn_tab __read_mostly;
+static struct ip_vs_conn_tab __rcu *ip_vs_conn_tab_new __read_mostly;
+static seqcount_t ip_vs_conn_tab_seq;
+
+/* number of hashed connections, drives the table growth */
+static struct percpu_counter ip_vs_conn_hashed;
+
+static void ip_vs_conn_resize(struct work_struct *work);
+static DECLARE_WORK(ip_vs_conn_resize_work, ip_vs_conn_resize);
 
 /*  SLAB cache for IPVS connections */
 static struct kmem_cache *ip_vs_conn_cachep __read_mostly;
@@ -71,35 +106,55 @@ static atomic_t ip_vs_conn_no_cport_cnt = ATOMIC_INIT(0);
 static unsigned int ip_vs_conn_rnd __read_mostly;
 
 /*
- *  Fine locking granularity for big connection hash table
+ *  Fine locking granularity for big connection hash table.
+ *  The lock is selected by the low bits of the full hash value, so
+ *  as long as there are no more locks than buckets, a bucket is
+ *  always covered by the same lock whatever the table size is.
+ *  The array is scaled with the number of possible CPUs at init.
  */
-#define CT_LOCKARRAY_BITS  5
-#define CT_LOCKARRAY_SIZE  (1<<CT_LOCKARRAY_BITS)
-#define CT_LOCKARRAY_MASK  (CT_LOCKARRAY_SIZE-1)
+#define CT_LOCKARRAY_BITS	5
+#define CT_LOCKARRAY_MAX_BITS	10
+#define CT_LOCKARRAY_MAX_SIZE	(1<<CT_LOCKARRAY_MAX_BITS)
+#define CT_LOCKS_PER_CPU	8
 
 struct ip_vs_aligned_lock
 {
-	spinlock_t	l;
+	spinlock_t		l;
+	/* table holding the entries covered by this lock */
+	struct ip_vs_conn_tab	*tab;
 } __attribute__((__aligned__(SMP_CACHE_BYTES)));
 
 /* lock array for conn table */
 static struct ip_vs_aligned_lock
-__ip_vs_conntbl_lock_array[CT_LOCKARRAY_SIZE] __cacheline_aligned;
+__ip_vs_conntbl_lock_array[CT_LOCKARRAY_MAX_SIZE] __cacheline_aligned;
+
+static unsigned int ct_lockarray_size __read_mostly;
+static unsigned int ct_lockarray_mask __read_mostly;
 
 static inline void ct_write_lock_bh(unsigned int key)
 {
-	spin_lock_bh(&__ip_vs_conntbl_lock_array[key&CT_LOCKARRAY_MASK].l);
+	spin_lock_bh(&__ip_vs_conntbl_lock_array[key&ct_lockarray_mask].l);
 }
 
 static inline void ct_write_unlock_bh(unsigned int key)
 {
-	spin_unlock_bh(&__ip_vs_conntbl_lock_array[key&CT_LOCKARRAY_MASK].l);
+	spin_unlock_bh(&__ip_vs_conntbl_lock_array[key&ct_lockarray_mask].l);
+}
+
+/* Returns the bucket for the hash key, the lock for the key must be held */
+static inline struct hlist_head *ct_bucket_locked(unsigned int key)
+{
+	struct ip_vs_conn_tab *t;
+
+	t = __ip_vs_conntbl_lock_array[key&ct_lockarray_mask].tab;
+	return &t->buckets[key & t->mask];
 }
 
 static void ip_vs_conn_expire(unsigned long data);
 
 /*
- *	Returns hash value for IPVS connection entry
+ *	Returns hash value for IPVS connection entry, callers reduce it
+ *	to a bucket of the table they are working on
  */
 static unsigned int ip_vs_conn_hashkey(struct net *net, int af, unsigned int proto,
 				       const union nf_inet_addr *addr,
@@ -109,11 +164,11 @@ static unsigned int ip_vs_conn_hashkey(struct net *net, int af, unsigned int pro
 	if (af == AF_INET6)
 		return (jhash_3words(jhash(addr, 16, ip_vs_conn_rnd),
 				    (__force u32)port, proto, ip_vs_conn_rnd) ^
-			((size_t)net>>8)) & ip_vs_conn_tab_mask;
+			((size_t)net>>8));
 #endif
 	return (jhash_3words((__force u32)addr->ip, (__force u32)port, proto,
 			    ip_vs_conn_rnd) ^
-		((size_t)net>>8)) & ip_vs_conn_tab_mask;
+		((size_t)net>>8));
 }
 
 static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
@@ -123,8 +178,7 @@ static unsigned int ip_vs_conn_hashkey_param(const struct ip_vs_conn_param *p,
 	__be16 port;
 
 	if (p->pe_data && p->pe->hashkey_raw)
-		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse) &
-			ip_vs_conn_tab_mask;
+		return p->pe->hashkey_raw(p, ip_vs_conn_rnd, inverse);
 
 	if (likely(!inverse)) {
 		addr = p->caddr;
@@ -174,7 +228,8 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 	if (!(cp->flags & IP_VS_CONN_F_HASHED)) {
 		cp->flags |= IP_VS_CONN_F_HASHED;
 		atomic_inc(&cp->refcnt);
-		hlist_add_head_rcu(&cp->c_list, &ip_vs_conn_tab[hash]);
+		hlist_add_head_rcu(&cp->c_list, ct_bucket_locked(hash));
+		percpu_counter_inc(&ip_vs_conn_hashed);
 		ret = 1;
 	} else {
 		pr_err("%s(): request for already hashed, called from %pF\n",
@@ -185,6 +240,13 @@ static inline int ip_vs_conn_hash(struct ip_vs_conn *cp)
 	spin_unlock(&cp->lock);
 	ct_write_unlock_bh(hash);
 
+	if (ret &&
+	    unlikely(percpu_counter_read_positive(&ip_vs_conn_hashed) >
+		     ip_vs_conn_tab_size) &&
+	    ip_vs_conn_tab_size < (1 << ip_vs_conn_tab_max_bits) &&
+	    !work_pending(&ip_vs_conn_resize_work))
+		schedule_work(&ip_vs_conn_resize_work);
+
 	return ret;
 }
 
@@ -208,6 +270,7 @@ static inline int ip_vs_conn_unhash(struct ip_vs_conn *cp)
 		hlist_del_rcu(&cp->c_list);
 		cp->flags &= ~IP_VS_CONN_F_HASHED;
 		atomic_dec(&cp->refcnt);
+		percpu_counter_dec(&ip_vs_conn_hashed);
 		ret = 1;
 	} else
 		ret = 0;
@@ -237,6 +300,7 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 		if (atomic_cmpxchg(&cp->refcnt, 1, 0) == 1) {
 			hlist_del_rcu(&cp->c_list);
 			cp->flags &= ~IP_VS_CONN_F_HASHED;
+			percpu_counter_dec(&ip_vs_conn_hashed);
 			ret = true;
 		}
 	} else
@@ -250,22 +314,45 @@ static inline bool ip_vs_conn_unlink(struct ip_vs_conn *cp)
 
 
 /*
- *  Gets ip_vs_conn associated with supplied parameters in the ip_vs_conn_tab.
- *  Called for pkts coming from OUTside-to-INside.
- *	p->caddr, p->cport: pkt source address (foreign host)
- *	p->vaddr, p->vport: pkt dest address (load balancer)
+ *  Look the hash key up with the chain matcher in the current table and,
+ *  while it is being resized, in the new table. Must be called under
+ *  rcu_read_lock(). Returns the matched entry with a reference held.
  */
 static inline struct ip_vs_conn *
-__ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
+ip_vs_conn_lookup(unsigned int hash, const struct ip_vs_conn_param *p,
+		  struct ip_vs_conn *(*match)(struct hlist_head *head,
+					      const struct ip_vs_conn_param *p))
 {
-	unsigned int hash;
+	struct ip_vs_conn_tab *t;
 	struct ip_vs_conn *cp;
+	unsigned int seq;
 
-	hash = ip_vs_conn_hashkey_param(p, false);
+	do {
+		seq = read_seqcount_begin(&ip_vs_conn_tab_seq);
 
-	rcu_read_lock();
+		t = rcu_dereference(ip_vs_conn_tab);
+		cp = match(&t->buckets[hash & t->mask], p);
+		if (cp)
+			return cp;
+
+		t = rcu_dereference(ip_vs_conn_tab_new);
+		if (t) {
+			cp = match(&t->buckets[hash & t->mask], p);
+			if (cp)
+				return cp;
+		}
+	} while (read_seqcount_retry(&ip_vs_conn_tab_seq, seq));
+
+	return NULL;
+}
+
+
+static inline struct ip_vs_conn *
+ip_vs_conn_in_match(struct hlist_head *head, const struct ip_vs_conn_param *p)
+{
+	struct ip_vs_conn *cp;
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+	hlist_for_each_entry_rcu(cp, head, c_list) {
 		if (p->cport == cp->cport && p->vport == cp->vport &&
 		    cp->af == p->af &&
 		    ip_vs_addr_equal(p->af, p->caddr, &cp->caddr) &&
@@ -276,14 +363,32 @@ __ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
 			if (!__ip_vs_conn_get(cp))
 				continue;
 			/* HIT */
-			rcu_read_unlock();
 			return cp;
 		}
 	}
 
+	return NULL;
+}
+
+/*
+ *  Gets ip_vs_conn associated with supplied parameters in the ip_vs_conn_tab.
+ *  Called for pkts coming from OUTside-to-INside.
+ *	p->caddr, p->cport: pkt source address (foreign host)
+ *	p->vaddr, p->vport: pkt dest address (load balancer)
+ */
+static inline struct ip_vs_conn *
+__ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
+{
+	unsigned int hash;
+	struct ip_vs_conn *cp;
+
+	hash = ip_vs_conn_hashkey_param(p, false);
+
+	rcu_read_lock();
+	cp = ip_vs_conn_lookup(hash, p, ip_vs_conn_in_match);
 	rcu_read_unlock();
 
-	return NULL;
+	return cp;
 }
 
 struct ip_vs_conn *ip_vs_conn_in_get(const struct ip_vs_conn_param *p)
@@ -340,23 +445,18 @@ ip_vs_conn_in_get_proto(int af, const struct sk_buff *skb,
 }
 EXPORT_SYMBOL_GPL(ip_vs_conn_in_get_proto);
 
-/* Get reference to connection template */
-struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
+static inline struct ip_vs_conn *
+ip_vs_ct_in_match(struct hlist_head *head, const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
 	struct ip_vs_conn *cp;
 
-	hash = ip_vs_conn_hashkey_param(p, false);
-
-	rcu_read_lock();
-
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+	hlist_for_each_entry_rcu(cp, head, c_list) {
 		if (unlikely(p->pe_data && p->pe->ct_match)) {
 			if (!ip_vs_conn_net_eq(cp, p->net))
 				continue;
 			if (p->pe == cp->pe && p->pe->ct_match(p, cp)) {
 				if (__ip_vs_conn_get(cp))
-					goto out;
+					return cp;
 			}
 			continue;
 		}
@@ -372,12 +472,23 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 		    p->protocol == cp->protocol &&
 		    ip_vs_conn_net_eq(cp, p->net)) {
 			if (__ip_vs_conn_get(cp))
-				goto out;
+				return cp;
 		}
 	}
-	cp = NULL;
 
-  out:
+	return NULL;
+}
+
+/* Get reference to connection template */
+struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
+{
+	unsigned int hash;
+	struct ip_vs_conn *cp;
+
+	hash = ip_vs_conn_hashkey_param(p, false);
+
+	rcu_read_lock();
+	cp = ip_vs_conn_lookup(hash, p, ip_vs_ct_in_match);
 	rcu_read_unlock();
 
 	IP_VS_DBG_BUF(9, "template lookup/in %s %s:%d->%s:%d %s\n",
@@ -389,23 +500,12 @@ struct ip_vs_conn *ip_vs_ct_in_get(const struct ip_vs_conn_param *p)
 	return cp;
 }
 
-/* Gets ip_vs_conn associated with supplied parameters in the ip_vs_conn_tab.
- * Called for pkts coming from inside-to-OUTside.
- *	p->caddr, p->cport: pkt source address (inside host)
- *	p->vaddr, p->vport: pkt dest address (foreign host) */
-struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
+static inline struct ip_vs_conn *
+ip_vs_conn_out_match(struct hlist_head *head, const struct ip_vs_conn_param *p)
 {
-	unsigned int hash;
-	struct ip_vs_conn *cp, *ret=NULL;
-
-	/*
-	 *	Check for "full" addressed entries
-	 */
-	hash = ip_vs_conn_hashkey_param(p, true);
-
-	rcu_read_lock();
+	struct ip_vs_conn *cp;
 
-	hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+	hlist_for_each_entry_rcu(cp, head, c_list) {
 		if (p->vport == cp->cport && p->cport == cp->dport &&
 		    cp->af == p->af &&
 		    ip_vs_addr_equal(p->af, p->vaddr, &cp->caddr) &&
@@ -415,11 +515,29 @@ struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
 			if (!__ip_vs_conn_get(cp))
 				continue;
 			/* HIT */
-			ret = cp;
-			break;
+			return cp;
 		}
 	}
 
+	return NULL;
+}
+
+/* Gets ip_vs_conn associated with supplied parameters in the ip_vs_conn_tab.
+ * Called for pkts coming from inside-to-OUTside.
+ *	p->caddr, p->cport: pkt source address (inside host)
+ *	p->vaddr, p->vport: pkt dest address (foreign host) */
+struct ip_vs_conn *ip_vs_conn_out_get(const struct ip_vs_conn_param *p)
+{
+	unsigned int hash;
+	struct ip_vs_conn *ret;
+
+	/*
+	 *	Check for "full" addressed entries
+	 */
+	hash = ip_vs_conn_hashkey_param(p, true);
+
+	rcu_read_lock();
+	ret = ip_vs_conn_lookup(hash, p, ip_vs_conn_out_match);
 	rcu_read_unlock();
 
 	IP_VS_DBG_BUF(9, "lookup/out %s %s:%d->%s:%d %s\n",
@@ -976,24 +1094,29 @@ ip_vs_conn_new(const struct ip_vs_conn_param *p,
  *	/proc/net/ip_vs_conn entries
  */
 #ifdef CONFIG_PROC_FS
+/* The bucket index is kept instead of the chain head, the table
+ * can be replaced by a resize while RCU is dropped between buckets.
+ */
 struct ip_vs_iter_state {
 	struct seq_net_private	p;
-	struct hlist_head	*l;
+	unsigned int		bucket;
 };
 
 static void *ip_vs_conn_array(struct seq_file *seq, loff_t pos)
 {
-	int idx;
+	unsigned int idx;
 	struct ip_vs_conn *cp;
+	struct ip_vs_conn_tab *t;
 	struct ip_vs_iter_state *iter = seq->private;
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+	for (idx = 0; idx < (t = rcu_dereference(ip_vs_conn_tab))->size;
+	     idx++) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			/* __ip_vs_conn_get() is not needed by
 			 * ip_vs_conn_seq_show and ip_vs_conn_sync_seq_show
 			 */
 			if (pos-- == 0) {
-				iter->l = &ip_vs_conn_tab[idx];
+				iter->bucket = idx;
 				return cp;
 			}
 		}
@@ -1009,7 +1132,7 @@ static void *ip_vs_conn_seq_start(struct seq_file *seq, loff_t *pos)
 {
 	struct ip_vs_iter_state *iter = seq->private;
 
-	iter->l = NULL;
+	iter->bucket = 0;
 	rcu_read_lock();
 	return *pos ? ip_vs_conn_array(seq, *pos - 1) :SEQ_START_TOKEN;
 }
@@ -1019,8 +1142,8 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	struct ip_vs_conn *cp = v;
 	struct ip_vs_iter_state *iter = seq->private;
 	struct hlist_node *e;
-	struct hlist_head *l = iter->l;
-	int idx;
+	struct ip_vs_conn_tab *t;
+	unsigned int idx;
 
 	++*pos;
 	if (v == SEQ_START_TOKEN)
@@ -1031,16 +1154,16 @@ static void *ip_vs_conn_seq_next(struct seq_file *seq, void *v, loff_t *pos)
 	if (e)
 		return hlist_entry(e, struct ip_vs_conn, c_list);
 
-	idx = l - ip_vs_conn_tab;
-	while (++idx < ip_vs_conn_tab_size) {
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
-			iter->l = &ip_vs_conn_tab[idx];
+	idx = iter->bucket;
+	while (++idx < (t = rcu_dereference(ip_vs_conn_tab))->size) {
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
+			iter->bucket = idx;
 			return cp;
 		}
 		rcu_read_unlock();
 		rcu_read_lock();
 	}
-	iter->l = NULL;
+	iter->bucket = 0;
 	return NULL;
 }
 
@@ -1237,19 +1360,22 @@ void ip_vs_random_dropentry(struct net *net)
 {
 	int idx;
 	struct ip_vs_conn *cp, *cp_c;
+	struct ip_vs_conn_tab *t;
 
 	/*
 	 * Randomly scan 1/32 of the whole table every second
 	 */
 	for (idx = 0; idx < (ip_vs_conn_tab_size>>5); idx++) {
-		unsigned int hash = prandom_u32() & ip_vs_conn_tab_mask;
+		unsigned int hash = prandom_u32();
 
 		/*
 		 *  Lock is actually needed in this loop.
 		 */
 		rcu_read_lock();
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[hash], c_list) {
+		t = rcu_dereference(ip_vs_conn_tab);
+		hlist_for_each_entry_rcu(cp, &t->buckets[hash & t->mask],
+					 c_list) {
 			if (!ip_vs_conn_net_eq(cp, net))
 				continue;
 			if (cp->flags & IP_VS_CONN_F_TEMPLATE) {
@@ -1300,10 +1426,14 @@ try_drop:
  */
 static void ip_vs_conn_flush(struct net *net)
 {
-	int idx;
+	unsigned int idx;
 	struct ip_vs_conn *cp, *cp_c;
+	struct ip_vs_conn_tab *t;
 	struct netns_ipvs *ipvs = net_ipvs(net);
 
+	/* entries moved by a concurrent resize are caught on the next
+	 * pass, we loop until the netns has no connections left
+	 */
 flush_again:
 	for (idx = 0; idx < ip_vs_conn_tab_size; idx++) {
 		/*
@@ -1311,7 +1441,12 @@ flush_again:
 		 */
 		rcu_read_lock();
 
-		hlist_for_each_entry_rcu(cp, &ip_vs_conn_tab[idx], c_list) {
+		t = rcu_dereference(ip_vs_conn_tab);
+		if (idx >= t->size) {
+			rcu_read_unlock();
+			break;
+		}
+		hlist_for_each_entry_rcu(cp, &t->buckets[idx], c_list) {
 			if (!ip_vs_conn_net_eq(cp, net))
 				continue;
 			IP_VS_DBG(4, "del connection\n");
@@ -1356,42 +1491,147 @@ void __net_exit ip_vs_conn_net_cleanup(struct net *net)
 	remove_proc_entry("ip_vs_conn_sync", net->proc_net);
 }
 
+static struct ip_vs_conn_tab *ip_vs_conn_tab_alloc(int bits)
+{
+	struct ip_vs_conn_tab *t;
+	unsigned int size = 1 << bits;
+
+	t = vzalloc(sizeof(*t) + size * sizeof(struct hlist_head));
+	if (!t)
+		return NULL;
+
+	t->size = size;
+	t->mask = size - 1;
+	return t;
+}
+
+/*
+ *	Grow the connection hash table. The entries are moved into the new
+ *	table one lock stripe at a time, so that only the connections of
+ *	the stripe being moved wait for the resize.
+ */
+static void ip_vs_conn_resize(struct work_struct *work)
+{
+	struct ip_vs_conn_tab *old, *new;
+	struct ip_vs_aligned_lock *l;
+	struct ip_vs_conn *cp;
+	struct hlist_node *n;
+	unsigned int idx, lidx;
+	s64 count;
+	int bits;
+
+	old = rcu_dereference_protected(ip_vs_conn_tab, 1);
+	count = percpu_counter_sum_positive(&ip_vs_conn_hashed);
+	if (count <= old->size)
+		return;
+
+	bits = max_t(int, ilog2(old->size) + 1, order_base_2(count));
+	bits = min(bits, ip_vs_conn_tab_max_bits);
+	if (bits <= ilog2(old->size))
+		return;
+
+	new = ip_vs_conn_tab_alloc(bits);
+	if (!new) {
+		pr_warn("Connection hash table resize to %u buckets failed\n",
+			1U << bits);
+		return;
+	}
+
+	rcu_assign_pointer(ip_vs_conn_tab_new, new);
+
+	for (lidx = 0; lidx < ct_lockarray_size; lidx++) {
+		l = &__ip_vs_conntbl_lock_array[lidx];
+
+		spin_lock_bh(&l->l);
+		write_seqcount_begin(&ip_vs_conn_tab_seq);
+		for (idx = lidx; idx < old->size; idx += ct_lockarray_size) {
+			hlist_for_each_entry_safe(cp, n, &old->buckets[idx],
+						  c_list) {
+				unsigned int hash = ip_vs_conn_hashkey_conn(cp);
+
+				hlist_del_rcu(&cp->c_list);
+				hlist_add_head_rcu(&cp->c_list,
+						   &new->buckets[hash & new->mask]);
+			}
+		}
+		l->tab = new;
+		write_seqcount_end(&ip_vs_conn_tab_seq);
+		spin_unlock_bh(&l->l);
+
+		cond_resched();
+	}
+
+	local_bh_disable();
+	write_seqcount_begin(&ip_vs_conn_tab_seq);
+	rcu_assign_pointer(ip_vs_conn_tab, new);
+	RCU_INIT_POINTER(ip_vs_conn_tab_new, NULL);
+	write_seqcount_end(&ip_vs_conn_tab_seq);
+	local_bh_enable();
+
+	ip_vs_conn_tab_size = new->size;
+
+	IP_VS_DBG(1, "Connection hash table resized to %u buckets "
+		  "(%lld connections)\n", new->size, count);
+
+	/* wait for the readers still walking the old chains */
+	synchronize_rcu();
+	vfree(old);
+}
+
 int __init ip_vs_conn_init(void)
 {
-	int idx;
+	struct ip_vs_conn_tab *t;
+	int idx, lock_bits;
 
-	/* Compute size and mask */
-	ip_vs_conn_tab_size = 1 << ip_vs_conn_tab_bits;
-	ip_vs_conn_tab_mask = ip_vs_conn_tab_size - 1;
+	if (ip_vs_conn_tab_max_bits > IP_VS_CONN_TAB_MAX_BITS)
+		ip_vs_conn_tab_max_bits = IP_VS_CONN_TAB_MAX_BITS;
+	if (ip_vs_conn_tab_max_bits < ip_vs_conn_tab_bits)
+		ip_vs_conn_tab_max_bits = ip_vs_conn_tab_bits;
 
 	/*
 	 * Allocate the connection hash table and initialize its list heads
 	 */
-	ip_vs_conn_tab = vmalloc(ip_vs_conn_tab_size * sizeof(*ip_vs_conn_tab));
-	if (!ip_vs_conn_tab)
+	t = ip_vs_conn_tab_alloc(ip_vs_conn_tab_bits);
+	if (!t)
 		return -ENOMEM;
 
+	if (percpu_counter_init(&ip_vs_conn_hashed, 0, GFP_KERNEL)) {
+		vfree(t);
+		return -ENOMEM;
+	}
+
 	/* Allocate ip_vs_conn slab cache */
 	ip_vs_conn_cachep = kmem_cache_create("ip_vs_conn",
 					      sizeof(struct ip_vs_conn), 0,
 					      SLAB_HWCACHE_ALIGN, NULL);
 	if (!ip_vs_conn_cachep) {
-		vfree(ip_vs_conn_tab);
+		percpu_counter_destroy(&ip_vs_conn_hashed);
+		vfree(t);
 		return -ENOMEM;
 	}
 
+	ip_vs_conn_tab_size = t->size;
+	RCU_INIT_POINTER(ip_vs_conn_tab, t);
+	seqcount_init(&ip_vs_conn_tab_seq);
+
+	/* never more locks than buckets, see ct_bucket_locked() */
+	lock_bits = order_base_2(num_possible_cpus() * CT_LOCKS_PER_CPU);
+	lock_bits = clamp(lock_bits, CT_LOCKARRAY_BITS, CT_LOCKARRAY_MAX_BITS);
+	lock_bits = min(lock_bits, ip_vs_conn_tab_bits);
+	ct_lockarray_size = 1 << lock_bits;
+	ct_lockarray_mask = ct_lockarray_size - 1;
+
 	pr_info("Connection hash table configured "
-		"(size=%d, memory=%ldKbytes)\n",
-		ip_vs_conn_tab_size,
+		"(size=%d, max size=%d, locks=%u, memory=%ldKbytes)\n",
+		ip_vs_conn_tab_size, 1 << ip_vs_conn_tab_max_bits,
+		ct_lockarray_size,
 		(long)(ip_vs_conn_tab_size*sizeof(struct list_head))/1024);
 	IP_VS_DBG(0, "Each connection entry needs %Zd bytes at least\n",
 		  sizeof(struct ip_vs_conn));
 
-	for (idx = 0; idx < ip_vs_conn_tab_size; idx++)
-		INIT_HLIST_HEAD(&ip_vs_conn_tab[idx]);
-
-	for (idx = 0; idx < CT_LOCKARRAY_SIZE; idx++)  {
+	for (idx = 0; idx < ct_lockarray_size; idx++)  {
 		spin_lock_init(&__ip_vs_conntbl_lock_array[idx].l);
+		__ip_vs_conntbl_lock_array[idx].tab = t;
 	}
 
 	/* calculate the random value for connection hash */
@@ -1402,9 +1642,11 @@ int __init ip_vs_conn_init(void)
 
 void ip_vs_conn_cleanup(void)
 {
+	cancel_work_sync(&ip_vs_conn_resize_work);
 	/* Wait all ip_vs_conn_rcu_free() callbacks to complete */
 	rcu_barrier();
 	/* Release the empty cache */
 	kmem_cache_destroy(ip_vs_conn_cachep);
-	vfree(ip_vs_conn_tab);
+	percpu_counter_destroy(&ip_vs_conn_hashed);
+	vfree(rcu_dereference_protected(ip_vs_conn_tab, 1));
 }
@@ -42,6 +42,11 @@
 
 #define NFQNL_QMAX_DEFAULT 1024
 
+/* Packet ids are handed out sequentially, so masking the id spreads the
+ * pending entries evenly over the buckets.
+ */
+#define NFQNL_HASH_BUCKETS	256
+
 struct nfqnl_instance {
 	struct hlist_node hlist;		/* global list of queues */
 	struct rcu_head rcu;
@@ -64,6 +69,7 @@ struct nfqnl_instance {
 	unsigned int	queue_total;
 	unsigned int	id_sequence;		/* 'sequence' of pkt ids */
 	struct list_head queue_list;		/* packets in queue */
+	struct hlist_head queue_hash[NFQNL_HASH_BUCKETS]; /* by packet id */
 };
 
 typedef int (*nfqnl_cmpfn)(struct nf_queue_entry *, unsigned long);
@@ -176,10 +182,17 @@ instance_destroy(struct nfnl_queue_net *q, struct nfqnl_instance *inst)
 	spin_unlock(&q->instances_lock);
 }
 
+static inline struct hlist_head *
+nfqnl_id_bucket(struct nfqnl_instance *queue, unsigned int id)
+{
+	return &queue->queue_hash[id & (NFQNL_HASH_BUCKETS - 1)];
+}
+
 static inline void
 __enqueue_entry(struct nfqnl_instance *queue, struct nf_queue_entry *entry)
 {
        list_add_tail(&entry->list, &queue->queue_list);
+       hlist_add_head(&entry->hash_node, nfqnl_id_bucket(queue, entry->id));
        queue->queue_total++;
 }
 
@@ -187,9 +200,14 @@ static void
 __dequeue_entry(struct nfqnl_instance *queue, struct nf_queue_entry *entry)
 {
 	list_del(&entry->list);
+	hlist_del(&entry->hash_node);
 	queue->queue_total--;
 }
 
+/* Userspace that verdicts from several threads answers out of order, so
+ * look the id up in the per-queue hash instead of walking queue_list with
+ * the queue lock held.
+ */
 static struct nf_queue_entry *
 find_dequeue_entry(struct nfqnl_instance *queue, unsigned int id)
 {
@@ -197,7 +215,7 @@ find_dequeue_entry(struct nfqnl_instance *queue, unsigned int id)
 
 	spin_lock_bh(&queue->lock);
 
-	list_for_each_entry(i, &queue->queue_list, list) {
+	hlist_for_each_entry(i, nfqnl_id_bucket(queue, id), hash_node) {
 		if (i->id == id) {
 			entry = i;
 			break;
@@ -220,8 +238,7 @@ nfqnl_flush(struct nfqnl_instance *queue, nfqnl_cmpfn cmpfn, unsigned long data)
 	spin_lock_bh(&queue->lock);
 	list_for_each_entry_safe(entry, next, &queue->queue_list, list) {
 		if (!cmpfn || cmpfn(entry, data)) {
-			list_del(&entry->list);
-			queue->queue_total--;
+			__dequeue_entry(queue, entry);
 			nf_reinject(entry, NF_DROP);
 		}
 	}
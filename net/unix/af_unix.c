@@ -1829,6 +1829,72 @@ out:
  */
 #define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(32768))
 
+/* Writes up to this size are first copied into the tailroom of the skb
+ * last queued to the peer, and get a head large enough to absorb a few
+ * followers when a new skb is needed.
+ */
+#define UNIX_SKB_COALESCE_MAX	512
+#define UNIX_SKB_COALESCE_SZ	SKB_WITH_OVERHEAD(2048)
+
+/* Try to append @size bytes of @msg at @offset to the tail skb of @other.
+ * Returns the number of bytes appended, 0 if a new skb is needed, or a
+ * negative error.
+ */
+static int unix_stream_append_tail(struct sock *sk, struct sock *other,
+				   struct scm_cookie *scm, struct msghdr *msg,
+				   int offset, int size)
+{
+	struct unix_sock *u = unix_sk(other);
+	struct sk_buff *skb;
+	int err = 0;
+
+	/* A reader holding readlock may be copying out of the tail skb;
+	 * don't wait for it, queueing a new skb is just as good.
+	 */
+	if (!mutex_trylock(&u->readlock))
+		return 0;
+
+	unix_state_lock(other);
+	if (sock_flag(other, SOCK_DEAD) ||
+	    (other->sk_shutdown & RCV_SHUTDOWN)) {
+		err = -EPIPE;
+		goto out_state_unlock;
+	}
+
+	skb = skb_peek_tail(&other->sk_receive_queue);
+	if (!skb || skb->sk != sk || UNIXCB(skb).fp ||
+	    skb_tailroom(skb) < size || !unix_skb_scm_eq(skb, scm))
+		goto out_state_unlock;
+
+	/* the peer may purge its queue on release without readlock */
+	skb_get(skb);
+	unix_state_unlock(other);
+
+	/* tailroom is already charged to the skb truesize */
+	if (memcpy_fromiovecend(skb_tail_pointer(skb), msg->msg_iov,
+				offset, size)) {
+		err = -EFAULT;
+		goto out_put;
+	}
+
+	unix_state_lock(other);
+	if (skb == skb_peek_tail(&other->sk_receive_queue) &&
+	    !sock_flag(other, SOCK_DEAD)) {
+		skb_put(skb, size);
+		err = size;
+	}
+	unix_state_unlock(other);
+out_put:
+	kfree_skb(skb);
+	mutex_unlock(&u->readlock);
+	return err;
+
+out_state_unlock:
+	unix_state_unlock(other);
+	mutex_unlock(&u->readlock);
+	return err;
+}
+
 static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 			       struct msghdr *msg, size_t len)
 {
@@ -1842,6 +1908,8 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	bool fds_sent = false;
 	int max_level;
 	int data_len;
+	int header_len;
+	int unwoken = 0;
 
 	if (NULL == siocb->scm)
 		siocb->scm = &tmp_scm;
@@ -1870,6 +1938,20 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 	while (sent < len) {
 		size = len - sent;
 
+		if (size <= UNIX_SKB_COALESCE_MAX && !siocb->scm->fp) {
+			err = unix_stream_append_tail(sk, other, siocb->scm,
+						      msg, sent, size);
+			if (err == -EPIPE)
+				goto pipe_err;
+			if (err < 0)
+				goto out_err;
+			if (err > 0) {
+				sent += err;
+				unwoken += err;
+				continue;
+			}
+		}
+
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
 
@@ -1880,9 +1962,30 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 
 		data_len = min_t(size_t, size, PAGE_ALIGN(data_len));
 
-		skb = sock_alloc_send_pskb(sk, size - data_len, data_len,
-					   msg->msg_flags & MSG_DONTWAIT, &err,
-					   get_order(UNIX_SKB_FRAGS_SZ));
+		header_len = size - data_len;
+		if (size <= UNIX_SKB_COALESCE_MAX)
+			header_len = max_t(int, header_len,
+					   min_t(int, UNIX_SKB_COALESCE_SZ,
+						 (sk->sk_sndbuf >> 2)));
+
+		/* Wakeups are batched until the end of the call; if the
+		 * send buffer is full the reader has to run first.
+		 */
+		skb = NULL;
+		if (unwoken)
+			skb = sock_alloc_send_pskb(sk, header_len, data_len,
+						   1, &err,
+						   get_order(UNIX_SKB_FRAGS_SZ));
+		if (!skb) {
+			if (unwoken) {
+				other->sk_data_ready(other, unwoken);
+				unwoken = 0;
+			}
+			skb = sock_alloc_send_pskb(sk, header_len, data_len,
+						   msg->msg_flags & MSG_DONTWAIT,
+						   &err,
+						   get_order(UNIX_SKB_FRAGS_SZ));
+		}
 		if (!skb)
 			goto out_err;
 
@@ -1916,10 +2019,12 @@ static int unix_stream_sendmsg(struct kiocb *kiocb, struct socket *sock,
 		if (max_level > unix_sk(other)->recursion_level)
 			unix_sk(other)->recursion_level = max_level;
 		unix_state_unlock(other);
-		other->sk_data_ready(other, size);
 		sent += size;
+		unwoken += size;
 	}
 
+	if (unwoken)
+		other->sk_data_ready(other, unwoken);
 	scm_destroy(siocb->scm);
 	siocb->scm = NULL;
 
@@ -1933,6 +2038,8 @@ pipe_err:
 		send_sig(SIGPIPE, current, 0);
 	err = -EPIPE;
 out_err:
+	if (unwoken)
+		other->sk_data_ready(other, unwoken);
 	scm_destroy(siocb->scm);
 	siocb->scm = NULL;
 	return sent ? : err;
@@ -1959,6 +2066,11 @@ static ssize_t unix_stream_sendpage(struct socket *socket, struct page *page,
 alloc_skb:
 		unix_state_unlock(other);
 		mutex_unlock(&unix_sk(other)->readlock);
+		/* earlier pages of this splice may not have woken the reader
+		 * yet, do it before possibly sleeping on the send buffer
+		 */
+		if (flags & MSG_SENDPAGE_NOTLAST)
+			other->sk_data_ready(other, 0);
 		newskb = sock_alloc_send_pskb(sk, 0, 0, flags & MSG_DONTWAIT,
 					      &err, 0);
 		if (!newskb)
@@ -2037,7 +2149,9 @@ alloc_skb:
 	unix_state_unlock(other);
 	mutex_unlock(&unix_sk(other)->readlock);
 
-	other->sk_data_ready(other, 0);
+	/* splice wakes the reader once for the last page of a batch */
+	if (!(flags & MSG_SENDPAGE_NOTLAST))
+		other->sk_data_ready(other, 0);
 	scm_destroy(&scm);
 	return size;
 
@@ -2047,6 +2161,8 @@ err_unlock:
 	mutex_unlock(&unix_sk(other)->readlock);
 err:
 	kfree_skb(newskb);
+	if (flags & MSG_SENDPAGE_NOTLAST)
+		other->sk_data_ready(other, 0);
 	if (send_sigpipe && !(flags & MSG_NOSIGNAL))
 		send_sig(SIGPIPE, current, 0);
 	if (!init_scm)